@@ -0,0 +1,70 @@
+#include "AABB.h"
+#include <utility>
+
+using namespace DirectX;
+
+AABB::AABB(const DirectX::XMFLOAT3& _a, const DirectX::XMFLOAT3& _b)
+{
+	// Order each axis so the interval's minimum comes first
+	x = (_a.x <= _b.x) ? Interval(_a.x, _b.x) : Interval(_b.x, _a.x);
+	y = (_a.y <= _b.y) ? Interval(_a.y, _b.y) : Interval(_b.y, _a.y);
+	z = (_a.z <= _b.z) ? Interval(_a.z, _b.z) : Interval(_b.z, _a.z);
+}
+
+const Interval& AABB::AxisInterval(int _axis) const
+{
+	if (_axis == 1) return y;
+	if (_axis == 2) return z;
+	return x;
+}
+
+int AABB::LongestAxis() const
+{
+	if (x.Size() > y.Size())
+		return x.Size() > z.Size() ? 0 : 2;
+	else
+		return y.Size() > z.Size() ? 1 : 2;
+}
+
+float AABB::SurfaceArea() const
+{
+	// An empty box has negative sizes, but no area
+	float dx = std::fmax(0.0f, x.Size());
+	float dy = std::fmax(0.0f, y.Size());
+	float dz = std::fmax(0.0f, z.Size());
+	return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+DirectX::XMFLOAT3 AABB::Centroid() const
+{
+	return XMFLOAT3(x.Center(), y.Center(), z.Center());
+}
+
+bool AABB::Hit(const Ray& _ray, Interval _rayT) const
+{
+	const float rayOrigin[3] = { _ray.Origin.x, _ray.Origin.y, _ray.Origin.z };
+	const float rayDirection[3] = { _ray.Direction.x, _ray.Direction.y, _ray.Direction.z };
+
+	// Narrow _rayT down to where the ray is between each pair of slabs
+	for (int axis = 0; axis < 3; axis++) {
+		const Interval& axisInterval = AxisInterval(axis);
+		const float inverseDirection = 1.0f / rayDirection[axis];
+
+		float t0 = (axisInterval.minimum - rayOrigin[axis]) * inverseDirection;
+		float t1 = (axisInterval.maximum - rayOrigin[axis]) * inverseDirection;
+
+		if (t0 > t1) std::swap(t0, t1);
+
+		if (t0 > _rayT.minimum) _rayT.minimum = t0;
+		if (t1 < _rayT.maximum) _rayT.maximum = t1;
+
+		if (_rayT.maximum <= _rayT.minimum)
+			return false;
+	}
+
+	return true;
+}
+
+// Built from raw bounds, since Interval's statics may not be initialized yet
+const AABB AABB::Empty    = AABB(Interval(+infinity, -infinity), Interval(+infinity, -infinity), Interval(+infinity, -infinity));
+const AABB AABB::Universe = AABB(Interval(-infinity, +infinity), Interval(-infinity, +infinity), Interval(-infinity, +infinity));
@@ -0,0 +1,28 @@
+#pragma once
+#include "Helpers.h"
+
+// Axis-aligned bounding box, stored as one interval per axis
+class AABB
+{
+public:
+	Interval x, y, z;
+
+	AABB() {} // Default AABB is empty, since intervals are empty by default
+	AABB(const Interval& _x, const Interval& _y, const Interval& _z) : x(_x), y(_y), z(_z) {}
+	// Creates the box with _a and _b as opposite corners
+	AABB(const DirectX::XMFLOAT3& _a, const DirectX::XMFLOAT3& _b);
+	// Creates the tightest box enclosing both boxes
+	AABB(const AABB& _a, const AABB& _b) : x(_a.x, _b.x), y(_a.y, _b.y), z(_a.z, _b.z) {}
+
+	const Interval& AxisInterval(int _axis) const;
+	// Index of the axis the box is longest along
+	int LongestAxis() const;
+	float SurfaceArea() const;
+	DirectX::XMFLOAT3 Centroid() const;
+
+	// Whether the ray passes through the box anywhere inside _rayT
+	bool Hit(const Ray& _ray, Interval _rayT) const;
+
+	static const AABB Empty, Universe;
+};
+
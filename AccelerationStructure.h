@@ -0,0 +1,18 @@
+#pragma once
+#include "Hittable.h"
+
+// A Hittable that speeds up ray queries over a fixed set of primitives.
+// When those primitives move, Refit() updates the structure's bounds in
+// place without changing its shape, which is far cheaper than rebuilding
+// but lets its quality drift as things move further from where they started
+class AccelerationStructure :
+	public Hittable
+{
+public:
+	// Recomputes every bound from the primitives' current bounding boxes
+	virtual void Refit() = 0;
+
+	// Expected cost of tracing a random ray through the structure under the
+	// surface area heuristic, in units of one primitive test. Lower is better
+	virtual float ComputeSAHCost() const = 0;
+};
@@ -0,0 +1,180 @@
+#include "AccumulationBuffer.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+// -----------------------------------
+// Adds one sample's luminance to the
+// running mean and variance
+// 
+// luminance - Luminance of the sample
+// -----------------------------------
+void PixelVariance::Add(float luminance)
+{
+	count++;
+	float delta = luminance - mean;
+	mean += delta / count;
+	m2 += delta * (luminance - mean);
+}
+
+// -----------------------------------
+// Gets the unbiased sample variance,
+// or 0 with fewer than two samples
+// -----------------------------------
+float PixelVariance::Variance() const
+{
+	return count > 1 ? m2 / (count - 1) : 0.0f;
+}
+
+// -----------------------------------
+// Gets how far the true mean may be
+// from the sampled one, with 95%
+// confidence
+// -----------------------------------
+float PixelVariance::ConfidenceHalfWidth() const
+{
+	if (count == 0) return infinity;
+
+	return 1.96f * std::sqrt(Variance() / count);
+}
+
+// -----------------------------------
+// Creates a new, empty accumulation
+// buffer of the given size
+// 
+// width - Width of pixel grid
+// height - Height of pixel grid
+// -----------------------------------
+AccumulationBuffer::AccumulationBuffer(unsigned int width, unsigned int height) :
+	width(0),
+	height(0)
+{
+	Resize(width, height);
+}
+
+// -----------------------------------
+// Resizes the pixel grid, which also
+// throws away every accumulated sample
+// 
+// width - New width
+// height - New height
+// -----------------------------------
+void AccumulationBuffer::Resize(unsigned int width, unsigned int height)
+{
+	this->width = width;
+	this->height = height;
+	pixelSums.assign((size_t)width * height, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+	pixelVariances.assign((size_t)width * height, PixelVariance());
+}
+
+// -----------------------------------
+// Throws away every accumulated sample
+// -----------------------------------
+void AccumulationBuffer::Clear()
+{
+	pixelSums.assign(pixelSums.size(), XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+	pixelVariances.assign(pixelVariances.size(), PixelVariance());
+}
+
+// -----------------------------------
+// Replaces whatever the pixel held
+// with a new sum of samples
+// 
+// x - Pixel grid x location
+// y - Pixel grid y location
+// colorSum - Sum of the samples' linear colors
+// sampleCount - Number of samples in colorSum
+// -----------------------------------
+void AccumulationBuffer::SetSamples(unsigned int x, unsigned int y, DirectX::XMVECTOR colorSum, unsigned int sampleCount)
+{
+	XMStoreFloat4(&pixelSums[PixelIndex(x, y)], XMVectorSetW(colorSum, (float)sampleCount));
+}
+
+// -----------------------------------
+// Adds a sum of samples to the ones
+// the pixel already holds
+// 
+// x - Pixel grid x location
+// y - Pixel grid y location
+// colorSum - Sum of the samples' linear colors
+// sampleCount - Number of samples in colorSum
+// -----------------------------------
+void AccumulationBuffer::AddSamples(unsigned int x, unsigned int y, DirectX::XMVECTOR colorSum, unsigned int sampleCount)
+{
+	unsigned int index = PixelIndex(x, y);
+	XMVECTOR p = XMLoadFloat4(&pixelSums[index]);
+	XMStoreFloat4(&pixelSums[index], XMVectorAdd(p, XMVectorSetW(colorSum, (float)sampleCount)));
+}
+
+// -----------------------------------
+// Gets the mean linear color of every
+// sample the pixel holds, or black if
+// it holds none
+// 
+// x - Pixel grid x location
+// y - Pixel grid y location
+// -----------------------------------
+DirectX::XMVECTOR AccumulationBuffer::GetMean(unsigned int x, unsigned int y) const
+{
+	const XMFLOAT4& sum = pixelSums[PixelIndex(x, y)];
+	if (sum.w <= 0.0f) return XMVectorZero();
+
+	return XMVectorScale(XMLoadFloat4(&sum), 1.0f / sum.w);
+}
+
+// -----------------------------------
+// Gets how many samples the pixel holds
+// 
+// x - Pixel grid x location
+// y - Pixel grid y location
+// -----------------------------------
+unsigned int AccumulationBuffer::GetSampleCount(unsigned int x, unsigned int y) const
+{
+	return (unsigned int)pixelSums[PixelIndex(x, y)].w;
+}
+
+// -----------------------------------
+// Gets the pixel's luminance statistics
+// 
+// x - Pixel grid x location
+// y - Pixel grid y location
+// -----------------------------------
+const PixelVariance& AccumulationBuffer::GetVariance(unsigned int x, unsigned int y) const
+{
+	return pixelVariances[PixelIndex(x, y)];
+}
+
+// -----------------------------------
+// Replaces the pixel's luminance
+// statistics
+// 
+// x - Pixel grid x location
+// y - Pixel grid y location
+// variance - Statistics over every sample the pixel holds
+// -----------------------------------
+void AccumulationBuffer::SetVariance(unsigned int x, unsigned int y, const PixelVariance& variance)
+{
+	pixelVariances[PixelIndex(x, y)] = variance;
+}
+
+// -----------------------------------
+// Gets the width of the pixel grid
+// -----------------------------------
+unsigned int AccumulationBuffer::GetWidth() const { return width; }
+
+// -----------------------------------
+// Gets the height of the pixel grid
+// -----------------------------------
+unsigned int AccumulationBuffer::GetHeight() const { return height; }
+
+// -----------------------------------
+// Calculates a 1D index from [x, y] notation
+// 
+// x - Pixel grid x location
+// y - Pixel grid y location
+// -----------------------------------
+unsigned int AccumulationBuffer::PixelIndex(unsigned int x, unsigned int y) const
+{
+	return y * width + x;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Helpers.h"
+
+// Running mean and variance of the luminance of one pixel's samples,
+// updated one sample at a time with Welford's algorithm
+struct PixelVariance
+{
+	unsigned int count = 0;
+	float mean = 0.0f;
+	// Sum of squared differences from the mean
+	float m2 = 0.0f;
+
+	void Add(float luminance);
+	// Unbiased sample variance; 0 until there are two samples
+	float Variance() const;
+	// Half-width of the 95% confidence interval around the mean
+	float ConfidenceHalfWidth() const;
+};
+
+// A CPU-side grid of summed linear colors that sits alongside a
+// CPUTexture, so samples can be added to a pixel over several frames
+// and the running mean shown in the meantime
+class AccumulationBuffer
+{
+public:
+	AccumulationBuffer(unsigned int width, unsigned int height);
+
+	// Altering data
+	void Resize(unsigned int width, unsigned int height);
+	void Clear();
+	void SetSamples(unsigned int x, unsigned int y, DirectX::XMVECTOR colorSum, unsigned int sampleCount);
+	void AddSamples(unsigned int x, unsigned int y, DirectX::XMVECTOR colorSum, unsigned int sampleCount);
+
+	// Reading data
+	DirectX::XMVECTOR GetMean(unsigned int x, unsigned int y) const;
+	unsigned int GetSampleCount(unsigned int x, unsigned int y) const;
+
+	// Luminance statistics for adaptive sampling, kept by whoever adds samples
+	const PixelVariance& GetVariance(unsigned int x, unsigned int y) const;
+	void SetVariance(unsigned int x, unsigned int y, const PixelVariance& variance);
+
+	// Getters for current size
+	unsigned int GetWidth() const;
+	unsigned int GetHeight() const;
+
+private:
+	// Helper for 2D indices to 1D index
+	unsigned int PixelIndex(unsigned int x, unsigned int y) const;
+
+	unsigned int width;
+	unsigned int height;
+	// RGB hold each pixel's color sum, W holds its sample count
+	std::vector<DirectX::XMFLOAT4> pixelSums;
+	std::vector<PixelVariance> pixelVariances;
+};
+
@@ -0,0 +1,494 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <bit>
+#include "SimdLanes.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Gets one component of a point by axis index
+	float AxisComponent(const XMFLOAT3& _point, int _axis)
+	{
+		if (_axis == 1) return _point.y;
+		if (_axis == 2) return _point.z;
+		return _point.x;
+	}
+
+	// Reads a node's bounds back into a box
+	AABB NodeBounds(const LinearBVHNode& _node)
+	{
+		return AABB(
+			Interval(_node.boundsMin[0], _node.boundsMax[0]),
+			Interval(_node.boundsMin[1], _node.boundsMax[1]),
+			Interval(_node.boundsMin[2], _node.boundsMax[2]));
+	}
+
+	// Packets are box-tested this many rays at a time
+#if defined(__AVX2__)
+	constexpr int PACKET_LANES = 8;
+#else
+	constexpr int PACKET_LANES = 4;
+#endif
+	using PacketLanes = SimdLanes<PACKET_LANES>;
+
+	// Slab tests a packet's rays from _firstRay on against a node's box, a
+	// lane group at a time, and returns a mask of the rays that hit it.
+	// With _stopAtFirst, stops after the first group that has a hit
+	uint64_t PacketBoxHits(const RayPacket& _packet, const LinearBVHNode& _node, float _tMin, const float* _closestSoFar, int _firstRay, bool _stopAtFirst)
+	{
+		PacketLanes::Float boundsMin[3], boundsMax[3];
+		for (int axis = 0; axis < 3; axis++) {
+			boundsMin[axis] = PacketLanes::Set1(_node.boundsMin[axis]);
+			boundsMax[axis] = PacketLanes::Set1(_node.boundsMax[axis]);
+		}
+
+		uint64_t hitMask = 0;
+		for (int group = _firstRay / PACKET_LANES * PACKET_LANES; group < _packet.count; group += PACKET_LANES) {
+			// Rays may head either way along an axis, so order each slab's
+			// times per lane. Padding lanes have a closest hit of -infinity
+			PacketLanes::Float tNear = PacketLanes::Set1(_tMin);
+			PacketLanes::Float tFar = PacketLanes::Load(_closestSoFar + group);
+			for (int axis = 0; axis < 3; axis++) {
+				PacketLanes::Float origin = PacketLanes::Load(_packet.origins[axis] + group);
+				PacketLanes::Float inverseDirection = PacketLanes::Load(_packet.inverseDirections[axis] + group);
+				PacketLanes::Float t0 = PacketLanes::Mul(PacketLanes::Sub(boundsMin[axis], origin), inverseDirection);
+				PacketLanes::Float t1 = PacketLanes::Mul(PacketLanes::Sub(boundsMax[axis], origin), inverseDirection);
+
+				tNear = PacketLanes::Max(PacketLanes::Min(t0, t1), tNear);
+				tFar = PacketLanes::Min(PacketLanes::Max(t0, t1), tFar);
+			}
+
+			uint64_t groupHits = ((uint64_t)PacketLanes::LessEqualMask(tNear, tFar) << group) & (~0ull << _firstRay);
+			hitMask |= groupHits;
+			if (groupHits != 0 && _stopAtFirst) break;
+		}
+
+		return hitMask;
+	}
+
+	// Writes a box into a node's bounds
+	void SetNodeBounds(LinearBVHNode& _node, const AABB& _bounds)
+	{
+		_node.boundsMin[0] = _bounds.x.minimum;
+		_node.boundsMin[1] = _bounds.y.minimum;
+		_node.boundsMin[2] = _bounds.z.minimum;
+		_node.boundsMax[0] = _bounds.x.maximum;
+		_node.boundsMax[1] = _bounds.y.maximum;
+		_node.boundsMax[2] = _bounds.z.maximum;
+	}
+}
+
+BVH::BVH(const HittableList& _list)
+{
+	// Gather what building needs up front, so it doesn't make virtual calls
+	std::vector<BuildPrimitive> buildPrimitives(_list.objects.size());
+	for (size_t i = 0; i < _list.objects.size(); i++) {
+		buildPrimitives[i].bounds = _list.objects[i]->BoundingBox();
+		buildPrimitives[i].centroid = buildPrimitives[i].bounds.Centroid();
+		buildPrimitives[i].index = (uint32_t)i;
+	}
+
+	// A binary tree never needs more than 2n - 1 nodes
+	nodes.reserve(std::max<size_t>(1, 2 * buildPrimitives.size()));
+	if (buildPrimitives.empty()) {
+		// Keep an empty root, so the bounding box has something to read
+		LinearBVHNode emptyRoot = {};
+		emptyRoot.boundsMin[0] = emptyRoot.boundsMin[1] = emptyRoot.boundsMin[2] = +infinity;
+		emptyRoot.boundsMax[0] = emptyRoot.boundsMax[1] = emptyRoot.boundsMax[2] = -infinity;
+		nodes.push_back(emptyRoot);
+		return;
+	}
+	BuildRecursive(buildPrimitives, 0, buildPrimitives.size(), 0);
+
+	// Store primitives in the order the leaves ended up referring to them
+	primitives.reserve(buildPrimitives.size());
+	for (const BuildPrimitive& buildPrimitive : buildPrimitives) {
+		primitives.push_back(_list.objects[buildPrimitive.index]);
+	}
+	primitiveStore = PrimitiveStore(primitives);
+}
+
+BVH::BVH(std::vector<LinearBVHNode>&& _nodes, std::vector<shared_ptr<Hittable>>&& _primitives) :
+	nodes(std::move(_nodes)),
+	primitives(std::move(_primitives)),
+	primitiveStore(primitives)
+{
+}
+
+bool BVH::Intersect(const Ray& _ray, Interval _rayT, RayHit& _hit) const
+{
+	return Traverse<false>(_ray, _rayT, _hit, nullptr);
+}
+
+bool BVH::Occluded(const Ray& _ray, Interval _rayT) const
+{
+	RayHit unused;
+	return Traverse<false, true>(_ray, _rayT, unused, nullptr);
+}
+
+void BVH::IntersectPacket(const RayPacket& _packet, Interval _rayT, RayHit* _hits) const
+{
+	// Padding lanes get an empty interval, so they never hit anything
+	alignas(32) float closestSoFar[RayPacket::MAX_RAYS];
+	for (int i = 0; i < RayPacket::MAX_RAYS; i++) {
+		closestSoFar[i] = i < _packet.count ? _rayT.maximum : -infinity;
+	}
+	for (int i = 0; i < _packet.count; i++) {
+		_hits[i].primitive = nullptr;
+	}
+	float farthestClosest = _rayT.maximum;
+
+	if (primitives.empty() || _packet.count == 0)
+		return;
+
+	// Nodes still to visit, each with the first ray that may still hit it.
+	// Rays before that one missed an ancestor, so they can't hit anything below
+	struct StackEntry {
+		uint32_t node;
+		int firstRay;
+	};
+	StackEntry toVisit[MAX_DEPTH];
+	int toVisitCount = 0;
+	StackEntry current = { 0, 0 };
+
+	while (true) {
+		const LinearBVHNode& node = nodes[current.node];
+
+		// Cull the node for the whole packet, then find the first ray that
+		// hits it. Leaves need every ray that hits them
+		uint64_t hitMask = 0;
+		if (_packet.MayHitBox(node.boundsMin, node.boundsMax, _rayT.minimum, farthestClosest))
+			hitMask = PacketBoxHits(_packet, node, _rayT.minimum, closestSoFar, current.firstRay, node.primitiveCount == 0);
+
+		if (hitMask != 0) {
+			int firstRay = std::countr_zero(hitMask);
+
+			if (node.primitiveCount > 0) {
+				// Leaf: test its primitives against every ray that hits its box
+				for (uint32_t p = node.primitiveOffset; p < node.primitiveOffset + node.primitiveCount; p++) {
+					for (uint64_t rays = hitMask; rays != 0; rays &= rays - 1) {
+						int i = std::countr_zero(rays);
+						if (primitiveStore.Intersect(p, _packet.rays[i], Interval(_rayT.minimum, closestSoFar[i]), _hits[i]))
+							closestSoFar[i] = _hits[i].t;
+					}
+				}
+
+				farthestClosest = _rayT.minimum;
+				for (int i = 0; i < _packet.count; i++) {
+					farthestClosest = std::max(farthestClosest, closestSoFar[i]);
+				}
+			}
+			else {
+				// Interior: visit the child nearer the first hitting ray's origin first
+				if (_packet.inverseDirections[node.axis][firstRay] < 0.0f) {
+					toVisit[toVisitCount++] = { current.node + 1, firstRay };
+					current = { node.secondChildOffset, firstRay };
+				}
+				else {
+					toVisit[toVisitCount++] = { node.secondChildOffset, firstRay };
+					current = { current.node + 1, firstRay };
+				}
+				continue;
+			}
+		}
+
+		if (toVisitCount == 0) break;
+		current = toVisit[--toVisitCount];
+	}
+}
+
+bool BVH::IntersectWithStats(const Ray& _ray, Interval _rayT, RayHit& _hit, TraversalStats& _stats) const
+{
+	return Traverse<true>(_ray, _rayT, _hit, &_stats);
+}
+
+bool BVH::OccludedWithStats(const Ray& _ray, Interval _rayT, TraversalStats& _stats) const
+{
+	RayHit unused;
+	return Traverse<true, true>(_ray, _rayT, unused, &_stats);
+}
+
+template<bool COUNT_STATS, bool ANY_HIT>
+bool BVH::Traverse(const Ray& _ray, Interval _rayT, RayHit& _hit, TraversalStats* _stats) const
+{
+	if (primitives.empty())
+		return false;
+
+	const float rayOrigin[3] = { _ray.Origin.x, _ray.Origin.y, _ray.Origin.z };
+	const float inverseDirection[3] = { 1.0f / _ray.Direction.x, 1.0f / _ray.Direction.y, 1.0f / _ray.Direction.z };
+	const bool isDirectionNegative[3] = { inverseDirection[0] < 0.0f, inverseDirection[1] < 0.0f, inverseDirection[2] < 0.0f };
+
+	bool hasHitAnything = false;
+	float closestSoFar = _rayT.maximum;
+
+	// Nodes still to visit, and the node being visited
+	uint32_t toVisit[MAX_DEPTH];
+	int toVisitCount = 0;
+	uint32_t current = 0;
+
+	while (true) {
+		const LinearBVHNode& node = nodes[current];
+		if constexpr (COUNT_STATS) _stats->nodesVisited++;
+
+		// Slab test against the node's box, clipped to the closest hit so far.
+		// Comparisons are written so NaNs from 0 * infinity leave the interval alone
+		float tMin = _rayT.minimum;
+		float tMax = closestSoFar;
+		for (int axis = 0; axis < 3; axis++) {
+			float t0 = (node.boundsMin[axis] - rayOrigin[axis]) * inverseDirection[axis];
+			float t1 = (node.boundsMax[axis] - rayOrigin[axis]) * inverseDirection[axis];
+			if (isDirectionNegative[axis]) std::swap(t0, t1);
+
+			tMin = t0 > tMin ? t0 : tMin;
+			tMax = t1 < tMax ? t1 : tMax;
+		}
+
+		if (tMin <= tMax) {
+			if (node.primitiveCount > 0) {
+				// Leaf: test each of its primitives
+				if constexpr (COUNT_STATS) _stats->primitivesTested += node.primitiveCount;
+				for (uint32_t i = node.primitiveOffset; i < node.primitiveOffset + node.primitiveCount; i++) {
+					if constexpr (ANY_HIT) {
+						if (primitiveStore.Occluded(i, _ray, _rayT))
+							return true;
+					}
+					else if (primitiveStore.Intersect(i, _ray, Interval(_rayT.minimum, closestSoFar), _hit)) {
+						hasHitAnything = true;
+						closestSoFar = _hit.t;
+					}
+				}
+			}
+			else {
+				// Interior: visit the child nearer the ray's origin first
+				if (isDirectionNegative[node.axis]) {
+					toVisit[toVisitCount++] = current + 1;
+					current = node.secondChildOffset;
+				}
+				else {
+					toVisit[toVisitCount++] = node.secondChildOffset;
+					current = current + 1;
+				}
+				continue;
+			}
+		}
+
+		if (toVisitCount == 0) break;
+		current = toVisit[--toVisitCount];
+	}
+
+	return hasHitAnything;
+}
+
+AABB BVH::BoundingBox() const
+{
+	return NodeBounds(nodes[0]);
+}
+
+void BVH::Refit()
+{
+	if (primitives.empty())
+		return;
+
+	primitiveStore.Sync();
+
+	// Children are always stored after their parent, so walking the array
+	// backwards finishes both of a node's children before the node itself
+	for (size_t i = nodes.size(); i-- > 0;) {
+		LinearBVHNode& node = nodes[i];
+
+		AABB bounds;
+		if (node.primitiveCount > 0) {
+			for (uint32_t j = node.primitiveOffset; j < node.primitiveOffset + node.primitiveCount; j++) {
+				bounds = AABB(bounds, primitives[j]->BoundingBox());
+			}
+		}
+		else {
+			bounds = AABB(NodeBounds(nodes[i + 1]), NodeBounds(nodes[node.secondChildOffset]));
+		}
+
+		SetNodeBounds(node, bounds);
+	}
+}
+
+size_t BVH::GetNodeCount() const
+{
+	return nodes.size();
+}
+
+const std::vector<LinearBVHNode>& BVH::GetNodes() const
+{
+	return nodes;
+}
+
+const std::vector<shared_ptr<Hittable>>& BVH::GetPrimitives() const
+{
+	return primitives;
+}
+
+float BVH::ComputeSAHCost() const
+{
+	if (primitives.empty())
+		return 0.0f;
+
+	// Each node costs its chance of being hit, relative to the root,
+	// times the work done there
+	float rootArea = BoundingBox().SurfaceArea();
+	if (rootArea <= 0.0f)
+		return 0.0f;
+
+	float cost = 0.0f;
+	for (const LinearBVHNode& node : nodes) {
+		float area = NodeBounds(node).SurfaceArea();
+		cost += area / rootArea * (node.primitiveCount > 0 ? (float)node.primitiveCount : TRAVERSAL_COST);
+	}
+	return cost;
+}
+
+uint32_t BVH::BuildRecursive(std::vector<BuildPrimitive>& _buildPrimitives, size_t _start, size_t _end, int _depth)
+{
+	// Claim this node's slot before its children take the ones after it
+	uint32_t nodeIndex = (uint32_t)nodes.size();
+	nodes.emplace_back();
+
+	AABB bounds;
+	for (size_t i = _start; i < _end; i++) {
+		bounds = AABB(bounds, _buildPrimitives[i].bounds);
+	}
+
+	size_t primitiveCount = _end - _start;
+	int axis = bounds.LongestAxis();
+	size_t mid = _end;
+
+	if (primitiveCount > 1) {
+		if (_depth < MAX_SAH_DEPTH) {
+			mid = PartitionSAH(_buildPrimitives, _start, _end, bounds, axis);
+		}
+		else {
+			// Too deep to trust SAH to stay balanced, so halve the range
+			mid = _start + primitiveCount / 2;
+			std::nth_element(_buildPrimitives.begin() + _start, _buildPrimitives.begin() + mid, _buildPrimitives.begin() + _end,
+				[axis](const BuildPrimitive& _a, const BuildPrimitive& _b) {
+					return AxisComponent(_a.centroid, axis) < AxisComponent(_b.centroid, axis);
+				});
+		}
+	}
+
+	// Large ranges must be split even when a leaf looks cheaper
+	if (mid == _end && primitiveCount > MAX_LEAF_PRIMITIVES) {
+		mid = _start + primitiveCount / 2;
+	}
+
+	if (mid == _end) {
+		// Leaf
+		LinearBVHNode& node = nodes[nodeIndex];
+		node.primitiveOffset = (uint32_t)_start;
+		node.primitiveCount = (uint16_t)primitiveCount;
+		node.axis = 0;
+	}
+	else {
+		// Interior; the first child lands at nodeIndex + 1 by construction
+		BuildRecursive(_buildPrimitives, _start, mid, _depth + 1);
+		uint32_t secondChild = BuildRecursive(_buildPrimitives, mid, _end, _depth + 1);
+
+		// Children may have reallocated the array, so index it again
+		LinearBVHNode& node = nodes[nodeIndex];
+		node.secondChildOffset = secondChild;
+		node.primitiveCount = 0;
+		node.axis = (uint8_t)axis;
+	}
+
+	LinearBVHNode& node = nodes[nodeIndex];
+	SetNodeBounds(node, bounds);
+	node.pad = 0;
+
+	return nodeIndex;
+}
+
+size_t BVH::PartitionSAH(std::vector<BuildPrimitive>& _buildPrimitives, size_t _start, size_t _end, const AABB& _bounds, int& _axis)
+{
+	// Bound the primitives' centroids, since that's what they're binned by
+	AABB centroidBounds;
+	for (size_t i = _start; i < _end; i++) {
+		centroidBounds = AABB(centroidBounds, AABB(_buildPrimitives[i].centroid, _buildPrimitives[i].centroid));
+	}
+
+	// Finds which bin a centroid falls in along an axis
+	auto binIndex = [&centroidBounds](const BuildPrimitive& _primitive, int _axis) {
+		const Interval& axisBounds = centroidBounds.AxisInterval(_axis);
+		float centroid = AxisComponent(_primitive.centroid, _axis);
+		int bin = (int)(SAH_BIN_COUNT * (centroid - axisBounds.minimum) / axisBounds.Size());
+		return std::min(bin, SAH_BIN_COUNT - 1);
+	};
+
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = infinity;
+
+	for (int axis = 0; axis < 3; axis++) {
+		// Every centroid sits at the same point on this axis, so it can't be split
+		if (centroidBounds.AxisInterval(axis).Size() <= 0.0f)
+			continue;
+
+		// Sort primitives into bins, growing each bin's box around them
+		AABB binBoxes[SAH_BIN_COUNT];
+		size_t binCounts[SAH_BIN_COUNT] = {};
+		for (size_t i = _start; i < _end; i++) {
+			int bin = binIndex(_buildPrimitives[i], axis);
+			binBoxes[bin] = AABB(binBoxes[bin], _buildPrimitives[i].bounds);
+			binCounts[bin]++;
+		}
+
+		// Sweep from the right, recording the area and count on the right
+		// of each split plane. Split i falls between bins i and i + 1
+		float rightAreas[SAH_BIN_COUNT - 1];
+		size_t rightCounts[SAH_BIN_COUNT - 1];
+		AABB rightBox;
+		size_t rightCount = 0;
+		for (int i = SAH_BIN_COUNT - 1; i > 0; i--) {
+			rightBox = AABB(rightBox, binBoxes[i]);
+			rightCount += binCounts[i];
+			rightAreas[i - 1] = rightBox.SurfaceArea();
+			rightCounts[i - 1] = rightCount;
+		}
+
+		// Sweep from the left, costing each split as the expected
+		// number of primitives a ray through this node will test
+		AABB leftBox;
+		size_t leftCount = 0;
+		for (int i = 0; i < SAH_BIN_COUNT - 1; i++) {
+			leftBox = AABB(leftBox, binBoxes[i]);
+			leftCount += binCounts[i];
+
+			if (leftCount == 0 || rightCounts[i] == 0)
+				continue;
+
+			float cost = leftBox.SurfaceArea() * leftCount + rightAreas[i] * rightCounts[i];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = i;
+			}
+		}
+	}
+
+	// No axis could be split; halve the range unless it fits in a leaf
+	size_t primitiveCount = _end - _start;
+	if (bestAxis < 0)
+		return primitiveCount <= MAX_LEAF_PRIMITIVES ? _end : _start + primitiveCount / 2;
+
+	// Make a leaf when testing everything here is cheaper than splitting
+	float surfaceArea = _bounds.SurfaceArea();
+	float splitCost = surfaceArea > 0.0f ? TRAVERSAL_COST + bestCost / surfaceArea : infinity;
+	if (primitiveCount <= MAX_LEAF_PRIMITIVES && (float)primitiveCount <= splitCost)
+		return _end;
+
+	_axis = bestAxis;
+	auto mid = std::partition(_buildPrimitives.begin() + _start, _buildPrimitives.begin() + _end,
+		[&binIndex, bestAxis, bestSplit](const BuildPrimitive& _primitive) {
+			return binIndex(_primitive, bestAxis) <= bestSplit;
+		});
+
+	return mid - _buildPrimitives.begin();
+}
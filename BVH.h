@@ -0,0 +1,103 @@
+#pragma once
+#include "AccelerationStructure.h"
+
+#include <cstdint>
+#include <vector>
+#include "HittableList.h"
+#include "PrimitiveStore.h"
+
+// One node of a flattened BVH, sized and aligned to 32 bytes so two
+// fit in a cache line. Nodes are stored depth-first, so an interior
+// node's first child is always the node right after it
+struct alignas(32) LinearBVHNode {
+	float boundsMin[3];
+	union {
+		uint32_t primitiveOffset;	// Leaf: index of the first primitive
+		uint32_t secondChildOffset;	// Interior: index of the second child
+	};
+	float boundsMax[3];
+	uint16_t primitiveCount;	// 0 for interior nodes
+	uint8_t axis;				// Axis interior nodes were split along
+	uint8_t pad;
+};
+
+// Work done while traversing an acceleration structure, for benchmarking
+struct TraversalStats {
+	unsigned long long nodesVisited = 0;
+	unsigned long long primitivesTested = 0;
+};
+
+// A bounding volume hierarchy built with the binned surface area
+// heuristic and stored as one contiguous array of nodes. Leaves refer
+// to primitives by index, and traversal walks the array with a
+// fixed-size stack rather than recursing
+class BVH :
+	public AccelerationStructure
+{
+public:
+	// Builds a hierarchy over every object in the list
+	BVH(const HittableList& _list);
+	// Takes ownership of a hierarchy built elsewhere, such as by LBVHBuilder.
+	// Nodes must follow the layout described on LinearBVHNode
+	BVH(std::vector<LinearBVHNode>&& _nodes, std::vector<shared_ptr<Hittable>>&& _primitives);
+
+	bool Intersect(const Ray& _ray, Interval _rayT, RayHit& _hit) const override;
+	// Traverses the tree once for the whole packet. Nodes are culled for every
+	// ray at once with the packet's interval test, then skipped for the rays
+	// before the first one that really hits them
+	void IntersectPacket(const RayPacket& _packet, Interval _rayT, RayHit* _hits) const override;
+	// Stops at the first primitive hit, without narrowing the search to it
+	bool Occluded(const Ray& _ray, Interval _rayT) const override;
+	AABB BoundingBox() const override;
+	void Refit() override;
+	float ComputeSAHCost() const override;
+
+	// Same as Intersect, but also adds the work done to _stats
+	bool IntersectWithStats(const Ray& _ray, Interval _rayT, RayHit& _hit, TraversalStats& _stats) const;
+	// Same as Occluded, but also adds the work done to _stats
+	bool OccludedWithStats(const Ray& _ray, Interval _rayT, TraversalStats& _stats) const;
+
+	size_t GetNodeCount() const;
+	const std::vector<LinearBVHNode>& GetNodes() const;
+	const std::vector<shared_ptr<Hittable>>& GetPrimitives() const;
+
+	// Deepest the tree is allowed to get; traversal's stack is this big
+	static const int MAX_DEPTH = 64;
+	// Most primitives a leaf may hold
+	static const int MAX_LEAF_PRIMITIVES = 4;
+	// Cost of visiting a node, relative to testing one primitive
+	static constexpr float TRAVERSAL_COST = 1.0f;
+
+private:
+	// Depth after which nodes are split at the median rather than by SAH,
+	// which keeps the tree inside MAX_DEPTH for any realistic scene
+	static const int MAX_SAH_DEPTH = 32;
+	// Number of buckets centroids are sorted into when evaluating splits
+	static const int SAH_BIN_COUNT = 16;
+
+	// Per-primitive data kept only while building
+	struct BuildPrimitive {
+		AABB bounds;
+		DirectX::XMFLOAT3 centroid;
+		uint32_t index;
+	};
+
+	std::vector<LinearBVHNode> nodes;
+	// Primitives in the order leaves refer to them
+	std::vector<shared_ptr<Hittable>> primitives;
+	// The same primitives, in the same order, for leaves to test
+	PrimitiveStore primitiveStore;
+
+	// Finds the closest hit, or with ANY_HIT returns at the first hit without
+	// filling in _hit, optionally counting the work done into _stats
+	template<bool COUNT_STATS, bool ANY_HIT = false>
+	bool Traverse(const Ray& _ray, Interval _rayT, RayHit& _hit, TraversalStats* _stats) const;
+
+	// Appends the subtree over _buildPrimitives[_start, _end) to the node
+	// array, reordering that range, and returns the subtree's root index
+	uint32_t BuildRecursive(std::vector<BuildPrimitive>& _buildPrimitives, size_t _start, size_t _end, int _depth);
+	// Picks the cheapest binned-SAH split of the range and partitions around it.
+	// Returns the index the second group starts at, or _end if a leaf is cheaper
+	size_t PartitionSAH(std::vector<BuildPrimitive>& _buildPrimitives, size_t _start, size_t _end, const AABB& _bounds, int& _axis);
+};
+
@@ -0,0 +1,1119 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "BVH.h"
+#include "DispatchMode.h"
+#include "Graphics.h"
+#include "HittableList.h"
+#include "LBVHBuilder.h"
+#include "LightList.h"
+#include "SampleWarps.h"
+#include "Scene.h"
+#include "Sphere.h"
+#include "SphereBatch.h"
+#include "VectorHelpers.h"
+#include "WideBVH.h"
+#include "Window.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Returns seconds elapsed since _start
+	double SecondsSince(std::chrono::high_resolution_clock::time_point _start)
+	{
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - _start).count();
+	}
+
+	// Draws _count floats from the current random mode and prints the rate
+	void TimeRandomMode(const char* _name, RandomMode _mode, unsigned int _count)
+	{
+		RandomMode previousMode = Random::Mode;
+		Random::Mode = _mode;
+
+		// Sum the results so the loop can't be optimized away
+		double sum = 0.0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < _count; i++) {
+			sum += RandomFloat();
+		}
+		double seconds = SecondsSince(start);
+
+		printf("%-16s %8.2f M/s  (mean %.4f)\n", _name, _count / seconds / 1e6, sum / _count);
+		Random::Mode = previousMode;
+	}
+
+	// Fills a cube with randomly placed spheres, sized so the
+	// density stays the same whatever the count
+	HittableList MakeSphereField(unsigned int _count)
+	{
+		HittableList list;
+		// Only hit tests are timed, so every sphere can share material 0
+		MaterialIndex material = 0;
+		float halfSize = 2.0f * std::cbrt((float)_count);
+
+		for (unsigned int i = 0; i < _count; i++) {
+			XMFLOAT3 center;
+			XMStoreFloat3(&center, RandomVector(-halfSize, halfSize));
+			list.Add(make_shared<Sphere>(center, RandomFloat(0.2f, 0.5f), material));
+		}
+
+		return list;
+	}
+
+	// Makes rays starting inside the sphere field in random directions
+	std::vector<Ray> MakeRandomRays(unsigned int _count, float _halfSize)
+	{
+		std::vector<Ray> rays(_count);
+		for (Ray& ray : rays) {
+			XMStoreFloat3(&ray.Origin, RandomVector(-_halfSize, _halfSize));
+			XMStoreFloat3(&ray.Direction, RandomUnitVector());
+		}
+		return rays;
+	}
+
+	// Traces every ray against _world and prints the rate
+	void TimeClosestHits(const char* _name, const Hittable& _world, const std::vector<Ray>& _rays)
+	{
+		HitRecord record;
+		unsigned int hitCount = 0;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (const Ray& ray : _rays) {
+			if (_world.Hit(ray, Interval(0.001f, infinity), record)) {
+				hitCount++;
+			}
+		}
+		double seconds = SecondsSince(start);
+
+		printf("  %-14s %10.3f Mrays/s  (%u / %zu hit)\n", _name, _rays.size() / seconds / 1e6, hitCount, _rays.size());
+	}
+
+	// Times an acceleration structure like TimeClosestHits, then traces the
+	// rays again through IntersectWithStats and prints the work done per ray.
+	// Counting is kept out of the timed pass so it doesn't skew the rate
+	template<typename ACCELERATOR>
+	void TimeTraversal(const char* _name, const ACCELERATOR& _accelerator, const std::vector<Ray>& _rays)
+	{
+		TimeClosestHits(_name, _accelerator, _rays);
+
+		RayHit hit;
+		TraversalStats stats;
+		for (const Ray& ray : _rays) {
+			_accelerator.IntersectWithStats(ray, Interval(0.001f, infinity), hit, stats);
+		}
+
+		printf("  %-14s %10.2f nodes/ray, %.2f primitives/ray, %zu nodes\n", "",
+			(double)stats.nodesVisited / _rays.size(),
+			(double)stats.primitivesTested / _rays.size(),
+			_accelerator.GetNodeCount());
+	}
+
+	// A ray toward a point, and how far away the point is
+	struct ShadowRay {
+		Ray ray;
+		float length;
+	};
+
+	// Makes rays between random pairs of points in the sphere field, as
+	// shadow rays toward lights are
+	std::vector<ShadowRay> MakeShadowRays(unsigned int _count, float _halfSize)
+	{
+		std::vector<ShadowRay> rays(_count);
+		for (ShadowRay& shadowRay : rays) {
+			XMVECTOR from = RandomVector(-_halfSize, _halfSize);
+			XMVECTOR toTarget = RandomVector(-_halfSize, _halfSize) - from;
+			XMStoreFloat(&shadowRay.length, XMVector3Length(toTarget));
+			XMStoreFloat3(&shadowRay.ray.Origin, from);
+			XMStoreFloat3(&shadowRay.ray.Direction, XMVector3Normalize(toTarget));
+		}
+		return rays;
+	}
+
+	// Traces every shadow ray against _world as a closest-hit query and as
+	// an any-hit query, prints both rates, and checks they agree
+	void TimeOcclusion(const char* _name, const Hittable& _world, const std::vector<ShadowRay>& _rays)
+	{
+		std::vector<bool> isBlocked(_rays.size());
+		RayHit hit;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < _rays.size(); i++) {
+			isBlocked[i] = _world.Intersect(_rays[i].ray, Interval(0.001f, _rays[i].length), hit);
+		}
+		double closestSeconds = SecondsSince(start);
+
+		unsigned int blockedCount = 0;
+		unsigned int mismatchCount = 0;
+		start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < _rays.size(); i++) {
+			bool isOccluded = _world.Occluded(_rays[i].ray, Interval(0.001f, _rays[i].length));
+			blockedCount += isOccluded;
+			mismatchCount += isOccluded != isBlocked[i];
+		}
+		double anySeconds = SecondsSince(start);
+
+		printf("  %-14s closest %8.3f Mrays/s, any %8.3f Mrays/s (%.2fx)  %u / %zu blocked%s\n",
+			_name, _rays.size() / closestSeconds / 1e6, _rays.size() / anySeconds / 1e6, closestSeconds / anySeconds,
+			blockedCount, _rays.size(), mismatchCount == 0 ? "" : "  MISMATCH");
+	}
+
+	// Times an acceleration structure like TimeOcclusion, then traces the
+	// rays again counting the work done per ray by each query
+	template<typename ACCELERATOR>
+	void TimeOcclusionTraversal(const char* _name, const ACCELERATOR& _accelerator, const std::vector<ShadowRay>& _rays)
+	{
+		TimeOcclusion(_name, _accelerator, _rays);
+
+		RayHit hit;
+		TraversalStats closestStats;
+		TraversalStats anyStats;
+		for (const ShadowRay& shadowRay : _rays) {
+			_accelerator.IntersectWithStats(shadowRay.ray, Interval(0.001f, shadowRay.length), hit, closestStats);
+			_accelerator.OccludedWithStats(shadowRay.ray, Interval(0.001f, shadowRay.length), anyStats);
+		}
+
+		printf("  %-14s closest %6.2f nodes/ray, %.2f primitives/ray; any %6.2f nodes/ray, %.2f primitives/ray\n", "",
+			(double)closestStats.nodesVisited / _rays.size(), (double)closestStats.primitivesTested / _rays.size(),
+			(double)anyStats.nodesVisited / _rays.size(), (double)anyStats.primitivesTested / _rays.size());
+	}
+
+	// Prints a built tree's build rate, SAH cost and closest-hit rate
+	void ReportBuild(const char* _name, const BVH& _bvh, double _buildSeconds, unsigned int _primitiveCount, const std::vector<Ray>& _rays)
+	{
+		printf("  %-14s %8.3f s  (%7.1f ms per million)  SAH cost %7.2f\n",
+			_name, _buildSeconds, _buildSeconds * 1000.0 / (_primitiveCount / 1e6), _bvh.ComputeSAHCost());
+		TimeClosestHits("", _bvh, _rays);
+	}
+
+	// Renders the full image with the given thread count and returns its pixels
+	std::vector<XMFLOAT4> RenderWithThreads(Camera& _camera, const Hittable& _world, const MaterialTable& _materials, CPUTexture& _cpuTexture, unsigned int _threadCount)
+	{
+		_camera.SetThreadCount(_threadCount);
+		_camera.RenderImage(_world, _materials, _cpuTexture);
+
+		std::vector<XMFLOAT4> pixels;
+		pixels.reserve(_cpuTexture.GetWidth() * _cpuTexture.GetHeight());
+		for (unsigned int y = 0; y < _cpuTexture.GetHeight(); y++) {
+			for (unsigned int x = 0; x < _cpuTexture.GetWidth(); x++) {
+				pixels.push_back(_cpuTexture.GetColor(x, y));
+			}
+		}
+		return pixels;
+	}
+
+	// The rejection samplers VectorHelpers.h used before its closed-form
+	// warps, kept to time against them
+	XMVECTOR RejectionUnitVector()
+	{
+		while (true) {
+			XMVECTOR p = RandomVector(-1.0f, 1.0f);
+			float lengthSquared;
+			XMStoreFloat(&lengthSquared, XMVector3LengthSq(p));
+			if (std::numeric_limits<float>::denorm_min() < lengthSquared && lengthSquared <= 1.0f)
+				return XMVector3Normalize(p);
+		}
+	}
+
+	XMFLOAT2 RejectionInUnitDisk()
+	{
+		while (true) {
+			float x = RandomFloat(-1.0f, 1.0f);
+			float y = RandomFloat(-1.0f, 1.0f);
+			if (x * x + y * y < 1.0f)
+				return XMFLOAT2(x, y);
+		}
+	}
+
+	// Times _count calls of _sample, summing the results so they can't be
+	// optimized away, and prints the rate
+	template<typename SAMPLE>
+	void TimeWarp(const char* _name, size_t _count, SAMPLE _sample)
+	{
+		XMVECTOR sum = XMVectorZero();
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < _count; i++) {
+			sum += _sample(i);
+		}
+		double seconds = SecondsSince(start);
+
+		XMFLOAT3 mean;
+		XMStoreFloat3(&mean, XMVectorScale(sum, 1.0f / _count));
+		printf("  %-26s %8.2f M/s  (mean %6.3f %6.3f %6.3f)\n", _name, _count / seconds / 1e6, mean.x, mean.y, mean.z);
+	}
+
+	// Times a batch warp over every point in _u and _v, and prints the rate
+	template<typename WARP>
+	void TimeBatchWarp(const char* _name, const std::vector<float>& _u, std::vector<float>& _x, WARP _warp)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		_warp();
+		double seconds = SecondsSince(start);
+
+		double sum = 0.0;
+		for (float x : _x) {
+			sum += x;
+		}
+		printf("  %-26s %8.2f M/s  (mean x %6.3f)\n", _name, _u.size() / seconds / 1e6, sum / _x.size());
+	}
+
+	// Root-mean-square difference between two images' color channels
+	double ImageRMSE(const std::vector<XMFLOAT4>& _pixels, const std::vector<XMFLOAT4>& _reference)
+	{
+		double sum = 0.0;
+		for (size_t i = 0; i < _pixels.size(); i++) {
+			double dx = _pixels[i].x - _reference[i].x;
+			double dy = _pixels[i].y - _reference[i].y;
+			double dz = _pixels[i].z - _reference[i].z;
+			sum += dx * dx + dy * dy + dz * dz;
+		}
+		return std::sqrt(sum / (_pixels.size() * 3.0));
+	}
+
+	// Mean of every pixel's color channels
+	double ImageMean(const std::vector<XMFLOAT4>& _pixels)
+	{
+		double sum = 0.0;
+		for (const XMFLOAT4& pixel : _pixels) {
+			sum += pixel.x + pixel.y + pixel.z;
+		}
+		return sum / (_pixels.size() * 3.0);
+	}
+}
+
+void Benchmark::RunRandomBenchmark()
+{
+	const unsigned int count = 50000000;
+
+	printf("\n--- Random Number Benchmark (%u floats) ---\n", count);
+
+	// Old path, for reference
+	{
+		double sum = 0.0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < count; i++) {
+			sum += std::rand() / (RAND_MAX + 1.0f);
+		}
+		double seconds = SecondsSince(start);
+		printf("%-16s %8.2f M/s  (mean %.4f)\n", "std::rand", count / seconds / 1e6, sum / count);
+	}
+
+	TimeRandomMode("PCG32", RandomMode::Pcg32, count);
+	TimeRandomMode("xoshiro128+", RandomMode::Xoshiro128Plus, count);
+	TimeRandomMode("Counter-based", RandomMode::CounterBased, count);
+}
+
+void Benchmark::RunReproducibilityCheck(Camera& _camera, const Hittable& _world, const MaterialTable& _materials)
+{
+	// Save the settings this check changes
+	RandomMode previousMode = Random::Mode;
+	unsigned int previousThreadCount = _camera.GetThreadCount();
+	int previousSamples = _camera.GetSamplesPerPixel();
+
+	Random::Mode = RandomMode::CounterBased;
+	_camera.SetSamplesPerPixel(8);
+
+	// Match the camera's current texture so the viewport lines up
+	CPUTexture texture(
+		(unsigned int)(Window::Width() * _camera.GetTextureScale()),
+		(unsigned int)(Window::Height() * _camera.GetTextureScale()),
+		Graphics::Device,
+		Graphics::Context);
+
+	printf("\n--- Reproducibility Check (%ux%u, %d spp) ---\n", texture.GetWidth(), texture.GetHeight(), _camera.GetSamplesPerPixel());
+
+	unsigned int threadCounts[] = { 1, 2, std::thread::hardware_concurrency() };
+	std::vector<XMFLOAT4> reference;
+	bool allMatch = true;
+
+	for (unsigned int threadCount : threadCounts) {
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<XMFLOAT4> pixels = RenderWithThreads(_camera, _world, _materials, texture, threadCount);
+		double seconds = SecondsSince(start);
+
+		if (reference.empty()) {
+			reference = pixels;
+		}
+
+		// Compare raw bits, not values, so the check really is bit-exact
+		size_t mismatches = 0;
+		for (size_t i = 0; i < pixels.size(); i++) {
+			if (memcmp(&pixels[i], &reference[i], sizeof(XMFLOAT4)) != 0) {
+				mismatches++;
+			}
+		}
+		allMatch = allMatch && mismatches == 0;
+
+		printf("%2u thread(s): %7.3f s, %zu mismatched pixels\n", threadCount, seconds, mismatches);
+	}
+
+	printf("Reproducibility: %s\n", allMatch ? "PASS" : "FAIL");
+
+	// Restore settings
+	_camera.SetSamplesPerPixel(previousSamples);
+	_camera.SetThreadCount(previousThreadCount);
+	Random::Mode = previousMode;
+}
+
+void Benchmark::RunRenderBenchmark(Camera& _camera, const Hittable& _world, const MaterialTable& _materials)
+{
+	const int runCount = 3;
+
+	// Save the settings this benchmark changes
+	unsigned int previousThreadCount = _camera.GetThreadCount();
+	int previousSamples = _camera.GetSamplesPerPixel();
+
+	_camera.SetThreadCount(std::thread::hardware_concurrency());
+	_camera.SetSamplesPerPixel(16);
+
+	CPUTexture texture(
+		(unsigned int)(Window::Width() * _camera.GetTextureScale()),
+		(unsigned int)(Window::Height() * _camera.GetTextureScale()),
+		Graphics::Device,
+		Graphics::Context);
+
+	printf("\n--- Render Benchmark (%ux%u, %d spp, %u threads) ---\n",
+		texture.GetWidth(), texture.GetHeight(), _camera.GetSamplesPerPixel(), _camera.GetThreadCount());
+
+	// Time the same scene calling into primitives and materials both ways
+	DispatchMode previousMode = Dispatch::Mode;
+	DispatchMode modes[] = { DispatchMode::Virtual, DispatchMode::ClosedSet };
+	const char* modeNames[] = { "Virtual dispatch", "Closed-set dispatch" };
+	double samples = (double)texture.GetWidth() * texture.GetHeight() * _camera.GetSamplesPerPixel();
+	double modeSeconds[2] = {};
+
+	for (int mode = 0; mode < 2; mode++) {
+		Dispatch::Mode = modes[mode];
+		printf("%s:\n", modeNames[mode]);
+
+		// Keep the best run, since that's the one least disturbed by anything else
+		double bestSeconds = infinity;
+		for (int run = 0; run < runCount; run++) {
+			auto start = std::chrono::high_resolution_clock::now();
+			_camera.RenderImage(_world, _materials, texture);
+			double seconds = SecondsSince(start);
+			bestSeconds = std::min(bestSeconds, seconds);
+			printf("Run %d: %7.3f s\n", run + 1, seconds);
+		}
+
+		printf("Best:  %7.3f s  (%.3f M camera samples/s)\n", bestSeconds, samples / bestSeconds / 1e6);
+		modeSeconds[mode] = bestSeconds;
+	}
+	printf("Closed-set speedup: %.2fx\n", modeSeconds[0] / modeSeconds[1]);
+
+	// Time generating the same camera rays without tracing them, on one
+	// thread, and compare with the thread time the whole render took
+	printf("Camera ray generation (1 thread):\n");
+	double renderThreadSeconds = modeSeconds[1] * _camera.GetThreadCount();
+	const char* generatorNames[] = { "One at a time", "Batched" };
+	double generatorSeconds[2] = {};
+	for (int useBatches = 0; useBatches < 2; useBatches++) {
+		double bestSeconds = infinity;
+		float checksum = 0.0f;
+		for (int run = 0; run < runCount; run++) {
+			auto start = std::chrono::high_resolution_clock::now();
+			checksum = _camera.GenerateCameraRays(texture.GetWidth(), texture.GetHeight(), _camera.GetSamplesPerPixel(), useBatches);
+			bestSeconds = std::min(bestSeconds, SecondsSince(start));
+		}
+		generatorSeconds[useBatches] = bestSeconds;
+		printf("%-14s %7.3f s  (%6.1f M rays/s, %4.1f%% of render thread time)  checksum %.3f\n",
+			generatorNames[useBatches], bestSeconds, samples / bestSeconds / 1e6, bestSeconds / renderThreadSeconds * 100.0, checksum);
+	}
+	printf("Batched speedup: %.2fx\n", generatorSeconds[0] / generatorSeconds[1]);
+
+	// Restore settings
+	Dispatch::Mode = previousMode;
+	_camera.SetSamplesPerPixel(previousSamples);
+	_camera.SetThreadCount(previousThreadCount);
+}
+
+void Benchmark::RunPathLengthBenchmark(Camera& _camera, const Hittable& _world, const MaterialTable& _materials)
+{
+	// Save the settings this benchmark changes
+	bool previousRoulette = _camera.GetRussianRoulette();
+	int previousSamples = _camera.GetSamplesPerPixel();
+
+	_camera.SetSamplesPerPixel(16);
+
+	CPUTexture texture(
+		(unsigned int)(Window::Width() * _camera.GetTextureScale()),
+		(unsigned int)(Window::Height() * _camera.GetTextureScale()),
+		Graphics::Device,
+		Graphics::Context);
+
+	printf("\n--- Path Length Benchmark (%ux%u, %d spp, max depth %d, roulette from bounce %d) ---\n",
+		texture.GetWidth(), texture.GetHeight(), _camera.GetSamplesPerPixel(), _camera.GetMaxDepth(), _camera.GetRouletteMinDepth());
+
+	bool rouletteSettings[] = { false, true };
+	for (bool useRoulette : rouletteSettings) {
+		_camera.SetRussianRoulette(useRoulette);
+		_camera.ResetPathStats();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		_camera.RenderImage(_world, _materials, texture);
+		double seconds = SecondsSince(start);
+
+		// Roulette only adds noise, so the image should be about as bright
+		double brightness = 0.0;
+		for (unsigned int y = 0; y < texture.GetHeight(); y++) {
+			for (unsigned int x = 0; x < texture.GetWidth(); x++) {
+				XMFLOAT4 color = texture.GetColor(x, y);
+				brightness += (color.x + color.y + color.z) / 3.0;
+			}
+		}
+		brightness /= (double)texture.GetWidth() * texture.GetHeight();
+
+		PathStats stats = _camera.GetPathStats();
+		printf("%-16s %6.3f s  %5.2f rays/path  mean brightness %.4f\n",
+			useRoulette ? "Russian roulette" : "Fixed depth", seconds, stats.AverageLength(), brightness);
+	}
+
+	// Restore settings
+	_camera.SetRussianRoulette(previousRoulette);
+	_camera.SetSamplesPerPixel(previousSamples);
+}
+
+void Benchmark::RunWavefrontBenchmark(Camera& _camera, const Hittable& _world, const MaterialTable& _materials)
+{
+	// Save the settings this benchmark changes
+	RandomMode previousRandomMode = Random::Mode;
+	RenderMode previousRenderMode = _camera.GetRenderMode();
+	int previousSamples = _camera.GetSamplesPerPixel();
+
+	// Counter-based numbers are keyed by pixel, sample and bounce, so both
+	// modes should make exactly the same image
+	Random::Mode = RandomMode::CounterBased;
+	_camera.SetSamplesPerPixel(16);
+
+	CPUTexture texture(
+		(unsigned int)(Window::Width() * _camera.GetTextureScale()),
+		(unsigned int)(Window::Height() * _camera.GetTextureScale()),
+		Graphics::Device,
+		Graphics::Context);
+
+	printf("\n--- Wavefront Benchmark (%ux%u, %d spp, %u threads) ---\n",
+		texture.GetWidth(), texture.GetHeight(), _camera.GetSamplesPerPixel(), _camera.GetThreadCount());
+
+	_camera.SetRenderMode(RenderMode::Megakernel);
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<XMFLOAT4> megakernelPixels = RenderWithThreads(_camera, _world, _materials, texture, _camera.GetThreadCount());
+	printf("Megakernel: %7.3f s\n", SecondsSince(start));
+
+	_camera.SetRenderMode(RenderMode::Wavefront);
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<XMFLOAT4> wavefrontPixels = RenderWithThreads(_camera, _world, _materials, texture, _camera.GetThreadCount());
+	printf("Wavefront:  %7.3f s\n", SecondsSince(start));
+
+	const WavefrontStageTimes& times = _camera.GetWavefrontStageTimes();
+	printf("  generate %.3f, intersect %.3f, sort %.3f, shade %.3f, compact %.3f, accumulate %.3f s\n",
+		times.generateSeconds, times.intersectSeconds, times.sortSeconds,
+		times.shadeSeconds, times.compactSeconds, times.accumulateSeconds);
+
+	size_t mismatches = 0;
+	for (size_t i = 0; i < megakernelPixels.size(); i++) {
+		if (memcmp(&megakernelPixels[i], &wavefrontPixels[i], sizeof(XMFLOAT4)) != 0) {
+			mismatches++;
+		}
+	}
+	printf("Images %s (%zu pixels differ)\n", mismatches == 0 ? "match" : "DIFFER", mismatches);
+
+	// Restore settings
+	_camera.SetSamplesPerPixel(previousSamples);
+	_camera.SetRenderMode(previousRenderMode);
+	Random::Mode = previousRandomMode;
+}
+
+void Benchmark::RunPacketBenchmark(Camera& _camera, const Hittable& _world, const MaterialTable& _materials)
+{
+	// Save the settings this benchmark changes
+	RandomMode previousRandomMode = Random::Mode;
+	unsigned int previousPacketSize = _camera.GetPacketSize();
+	int previousMaxDepth = _camera.GetMaxDepth();
+	int previousSamples = _camera.GetSamplesPerPixel();
+
+	// Counter-based numbers make packets and single rays render the same image
+	Random::Mode = RandomMode::CounterBased;
+	_camera.SetSamplesPerPixel(16);
+
+	CPUTexture texture(
+		(unsigned int)(Window::Width() * _camera.GetTextureScale()),
+		(unsigned int)(Window::Height() * _camera.GetTextureScale()),
+		Graphics::Device,
+		Graphics::Context);
+
+	printf("\n--- Packet Benchmark (%ux%u, %d spp, %u threads) ---\n",
+		texture.GetWidth(), texture.GetHeight(), _camera.GetSamplesPerPixel(), _camera.GetThreadCount());
+
+	int maxDepths[] = { 1, previousMaxDepth };
+	unsigned int packetSizes[] = { 1, 4, 8 };
+	for (int maxDepth : maxDepths) {
+		_camera.SetMaxDepth(maxDepth);
+		printf("Max depth %d:\n", maxDepth);
+
+		std::vector<XMFLOAT4> reference;
+		for (unsigned int packetSize : packetSizes) {
+			_camera.SetPacketSize(packetSize);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			std::vector<XMFLOAT4> pixels = RenderWithThreads(_camera, _world, _materials, texture, _camera.GetThreadCount());
+			double seconds = SecondsSince(start);
+
+			if (reference.empty()) {
+				reference = pixels;
+			}
+			bool isMatch = memcmp(pixels.data(), reference.data(), pixels.size() * sizeof(XMFLOAT4)) == 0;
+
+			printf("  %ux%u %-8s %7.3f s  %s\n", packetSize, packetSize, packetSize > 1 ? "packets" : "rays", seconds, isMatch ? "" : "IMAGE DIFFERS");
+		}
+	}
+
+	// Restore settings
+	_camera.SetSamplesPerPixel(previousSamples);
+	_camera.SetMaxDepth(previousMaxDepth);
+	_camera.SetPacketSize(previousPacketSize);
+	Random::Mode = previousRandomMode;
+}
+
+void Benchmark::RunAdaptiveSamplingBenchmark(Camera& _camera, const Hittable& _world, const MaterialTable& _materials)
+{
+	// Save the settings this benchmark changes
+	RandomMode previousRandomMode = Random::Mode;
+	bool previousAdaptive = _camera.GetAdaptiveSampling();
+	bool previousShowSampleCounts = _camera.GetShowSampleCounts();
+	int previousSamples = _camera.GetSamplesPerPixel();
+
+	Random::Mode = RandomMode::CounterBased;
+	_camera.SetShowSampleCounts(false);
+
+	CPUTexture texture(
+		(unsigned int)(Window::Width() * _camera.GetTextureScale()),
+		(unsigned int)(Window::Height() * _camera.GetTextureScale()),
+		Graphics::Device,
+		Graphics::Context);
+	unsigned int threadCount = _camera.GetThreadCount();
+
+	printf("\n--- Adaptive Sampling Benchmark (%ux%u, threshold %.3f, min %d samples) ---\n",
+		texture.GetWidth(), texture.GetHeight(), _camera.GetAdaptiveThreshold(), _camera.GetAdaptiveMinSamples());
+
+	// Every image is measured against a fixed-rate render with far more samples
+	const int referenceSamples = 512;
+	_camera.SetAdaptiveSampling(false);
+	_camera.SetSamplesPerPixel(referenceSamples);
+	std::vector<XMFLOAT4> reference = RenderWithThreads(_camera, _world, _materials, texture, threadCount);
+	printf("Reference: %d spp\n", referenceSamples);
+
+	// An adaptive image should match the error of a fixed one with more samples
+	int sampleCounts[] = { 32, 64, 128 };
+	bool adaptiveSettings[] = { false, true };
+	for (int samples : sampleCounts) {
+		for (bool isAdaptive : adaptiveSettings) {
+			_camera.SetAdaptiveSampling(isAdaptive);
+			_camera.SetSamplesPerPixel(samples);
+			_camera.ResetPathStats();
+
+			auto start = std::chrono::high_resolution_clock::now();
+			std::vector<XMFLOAT4> pixels = RenderWithThreads(_camera, _world, _materials, texture, threadCount);
+			double seconds = SecondsSince(start);
+
+			PathStats stats = _camera.GetPathStats();
+			printf("  %-8s %3d spp %7.3f s  %6.2f samples/pixel  %8.2f M rays  RMSE %.5f\n",
+				isAdaptive ? "Adaptive" : "Fixed", samples, seconds,
+				(double)stats.pathCount / reference.size(), stats.segmentCount / 1e6, ImageRMSE(pixels, reference));
+		}
+	}
+
+	// Restore settings
+	_camera.SetSamplesPerPixel(previousSamples);
+	_camera.SetShowSampleCounts(previousShowSampleCounts);
+	_camera.SetAdaptiveSampling(previousAdaptive);
+	Random::Mode = previousRandomMode;
+}
+
+void Benchmark::RunSamplerBenchmark(Camera& _camera, const Hittable& _world, const MaterialTable& _materials)
+{
+	// Save the settings this benchmark changes
+	RandomMode previousRandomMode = Random::Mode;
+	SamplerType previousSampler = _camera.GetSamplerType();
+	bool previousAdaptive = _camera.GetAdaptiveSampling();
+	int previousSamples = _camera.GetSamplesPerPixel();
+
+	Random::Mode = RandomMode::CounterBased;
+	_camera.SetAdaptiveSampling(false);
+
+	CPUTexture texture(
+		(unsigned int)(Window::Width() * _camera.GetTextureScale()),
+		(unsigned int)(Window::Height() * _camera.GetTextureScale()),
+		Graphics::Device,
+		Graphics::Context);
+	unsigned int threadCount = _camera.GetThreadCount();
+
+	printf("\n--- Sampler Convergence Benchmark (%ux%u) ---\n", texture.GetWidth(), texture.GetHeight());
+
+	// Measure every sampler against a render with far more samples. It's drawn
+	// under another seed, so it shares no samples with the images measured
+	const int referenceSamples = 1024;
+	uint32_t previousSeed = Random::Seed;
+	Random::Seed = previousSeed + 1;
+	_camera.SetSamplerType(SamplerType::Independent);
+	_camera.SetSamplesPerPixel(referenceSamples);
+	std::vector<XMFLOAT4> reference = RenderWithThreads(_camera, _world, _materials, texture, threadCount);
+	Random::Seed = previousSeed;
+	printf("Reference: independent, %d spp\n", referenceSamples);
+
+	struct NamedSampler {
+		const char* name;
+		SamplerType type;
+	};
+	NamedSampler samplers[] = {
+		{ "Independent", SamplerType::Independent },
+		{ "Sobol", SamplerType::Sobol },
+		{ "Halton", SamplerType::Halton },
+		{ "Blue noise", SamplerType::BlueNoise },
+	};
+
+	// Independent numbers' error halves with every 4x the samples; better
+	// samplers should fall faster, especially in pixels with few dimensions
+	int sampleCounts[] = { 4, 16, 64 };
+	for (int samples : sampleCounts) {
+		_camera.SetSamplesPerPixel(samples);
+		printf("%d spp:\n", samples);
+
+		for (const NamedSampler& sampler : samplers) {
+			_camera.SetSamplerType(sampler.type);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			std::vector<XMFLOAT4> pixels = RenderWithThreads(_camera, _world, _materials, texture, threadCount);
+			double seconds = SecondsSince(start);
+
+			printf("  %-12s %7.3f s  RMSE %.5f\n", sampler.name, seconds, ImageRMSE(pixels, reference));
+		}
+	}
+
+	// Restore settings
+	_camera.SetSamplesPerPixel(previousSamples);
+	_camera.SetAdaptiveSampling(previousAdaptive);
+	_camera.SetSamplerType(previousSampler);
+	Random::Mode = previousRandomMode;
+}
+
+void Benchmark::RunLightSamplingBenchmark(Camera& _camera, const Hittable& _world, const MaterialTable& _materials)
+{
+	std::shared_ptr<const LightList> lights = _camera.GetLights();
+	if (!lights || lights->GetCount() == 0) {
+		printf("\n--- Light Sampling Benchmark ---\nNo lights in the scene, skipping\n");
+		return;
+	}
+
+	// Save the settings this benchmark changes
+	RandomMode previousRandomMode = Random::Mode;
+	LightSampling previousLightSampling = _camera.GetLightSampling();
+	LightSelection previousLightSelection = _camera.GetLightSelection();
+	bool previousAdaptive = _camera.GetAdaptiveSampling();
+	int previousSamples = _camera.GetSamplesPerPixel();
+
+	Random::Mode = RandomMode::CounterBased;
+	_camera.SetAdaptiveSampling(false);
+
+	CPUTexture texture(
+		(unsigned int)(Window::Width() * _camera.GetTextureScale()),
+		(unsigned int)(Window::Height() * _camera.GetTextureScale()),
+		Graphics::Device,
+		Graphics::Context);
+	unsigned int threadCount = _camera.GetThreadCount();
+
+	printf("\n--- Light Sampling Benchmark (%ux%u, %zu lights) ---\n", texture.GetWidth(), texture.GetHeight(), lights->GetCount());
+
+	// The reference is drawn under another seed, so it shares no samples
+	// with the images measured
+	const int referenceSamples = 1024;
+	uint32_t previousSeed = Random::Seed;
+	Random::Seed = previousSeed + 1;
+	_camera.SetLightSampling(LightSampling::PowerHeuristic);
+	_camera.SetLightSelection(LightSelection::BVH);
+	_camera.SetSamplesPerPixel(referenceSamples);
+	std::vector<XMFLOAT4> reference = RenderWithThreads(_camera, _world, _materials, texture, threadCount);
+	printf("Reference: power heuristic, %d spp\n", referenceSamples);
+
+	// Both ways of picking lights estimate the same image, so at the
+	// reference's sample count their means should agree closely
+	_camera.SetLightSelection(LightSelection::Uniform);
+	std::vector<XMFLOAT4> uniformReference = RenderWithThreads(_camera, _world, _materials, texture, threadCount);
+	Random::Seed = previousSeed;
+	double bvhMean = ImageMean(reference);
+	double uniformMean = ImageMean(uniformReference);
+	printf("Mean with light BVH %.5f, uniform %.5f (%+.2f%%)\n", bvhMean, uniformMean, 100.0 * (bvhMean / uniformMean - 1.0));
+
+	struct NamedLightSampling {
+		const char* name;
+		LightSampling lightSampling;
+		LightSelection lightSelection;
+	};
+	NamedLightSampling strategies[] = {
+		{ "Scatter only", LightSampling::Off, LightSelection::BVH },
+		{ "Lights only", LightSampling::LightsOnly, LightSelection::BVH },
+		{ "Balance MIS", LightSampling::BalanceHeuristic, LightSelection::BVH },
+		{ "Power MIS", LightSampling::PowerHeuristic, LightSelection::Uniform },
+		{ "Power MIS BVH", LightSampling::PowerHeuristic, LightSelection::BVH },
+	};
+
+	// Small lights are rarely hit by scattered rays, so scattering alone
+	// should be far noisier. Lights alone struggle on fuzzy metal, where the
+	// lobe is narrower than a light; MIS should do well on both. Picking
+	// lights through the BVH favors nearby ones over the distant majority
+	int sampleCounts[] = { 4, 16, 64 };
+	for (int samples : sampleCounts) {
+		_camera.SetSamplesPerPixel(samples);
+		printf("%d spp:\n", samples);
+
+		for (const NamedLightSampling& strategy : strategies) {
+			_camera.SetLightSampling(strategy.lightSampling);
+			_camera.SetLightSelection(strategy.lightSelection);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			std::vector<XMFLOAT4> pixels = RenderWithThreads(_camera, _world, _materials, texture, threadCount);
+			double seconds = SecondsSince(start);
+
+			printf("  %-14s %7.3f s  RMSE %.5f\n", strategy.name, seconds, ImageRMSE(pixels, reference));
+		}
+	}
+
+	// Restore settings
+	_camera.SetSamplesPerPixel(previousSamples);
+	_camera.SetAdaptiveSampling(previousAdaptive);
+	_camera.SetLightSampling(previousLightSampling);
+	_camera.SetLightSelection(previousLightSelection);
+	Random::Mode = previousRandomMode;
+}
+
+void Benchmark::RunWarpBenchmark()
+{
+	RandomMode previousMode = Random::Mode;
+	Random::Mode = RandomMode::Pcg32;
+	const size_t count = 10000000;
+
+	printf("\n--- Sampling Warp Benchmark (%zu samples) ---\n", count);
+
+	// Whole calls, drawing their own numbers, as scatters make them
+	printf("Drawing numbers:\n");
+	TimeWarp("Rejection unit vector", count, [](size_t) { return RejectionUnitVector(); });
+	TimeWarp("RandomUnitVector", count, [](size_t) { return RandomUnitVector(); });
+	TimeWarp("Rejection disk", count, [](size_t) { XMFLOAT2 p = RejectionInUnitDisk(); return XMLoadFloat2(&p); });
+	TimeWarp("RandomInUnitDisk", count, [](size_t) { XMFLOAT2 p = RandomInUnitDisk(); return XMLoadFloat2(&p); });
+	XMFLOAT3 up(0.0f, 1.0f, 0.0f);
+	TimeWarp("RandomCosineDirection", count, [&](size_t) { return RandomCosineDirection(up); });
+
+	// The warps alone, one at a time and in batches, over the same numbers
+	std::vector<float> u(count), v(count);
+	for (size_t i = 0; i < count; i++) {
+		u[i] = RandomFloat(-1.0f, 1.0f);
+		v[i] = RandomFloat(-1.0f, 1.0f);
+	}
+	std::vector<float> x(count), y(count), z(count);
+
+	printf("Warps only:\n");
+	TimeWarp("Scalar sphere", count, [&](size_t _i) { XMFLOAT3 p = UniformSampleSphere(u[_i], v[_i]); return XMLoadFloat3(&p); });
+	TimeBatchWarp("4-wide sphere", u, x, [&]() { SampleWarps<4>::UniformSphere(u.data(), v.data(), x.data(), y.data(), z.data(), count); });
+#if defined(__AVX2__)
+	TimeBatchWarp("8-wide sphere", u, x, [&]() { SampleWarps<8>::UniformSphere(u.data(), v.data(), x.data(), y.data(), z.data(), count); });
+#endif
+
+	TimeWarp("Scalar disk", count, [&](size_t _i) { XMFLOAT2 p = ConcentricSampleDisk(u[_i], v[_i]); return XMLoadFloat2(&p); });
+	TimeBatchWarp("4-wide disk", u, x, [&]() { SampleWarps<4>::ConcentricDisk(u.data(), v.data(), x.data(), y.data(), count); });
+#if defined(__AVX2__)
+	TimeBatchWarp("8-wide disk", u, x, [&]() { SampleWarps<8>::ConcentricDisk(u.data(), v.data(), x.data(), y.data(), count); });
+#endif
+
+	TimeWarp("Scalar cosine hemisphere", count, [&](size_t _i) { XMFLOAT3 p = CosineSampleHemisphere(u[_i], v[_i]); return XMLoadFloat3(&p); });
+	TimeBatchWarp("4-wide cosine hemisphere", u, x, [&]() { SampleWarps<4>::CosineHemisphere(u.data(), v.data(), x.data(), y.data(), z.data(), count); });
+#if defined(__AVX2__)
+	TimeBatchWarp("8-wide cosine hemisphere", u, x, [&]() { SampleWarps<8>::CosineHemisphere(u.data(), v.data(), x.data(), y.data(), z.data(), count); });
+#endif
+
+	// Batches must give exactly what the scalar warps do. The sphere is
+	// built on the disk, so checking it covers both
+	auto countMismatches = [&]() {
+		size_t mismatches = 0;
+		for (size_t i = 0; i < count; i++) {
+			XMFLOAT3 p = UniformSampleSphere(u[i], v[i]);
+			if (p.x != x[i] || p.y != y[i] || p.z != z[i])
+				mismatches++;
+		}
+		return mismatches;
+	};
+	SampleWarps<4>::UniformSphere(u.data(), v.data(), x.data(), y.data(), z.data(), count);
+	size_t mismatches = countMismatches();
+#if defined(__AVX2__)
+	SampleWarps<8>::UniformSphere(u.data(), v.data(), x.data(), y.data(), z.data(), count);
+	mismatches += countMismatches();
+#endif
+	printf("Batch results matching scalar: %s\n", mismatches == 0 ? "PASS" : "FAIL");
+
+	Random::Mode = previousMode;
+}
+
+void Benchmark::RunBVHBenchmark()
+{
+	printf("\n--- BVH Benchmark ---\n");
+
+	unsigned int sphereCounts[] = { 1000, 10000, 100000 };
+	for (unsigned int sphereCount : sphereCounts) {
+		HittableList list = MakeSphereField(sphereCount);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		BVH bvh(list);
+		double buildSeconds = SecondsSince(start);
+
+		// Wide trees include the binary build they collapse
+		start = std::chrono::high_resolution_clock::now();
+		BVH4 bvh4(list);
+		double build4Seconds = SecondsSince(start);
+
+		printf("%u spheres (BVH built in %.3f s, BVH4 in %.3f s", sphereCount, buildSeconds, build4Seconds);
+#if defined(__AVX2__)
+		start = std::chrono::high_resolution_clock::now();
+		BVH8 bvh8(list);
+		printf(", BVH8 in %.3f s", SecondsSince(start));
+#endif
+		printf(")\n");
+
+		// The linear list gets fewer rays, so large scenes finish in reasonable time
+		float halfSize = 2.0f * std::cbrt((float)sphereCount);
+		std::vector<Ray> listRays = MakeRandomRays(std::max(200u, 200000000u / sphereCount), halfSize);
+		std::vector<Ray> bvhRays = MakeRandomRays(200000, halfSize);
+
+		// Batched spheres, as one list and as the leaves of each tree
+		SphereBatch batch(list);
+		HittableList clusters = SphereBatch::Cluster(list);
+		BVH batchBVH(clusters);
+		BVH4 batchBVH4(clusters);
+
+		TimeClosestHits("HittableList", list, listRays);
+		TimeClosestHits("SphereBatch", batch, listRays);
+		TimeTraversal("BVH", bvh, bvhRays);
+		TimeTraversal("BVH, batches", batchBVH, bvhRays);
+		TimeTraversal("BVH4", bvh4, bvhRays);
+		TimeTraversal("BVH4, batches", batchBVH4, bvhRays);
+#if defined(__AVX2__)
+		BVH8 batchBVH8(clusters);
+		TimeTraversal("BVH8", bvh8, bvhRays);
+		TimeTraversal("BVH8, batches", batchBVH8, bvhRays);
+#endif
+	}
+}
+
+void Benchmark::RunOcclusionBenchmark()
+{
+	printf("\n--- Occlusion Benchmark ---\n");
+
+	unsigned int sphereCounts[] = { 1000, 10000, 100000 };
+	for (unsigned int sphereCount : sphereCounts) {
+		HittableList list = MakeSphereField(sphereCount);
+		HittableList clusters = SphereBatch::Cluster(list);
+		BVH bvh(list);
+		BVH4 bvh4(list);
+		BVH batchBVH(clusters);
+		SphereBatch batch(list);
+
+		printf("%u spheres\n", sphereCount);
+
+		// The linear list gets fewer rays, so large scenes finish in reasonable time
+		float halfSize = 2.0f * std::cbrt((float)sphereCount);
+		std::vector<ShadowRay> listRays = MakeShadowRays(std::max(200u, 200000000u / sphereCount), halfSize);
+		std::vector<ShadowRay> bvhRays = MakeShadowRays(200000, halfSize);
+
+		TimeOcclusion("HittableList", list, listRays);
+		TimeOcclusion("SphereBatch", batch, listRays);
+		TimeOcclusionTraversal("BVH", bvh, bvhRays);
+		TimeOcclusionTraversal("BVH, batches", batchBVH, bvhRays);
+		TimeOcclusionTraversal("BVH4", bvh4, bvhRays);
+#if defined(__AVX2__)
+		BVH8 bvh8(list);
+		TimeOcclusionTraversal("BVH8", bvh8, bvhRays);
+#endif
+	}
+}
+
+void Benchmark::RunBVHBuildBenchmark()
+{
+	auto threadPool = std::make_shared<ThreadPool>(std::thread::hardware_concurrency());
+	LBVHBuilder builder(threadPool);
+
+	printf("\n--- BVH Build Benchmark (%u threads) ---\n", threadPool->GetThreadCount());
+
+	unsigned int sphereCounts[] = { 100000, 1000000 };
+	for (unsigned int sphereCount : sphereCounts) {
+		HittableList list = MakeSphereField(sphereCount);
+		std::vector<Ray> rays = MakeRandomRays(200000, 2.0f * std::cbrt((float)sphereCount));
+
+		printf("%u spheres\n", sphereCount);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		BVH sahBVH(list);
+		ReportBuild("Binned SAH", sahBVH, SecondsSince(start), sphereCount, rays);
+
+		bool treeletSettings[] = { false, true };
+		for (bool optimizeTreelets : treeletSettings) {
+			builder.SetTreeletOptimization(optimizeTreelets);
+			shared_ptr<BVH> lbvh = builder.Build(list);
+
+			const LBVHBuildTimes& times = builder.GetLastBuildTimes();
+			ReportBuild(optimizeTreelets ? "LBVH + treelets" : "LBVH", *lbvh, times.totalSeconds, sphereCount, rays);
+			printf("  %-14s morton %.3f, sort %.3f, hierarchy %.3f, bottom-up %.3f, emit %.3f s\n", "",
+				times.mortonSeconds, times.sortSeconds, times.hierarchySeconds, times.bottomUpSeconds, times.emitSeconds);
+		}
+	}
+}
+
+void Benchmark::RunRefitBenchmark()
+{
+	const unsigned int sphereCount = 100000;
+	const int frameCount = 30;
+
+	auto threadPool = std::make_shared<ThreadPool>(std::thread::hardware_concurrency());
+	Scene scene(threadPool);
+
+	// Same field as the other benchmarks, keeping hold of the spheres to move them
+	std::vector<shared_ptr<Sphere>> spheres;
+	for (const shared_ptr<Hittable>& object : MakeSphereField(sphereCount).objects) {
+		spheres.push_back(std::static_pointer_cast<Sphere>(object));
+		scene.Add(object);
+	}
+	scene.SetAccelerator(SceneAccelerator::BVH);
+
+	printf("\n--- BVH Refit Benchmark (%u moving spheres, rebuild at %.1fx SAH cost) ---\n", sphereCount, scene.GetRebuildThreshold());
+	printf("Initial build: %.3f ms, SAH cost %.2f\n", scene.GetLastUpdateStats().seconds * 1000.0, scene.GetLastUpdateStats().sahCost);
+
+	// Every sphere wanders a little each frame, so the tree slowly loosens
+	std::vector<XMFLOAT3> velocities(spheres.size());
+	for (XMFLOAT3& velocity : velocities) {
+		XMStoreFloat3(&velocity, RandomUnitVector() * 0.25f);
+	}
+
+	double refitSeconds = 0.0;
+	int refitCount = 0;
+	for (int frame = 0; frame < frameCount; frame++) {
+		for (size_t i = 0; i < spheres.size(); i++) {
+			XMFLOAT3 origin = spheres[i]->GetOrigin();
+			XMStoreFloat3(&origin, XMLoadFloat3(&origin) + XMLoadFloat3(&velocities[i]));
+			spheres[i]->SetOrigin(origin);
+		}
+
+		scene.MarkObjectsMoved();
+		scene.Update();
+
+		const SceneUpdateStats& stats = scene.GetLastUpdateStats();
+		if (stats.wasRebuilt) {
+			printf("Frame %2d: rebuilt in %.3f ms, SAH cost %.2f\n", frame, stats.seconds * 1000.0, stats.sahCost);
+		}
+		else {
+			refitSeconds += stats.seconds;
+			refitCount++;
+			printf("Frame %2d: refit in  %.3f ms, SAH cost %.2f (%.2fx)\n", frame, stats.seconds * 1000.0, stats.sahCost, stats.sahCost / stats.builtSAHCost);
+		}
+	}
+
+	if (refitCount > 0)
+		printf("Average refit: %.3f ms\n", refitSeconds * 1000.0 / refitCount);
+}
+
+void Benchmark::RunLightBVHBenchmark()
+{
+	RandomMode previousMode = Random::Mode;
+	Random::Mode = RandomMode::Pcg32;
+
+	const unsigned int pointCount = 256;
+	const unsigned int samplesPerPoint = 256;
+
+	printf("\n--- Light BVH Benchmark (%u points, %u samples each) ---\n", pointCount, samplesPerPoint);
+
+	// A spread of brightnesses, so power matters as well as distance
+	const int brightnessCount = 8;
+	MaterialTable materials;
+	float brightnesses[brightnessCount];
+	MaterialIndex lightMaterials[brightnessCount];
+	for (int i = 0; i < brightnessCount; i++) {
+		brightnesses[i] = std::pow(2.0f, (float)i - 2.0f);
+		lightMaterials[i] = materials.Add(make_shared<DiffuseLight>(XMFLOAT3(brightnesses[i], brightnesses[i], brightnesses[i])));
+	}
+
+	LightSelection selections[] = { LightSelection::Uniform, LightSelection::BVH };
+	const char* selectionNames[] = { "Uniform", "BVH" };
+
+	unsigned int lightCounts[] = { 10, 100, 1000, 10000, 100000 };
+	for (unsigned int lightCount : lightCounts) {
+		// Lights hang over a floor whose area grows with their count, so
+		// each shading point has about as many close by whatever the count
+		HittableList field;
+		std::vector<float> fieldBrightnesses(lightCount);
+		float halfSize = 2.0f * std::sqrt((float)lightCount);
+		for (unsigned int i = 0; i < lightCount; i++) {
+			XMFLOAT3 center(RandomFloat(-halfSize, halfSize), RandomFloat(1.0f, 4.0f), RandomFloat(-halfSize, halfSize));
+			int brightness = std::min((int)(RandomFloat() * brightnessCount), brightnessCount - 1);
+			field.Add(make_shared<Sphere>(center, RandomFloat(0.2f, 0.5f), lightMaterials[brightness]));
+			fieldBrightnesses[i] = brightnesses[brightness];
+		}
+
+		LightList lights;
+		auto buildStart = std::chrono::high_resolution_clock::now();
+		lights.Build(field, materials);
+		double buildSeconds = SecondsSince(buildStart);
+
+		printf("%u lights: built in %.3f ms, %zu nodes, depth %d\n",
+			lightCount, buildSeconds * 1000.0, lights.GetBVH().GetNodeCount(), lights.GetBVH().GetDepth());
+
+		// Every sphere is wholly above the floor, so the light each sends a
+		// floor point, ignoring shadows, has a closed form to check against
+		std::vector<XMFLOAT3> points(pointCount);
+		std::vector<double> exact(pointCount, 0.0);
+		for (unsigned int p = 0; p < pointCount; p++) {
+			points[p] = XMFLOAT3(RandomFloat(-halfSize, halfSize), 0.0f, RandomFloat(-halfSize, halfSize));
+			for (unsigned int i = 0; i < lightCount; i++) {
+				const Sphere& sphere = static_cast<const Sphere&>(*field.objects[i]);
+				XMFLOAT3 center = sphere.GetOrigin();
+				double dx = center.x - points[p].x;
+				double dz = center.z - points[p].z;
+				double distanceSquared = dx * dx + (double)center.y * center.y + dz * dz;
+				double radius = sphere.GetRadius();
+				exact[p] += pi * fieldBrightnesses[i] * radius * radius / distanceSquared * center.y / std::sqrt(distanceSquared);
+			}
+		}
+		XMFLOAT3 up(0.0f, 1.0f, 0.0f);
+
+		for (int s = 0; s < 2; s++) {
+			// Each point's light is estimated from its samples and compared
+			// to the exact value
+			double relativeErrorSquaredSum = 0.0;
+			auto start = std::chrono::high_resolution_clock::now();
+			for (unsigned int p = 0; p < pointCount; p++) {
+				double sum = 0.0;
+				for (unsigned int i = 0; i < samplesPerPoint; i++) {
+					// Drawn in the same order as Camera::SampleLight
+					float u = RandomFloat();
+					float v = RandomFloat();
+					float uLight = RandomFloat();
+
+					LightSample sample;
+					if (!lights.Sample(points[p], up, selections[s], uLight, u, v, sample))
+						continue;
+
+					sum += std::max(0.0f, sample.direction.y) * sample.radiance.x / sample.pdf;
+				}
+
+				double relativeError = sum / samplesPerPoint / exact[p] - 1.0;
+				relativeErrorSquaredSum += relativeError * relativeError;
+			}
+			double seconds = SecondsSince(start);
+
+			printf("  %-8s %7.1f ns/sample  relative RMSE %.4f\n",
+				selectionNames[s],
+				seconds * 1e9 / ((double)pointCount * samplesPerPoint),
+				std::sqrt(relativeErrorSquaredSum / pointCount));
+		}
+	}
+
+	Random::Mode = previousMode;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "Camera.h"
+#include "Hittable.h"
+
+// Timing and correctness checks that run inside the app
+// and print their results to the console
+namespace Benchmark
+{
+	// Times each RandomMode's generator against the old std::rand() path
+	void RunRandomBenchmark();
+
+	// Renders the scene in counter-based random mode with several
+	// thread counts and checks that every image is bit-identical
+	void RunReproducibilityCheck(Camera& _camera, const Hittable& _world, const MaterialTable& _materials);
+
+	// Renders the scene at full quality on every hardware thread a few
+	// times and prints the best time and the camera-ray sample rate, then
+	// times generating the same camera rays alone, one at a time and batched
+	void RunRenderBenchmark(Camera& _camera, const Hittable& _world, const MaterialTable& _materials);
+
+	// Renders the scene with and without Russian roulette and prints the
+	// average path length, render time and mean image brightness of each
+	void RunPathLengthBenchmark(Camera& _camera, const Hittable& _world, const MaterialTable& _materials);
+
+	// Renders the scene in megakernel and wavefront mode, checks the images
+	// match, and prints how long the wavefront spent in each of its stages
+	void RunWavefrontBenchmark(Camera& _camera, const Hittable& _world, const MaterialTable& _materials);
+
+	// Renders the scene with single camera rays and with 4x4 and 8x8 ray
+	// packets, at a max depth of 1 so the first hit dominates and at the
+	// camera's own max depth, and checks every image matches
+	void RunPacketBenchmark(Camera& _camera, const Hittable& _world, const MaterialTable& _materials);
+
+	// Renders a high sample count reference, then fixed-rate and adaptive
+	// images at several sample counts, and prints each one's time, samples
+	// and rays traced, and error against the reference
+	void RunAdaptiveSamplingBenchmark(Camera& _camera, const Hittable& _world, const MaterialTable& _materials);
+
+	// Renders the scene with independent numbers and with each low-discrepancy
+	// sampler at several sample counts, and prints each image's time and
+	// error against a high sample count reference
+	void RunSamplerBenchmark(Camera& _camera, const Hittable& _world, const MaterialTable& _materials);
+
+	// Renders the scene finding its lights' light by scattering alone, by
+	// sampling lights alone, and by both with each MIS heuristic, at several
+	// sample counts, and prints each image's time and error against a high
+	// sample count reference, picking lights uniformly and through the
+	// light BVH. Also checks both ways of picking lights converge to the same
+	// mean image brightness. Needs a scene with lights
+	void RunLightSamplingBenchmark(Camera& _camera, const Hittable& _world, const MaterialTable& _materials);
+
+	// Times the closed-form sphere, disk and cosine hemisphere warps, one at
+	// a time and 4 and 8 at once, against the rejection samplers they
+	// replaced, and checks the batches match the scalar warps
+	void RunWarpBenchmark();
+
+	// Times closest-hit queries against random sphere fields of 1k, 10k
+	// and 100k spheres, through a HittableList and through each BVH width,
+	// and reports the nodes visited and primitives tested per ray
+	void RunBVHBenchmark();
+
+	// Traces shadow rays between random points in sphere fields of 1k, 10k
+	// and 100k spheres as closest-hit and as any-hit queries, through a
+	// HittableList, a SphereBatch and each BVH width, and checks they agree
+	void RunOcclusionBenchmark();
+
+	// Builds 100k and 1M sphere fields with the serial SAH builder and the
+	// parallel LBVH builder, with and without treelet optimization, and
+	// reports build time per million primitives, SAH cost and trace rate
+	void RunBVHBuildBenchmark();
+
+	// Moves every sphere in a 100k sphere field each frame, updating the
+	// scene's BVH through refits and threshold-triggered rebuilds, and
+	// prints the time each takes and how SAH cost drifts
+	void RunRefitBenchmark();
+
+	// Builds light BVHs over fields of 10 to 100k emissive spheres of mixed
+	// brightness, and prints build time, time per light sample and the error
+	// of the unshadowed direct light estimate at points beneath them against
+	// its closed form, picking lights uniformly and through the tree
+	void RunLightBVHBenchmark();
+}
+
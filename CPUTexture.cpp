@@ -184,6 +184,17 @@ void CPUTexture::AddColor(unsigned int x, unsigned int y, DirectX::XMFLOAT4 colo
 	XMStoreFloat4(&pixelColors[index], XMVectorAdd(p, c));
 }
 
+// -----------------------------------
+// Gets the color at the given position
+// 
+// x - Pixel grid x location
+// y - Pixel grid y location
+// -----------------------------------
+DirectX::XMFLOAT4 CPUTexture::GetColor(unsigned int x, unsigned int y)
+{
+	return pixelColors[PixelIndex(x, y)];
+}
+
 // -----------------------------------
 // Calculates a 1D index from [x, y] notation
 // 
@@ -24,6 +24,9 @@ public:
 	void SetColor(unsigned int x, unsigned int y, DirectX::XMFLOAT4 color);
 	void AddColor(unsigned int x, unsigned int y, DirectX::XMFLOAT4 color);
 
+	// Reading data
+	DirectX::XMFLOAT4 GetColor(unsigned int x, unsigned int y);
+
 	// GPU calls
 	void Resize(unsigned int width, unsigned int height);
 	void Draw();
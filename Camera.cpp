@@ -1,4 +1,8 @@
 #include "Camera.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
 #include "Window.h"
 #include "Input.h"
 #include "VectorHelpers.h"
@@ -6,6 +10,28 @@
 
 using namespace DirectX;
 
+namespace
+{
+	// Perceived brightness of a linear color
+	float Luminance(DirectX::XMVECTOR _color)
+	{
+		XMFLOAT3 color;
+		XMStoreFloat3(&color, _color);
+		return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+	}
+
+	// Shades a sample count from blue, for none, through green to red, for _maxCount
+	DirectX::XMFLOAT4 SampleCountColor(unsigned int _count, unsigned int _maxCount)
+	{
+		float t = std::min(1.0f, (float)_count / _maxCount);
+		return XMFLOAT4(
+			std::max(0.0f, 2.0f * t - 1.0f),
+			1.0f - std::abs(2.0f * t - 1.0f),
+			std::max(0.0f, 1.0f - 2.0f * t),
+			1.0f);
+	}
+}
+
 
 Camera::Camera(
 	DirectX::XMFLOAT3 position,
@@ -27,9 +53,32 @@ Camera::Camera(
 	textureScaleMoving(textureScaleMoving),
 	samplesPerPixel(10),
 	maxDepth(10),
+	useRussianRoulette(true),
+	rouletteMinDepth(3),
+	samplerType(SamplerType::Independent),
+	lightSampling(LightSampling::PowerHeuristic),
+	lightSelection(LightSelection::BVH),
+	skyBrightness(1.0f),
+	isAdaptive(false),
+	adaptiveThreshold(0.05f),
+	adaptiveMinSamples(32),
+	showSampleCounts(false),
+	adaptiveActivePixelCount(0),
+	adaptiveAccumulatedSampleCount(0),
+	renderMode(RenderMode::Megakernel),
+	packetSize(1),
+	pathCount(0),
+	pathSegmentCount(0),
 	defocusAngle(0.0f),
-	focusDist(10.0f)
+	focusDist(10.0f),
+	tileSize(16),
+	isProgressive(false),
+	progressiveSamplesPerFrame(1),
+	accumulatedSamples(0),
+	tileKernel(nullptr)
 {
+	threadPool = std::make_shared<ThreadPool>(std::thread::hardware_concurrency());
+
 	transform = std::make_shared<Transform>();
 	transform->SetPosition(position);
 
@@ -91,7 +140,9 @@ void Camera::UpdateProjectionMatrix(float aspectRatio)
 	}
 
 	XMStoreFloat4x4(&projMatrix, P);
-	UpdateViewportData();
+	if (UpdateViewportData()) {
+		accumulatedSamples = 0;
+	}
 }
 
 DirectX::XMFLOAT4X4 Camera::GetView() { return viewMatrix; }
@@ -174,6 +225,172 @@ void Camera::SetMaxDepth(int _depth)
 	maxDepth = _depth;
 }
 
+bool Camera::GetRussianRoulette()
+{
+	return useRussianRoulette;
+}
+
+void Camera::SetRussianRoulette(bool _useRoulette)
+{
+	useRussianRoulette = _useRoulette;
+}
+
+int Camera::GetRouletteMinDepth()
+{
+	return rouletteMinDepth;
+}
+
+void Camera::SetRouletteMinDepth(int _depth)
+{
+	rouletteMinDepth = _depth > 0 ? _depth : 1;
+}
+
+bool Camera::GetAdaptiveSampling()
+{
+	return isAdaptive;
+}
+
+void Camera::SetAdaptiveSampling(bool _isAdaptive)
+{
+	isAdaptive = _isAdaptive;
+	accumulatedSamples = 0;
+}
+
+float Camera::GetAdaptiveThreshold()
+{
+	return adaptiveThreshold;
+}
+
+void Camera::SetAdaptiveThreshold(float _threshold)
+{
+	adaptiveThreshold = _threshold > 0.0f ? _threshold : 0.0f;
+}
+
+int Camera::GetAdaptiveMinSamples()
+{
+	return adaptiveMinSamples;
+}
+
+void Camera::SetAdaptiveMinSamples(int _samples)
+{
+	// Variance needs at least two samples
+	adaptiveMinSamples = _samples > 2 ? _samples : 2;
+}
+
+bool Camera::GetShowSampleCounts()
+{
+	return showSampleCounts;
+}
+
+void Camera::SetShowSampleCounts(bool _showSampleCounts)
+{
+	showSampleCounts = _showSampleCounts;
+}
+
+RenderMode Camera::GetRenderMode()
+{
+	return renderMode;
+}
+
+void Camera::SetRenderMode(RenderMode _mode)
+{
+	renderMode = _mode;
+}
+
+SamplerType Camera::GetSamplerType()
+{
+	return samplerType;
+}
+
+void Camera::SetSamplerType(SamplerType _type)
+{
+	if (_type == samplerType)
+		return;
+
+	samplerType = _type;
+	sampler = Sampler::Create(_type);
+	accumulatedSamples = 0;
+}
+
+std::shared_ptr<const LightList> Camera::GetLights()
+{
+	return lights;
+}
+
+void Camera::SetLights(std::shared_ptr<const LightList> _lights)
+{
+	lights = _lights;
+	accumulatedSamples = 0;
+}
+
+LightSampling Camera::GetLightSampling()
+{
+	return lightSampling;
+}
+
+void Camera::SetLightSampling(LightSampling _lightSampling)
+{
+	if (_lightSampling == lightSampling)
+		return;
+
+	lightSampling = _lightSampling;
+	accumulatedSamples = 0;
+}
+
+LightSelection Camera::GetLightSelection()
+{
+	return lightSelection;
+}
+
+void Camera::SetLightSelection(LightSelection _lightSelection)
+{
+	if (_lightSelection == lightSelection)
+		return;
+
+	lightSelection = _lightSelection;
+	accumulatedSamples = 0;
+}
+
+float Camera::GetSkyBrightness()
+{
+	return skyBrightness;
+}
+
+void Camera::SetSkyBrightness(float _brightness)
+{
+	skyBrightness = std::max(0.0f, _brightness);
+	accumulatedSamples = 0;
+}
+
+const WavefrontStageTimes& Camera::GetWavefrontStageTimes()
+{
+	return wavefrontStageTimes;
+}
+
+unsigned int Camera::GetPacketSize()
+{
+	return packetSize;
+}
+
+void Camera::SetPacketSize(unsigned int _packetSize)
+{
+	packetSize = std::clamp(_packetSize, 1u, 8u);
+}
+
+PathStats Camera::GetPathStats()
+{
+	PathStats stats;
+	stats.pathCount = pathCount.load();
+	stats.segmentCount = pathSegmentCount.load();
+	return stats;
+}
+
+void Camera::ResetPathStats()
+{
+	pathCount = 0;
+	pathSegmentCount = 0;
+}
+
 float Camera::GetDefocusAngle()
 {
 	return defocusAngle;
@@ -194,6 +411,92 @@ void Camera::SetFocusDist(float _dist)
 	focusDist = _dist;
 }
 
+unsigned int Camera::GetThreadCount()
+{
+	return threadPool->GetThreadCount();
+}
+
+void Camera::SetThreadCount(unsigned int _threadCount)
+{
+	// Joins the old workers before spinning up the new ones
+	threadPool.reset();
+	threadPool = std::make_shared<ThreadPool>(_threadCount);
+}
+
+std::shared_ptr<ThreadPool> Camera::GetThreadPool()
+{
+	return threadPool;
+}
+
+unsigned int Camera::GetTileSize()
+{
+	return tileSize;
+}
+
+void Camera::SetTileSize(unsigned int _tileSize)
+{
+	tileSize = _tileSize > 0 ? _tileSize : 1;
+}
+
+bool Camera::GetProgressive()
+{
+	return isProgressive;
+}
+
+void Camera::SetProgressive(bool _isProgressive)
+{
+	isProgressive = _isProgressive;
+	accumulatedSamples = 0;
+}
+
+int Camera::GetProgressiveSamplesPerFrame()
+{
+	return progressiveSamplesPerFrame;
+}
+
+void Camera::SetProgressiveSamplesPerFrame(int _samples)
+{
+	progressiveSamplesPerFrame = _samples > 0 ? _samples : 1;
+}
+
+void Camera::ResetAccumulation()
+{
+	accumulatedSamples = 0;
+}
+
+float Camera::GenerateCameraRays(unsigned int _width, unsigned int _height, int _sampleCount, bool _useBatches)
+{
+	UpdateCameraRayConstants();
+
+	float directionSum = 0.0f;
+	CameraRayBatch rays;
+	for (unsigned int tileY = 0; tileY < _height; tileY += tileSize) {
+		unsigned int tileMaxY = std::min(tileY + tileSize, _height);
+
+		for (unsigned int tileX = 0; tileX < _width; tileX += tileSize) {
+			unsigned int tileMaxX = std::min(tileX + tileSize, _width);
+
+			for (int sample = 0; sample < _sampleCount; sample++) {
+				if (_useBatches) {
+					rays.Generate(cameraRayConstants, tileX, tileY, tileMaxX, tileMaxY, _width, sample);
+					for (int i = 0; i < rays.GetCount(); i++) {
+						directionSum += rays.GetRay(i).Direction.x;
+					}
+					continue;
+				}
+
+				for (unsigned int y = tileY; y < tileMaxY; y++) {
+					for (unsigned int x = tileX; x < tileMaxX; x++) {
+						Random::BeginSample(y * _width + x, sample);
+						directionSum += GetRay(x, y).Direction.x;
+					}
+				}
+			}
+		}
+	}
+	return directionSum;
+}
+
 CameraProjectionType Camera::GetProjectionType() { return projectionType; }
 void Camera::SetProjectionType(CameraProjectionType type) 
 {
@@ -213,14 +516,28 @@ void Camera::Initialize()
 	UpdateViewportData();
 }
 
-void Camera::UpdateViewportData()
+bool Camera::UpdateViewportData()
 {
+	// Remember what rays were generated from, to tell if anything changed
+	XMFLOAT3 oldUpperLeftPixelCenter = upperLeftPixelCenter;
+	XMFLOAT3 oldPixelDeltaU = pixelDeltaU;
+	XMFLOAT3 oldPixelDeltaV = pixelDeltaV;
+	XMFLOAT3 oldDefocusDiskU = defocusDiskU;
+	XMFLOAT3 oldDefocusDiskV = defocusDiskV;
+
 	// Determine viewport dimensions
-	auto theta = DegreesToRadians(fieldOfView);
-	auto h = std::tan(theta / 2.0f);
-	auto viewportHeight = 2 * h * focusDist;
+	// Perspective viewports sit at the focus distance and widen with the
+	// field of view; orthographic ones are the same size at any distance
+	if (projectionType == CameraProjectionType::Orthographic) {
+		viewportSize = XMFLOAT2(orthographicWidth, orthographicWidth / Window::AspectRatio());
+	}
+	else {
+		auto theta = DegreesToRadians(fieldOfView);
+		auto h = std::tan(theta / 2.0f);
+		auto viewportHeight = 2 * h * focusDist;
 
-	viewportSize = XMFLOAT2(viewportHeight * Window::AspectRatio(), viewportHeight);
+		viewportSize = XMFLOAT2(viewportHeight * Window::AspectRatio(), viewportHeight);
+	}
 	viewportPixelPercentage = XMFLOAT2(
 		(1.0f / (Window::Width() * textureScale)),
 		(1.0f / (Window::Height() * textureScale))
@@ -279,56 +596,273 @@ void Camera::UpdateViewportData()
 	auto defocusRadius = focusDist * std::tan(DegreesToRadians(defocusAngle / 2.0f));
 	XMStoreFloat3(&defocusDiskU, XMVectorScale(vecCameraRight, defocusRadius));
 	XMStoreFloat3(&defocusDiskV, XMVectorScale(vecCameraUp, defocusRadius));
+
+	// Any change to these changes every camera ray, so earlier samples no longer apply
+	bool hasChanged =
+		memcmp(&oldUpperLeftPixelCenter, &upperLeftPixelCenter, sizeof(XMFLOAT3)) != 0 ||
+		memcmp(&oldPixelDeltaU, &pixelDeltaU, sizeof(XMFLOAT3)) != 0 ||
+		memcmp(&oldPixelDeltaV, &pixelDeltaV, sizeof(XMFLOAT3)) != 0 ||
+		memcmp(&oldDefocusDiskU, &defocusDiskU, sizeof(XMFLOAT3)) != 0 ||
+		memcmp(&oldDefocusDiskV, &defocusDiskV, sizeof(XMFLOAT3)) != 0;
+
+	return hasChanged;
+}
+
+void Camera::UpdateCameraRayConstants()
+{
+	cameraRayConstants.origin = transform->GetPosition();
+	cameraRayConstants.upperLeftPixelCenter = upperLeftPixelCenter;
+	cameraRayConstants.pixelDeltaU = pixelDeltaU;
+	cameraRayConstants.pixelDeltaV = pixelDeltaV;
+	cameraRayConstants.defocusDiskU = defocusDiskU;
+	cameraRayConstants.defocusDiskV = defocusDiskV;
+	cameraRayConstants.hasDefocus = defocusAngle > 0;
+	cameraRayConstants.isOrthographic = projectionType == CameraProjectionType::Orthographic;
+	XMFLOAT3 cameraForward = transform->GetForward();
+	XMStoreFloat3(&cameraRayConstants.orthographicDirection, XMVectorScale(XMLoadFloat3(&cameraForward), focusDist));
+}
+
+bool Camera::UsesAdaptiveSampling() const
+{
+	return isAdaptive && renderMode == RenderMode::Megakernel && packetSize == 1;
+}
+
+void Camera::SelectTileKernel()
+{
+	if (defocusAngle > 0) {
+		tileKernel = projectionType == CameraProjectionType::Orthographic ?
+			SelectTileKernelForDepth<true, true>() :
+			SelectTileKernelForDepth<true, false>();
+	}
+	else {
+		tileKernel = projectionType == CameraProjectionType::Orthographic ?
+			SelectTileKernelForDepth<false, true>() :
+			SelectTileKernelForDepth<false, false>();
+	}
+}
+
+template<bool HAS_DEFOCUS, bool IS_ORTHOGRAPHIC>
+Camera::TileKernel Camera::SelectTileKernelForDepth() const
+{
+	bool isAdaptiveKernel = UsesAdaptiveSampling();
+	switch (maxDepth) {
+	case 1:
+		return isAdaptiveKernel ?
+			&Camera::RenderTileAdaptive<HAS_DEFOCUS, IS_ORTHOGRAPHIC, 1> :
+			&Camera::RenderTileKernel<HAS_DEFOCUS, IS_ORTHOGRAPHIC, 1>;
+	case 10:
+		return isAdaptiveKernel ?
+			&Camera::RenderTileAdaptive<HAS_DEFOCUS, IS_ORTHOGRAPHIC, 10> :
+			&Camera::RenderTileKernel<HAS_DEFOCUS, IS_ORTHOGRAPHIC, 10>;
+	case 50:
+		return isAdaptiveKernel ?
+			&Camera::RenderTileAdaptive<HAS_DEFOCUS, IS_ORTHOGRAPHIC, 50> :
+			&Camera::RenderTileKernel<HAS_DEFOCUS, IS_ORTHOGRAPHIC, 50>;
+	default:
+		return isAdaptiveKernel ?
+			&Camera::RenderTileAdaptive<HAS_DEFOCUS, IS_ORTHOGRAPHIC, 0> :
+			&Camera::RenderTileKernel<HAS_DEFOCUS, IS_ORTHOGRAPHIC, 0>;
+	}
 }
 
-Ray Camera::GetRay(unsigned int _i, unsigned int _j, DirectX::XMVECTOR _pixelDeltaU, DirectX::XMVECTOR _pixelDeltaV, DirectX::XMVECTOR _cameraPosition) const
+Ray Camera::GetRay(unsigned int _i, unsigned int _j) const
 {
 	Ray result;
+	const CameraRayConstants& constants = cameraRayConstants;
 
 	XMFLOAT2 offset = SampleSquare();
 
 	// Find center of this pixel
 	XMVECTOR vecPixelSample =
-		XMLoadFloat3(&upperLeftPixelCenter) +				// Start at center
-		XMVectorScale(_pixelDeltaU, offset.x + (float)_i) +	// Offset by X
-		XMVectorScale(_pixelDeltaV, offset.y + (float)_j);	// Offset by Y
-
-	// Get the direction of the ray through the center of this pixel
-	XMVECTOR vecRayDirection = vecPixelSample - _cameraPosition;
+		XMLoadFloat3(&constants.upperLeftPixelCenter) +								// Start at center
+		XMVectorScale(XMLoadFloat3(&constants.pixelDeltaU), offset.x + (float)_i) +	// Offset by X
+		XMVectorScale(XMLoadFloat3(&constants.pixelDeltaV), offset.y + (float)_j);	// Offset by Y
+
+	// Get the direction of the ray through the center of this pixel.
+	// Orthographic rays all head forward, from behind the pixel
+	XMVECTOR vecRayOrigin;
+	XMVECTOR vecRayDirection;
+	if (constants.isOrthographic) {
+		vecRayDirection = XMLoadFloat3(&constants.orthographicDirection);
+		vecRayOrigin = vecPixelSample - vecRayDirection;
+	}
+	else {
+		vecRayOrigin = XMLoadFloat3(&constants.origin);
+		vecRayDirection = vecPixelSample - vecRayOrigin;
+	}
 	XMStoreFloat3(&result.Direction, vecRayDirection);
 
-	result.Origin = (defocusAngle <= 0) ? transform->GetPosition() : DefocusDiskSample(_cameraPosition);
+	if (constants.hasDefocus) {
+		result.Origin = DefocusDiskSample(vecRayOrigin);
+	}
+	else {
+		XMStoreFloat3(&result.Origin, vecRayOrigin);
+	}
 
 	return result;
 }
 
 DirectX::XMFLOAT2 Camera::SampleSquare() const
 {
-	return XMFLOAT2(RandomFloat() - 0.5f, RandomFloat() - 0.5f);
+	// Draw X first; the order of a call's arguments isn't defined, and batches
+	// of camera rays rely on drawing numbers in the same order
+	float x = RandomFloat() - 0.5f;
+	float y = RandomFloat() - 0.5f;
+	return XMFLOAT2(x, y);
 }
 
-DirectX::XMVECTOR Camera::RayColor(const Ray& _ray, int _depth, const Hittable& _world)
+template<int MAX_DEPTH>
+DirectX::XMVECTOR Camera::RayColor(const Ray& _ray, const Hittable& _world, const MaterialTable& _materials, int& _segmentCount, const RayHit* _primaryHit) const
 {
-	if (_depth <= 0)
-		return XMVectorZero();
+	const int depthLimit = MAX_DEPTH > 0 ? MAX_DEPTH : maxDepth;
+
+	// Light reaching the camera is whatever the path finds along the way,
+	// scaled by every surface it bounced off before finding it
+	XMVECTOR radiance = XMVectorZero();
+	XMVECTOR throughput = XMVectorSplatOne();
+	Ray ray = _ray;
+	_segmentCount = 0;
+	// The last bounce's scatter density and normal, and whether it sampled lights too
+	float scatterPdf = 0.0f;
+	XMFLOAT3 scatterNormal = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	bool wasLightSampled = false;
+
+	for (int bounce = 1; bounce <= depthLimit; bounce++) {
+		// Key random numbers used by this bounce's light sample and scatter
+		Random::BeginBounce(bounce);
+		_segmentCount++;
+
+		// Test for world collision, unless the first hit was found already
+		HitRecord record;
+		if (bounce == 1 && _primaryHit) {
+			if (!_primaryHit->primitive)
+				return radiance + throughput * SkyColor(ray);
+			_primaryHit->primitive->GetSurfaceInteraction(ray, *_primaryHit, record);
+			record.primitive = _primaryHit->primitive;
+		}
+		else if (!_world.Hit(ray, Interval(0.001f, infinity), record)) {
+			return radiance + throughput * SkyColor(ray);
+		}
 
-	// Test for world collision
-	HitRecord record;
+		XMVECTOR emitted = _materials.Emitted(record.material, record);
+		if (!XMVector3Equal(emitted, XMVectorZero()))
+			radiance = radiance + throughput * XMVectorScale(emitted, EmissionWeight(ray, record, scatterPdf, scatterNormal, wasLightSampled));
 
-	if (_world.Hit(_ray, Interval(0.001f, infinity), record)) {
-		// Calculate color
-		XMVECTOR attenuation = XMVectorZero();
+		wasLightSampled = false;
+		if (UsesLightSampling())
+			radiance = radiance + throughput * SampleLight(_world, _materials, ray, record, wasLightSampled);
 
-		Ray scattered;
-		if (record.material->Scatter(_ray, record, attenuation, scattered)) {
-			return attenuation * RayColor(scattered, _depth - 1, _world);
-		}
+		ScatterRecord scatter;
+		if (!_materials.Scatter(record.material, ray, record, scatter))
+			return radiance;
+
+		throughput = throughput * scatter.Weight(record.normal);
+		ray = scatter.scattered;
+		scatterPdf = scatter.pdf;
+		scatterNormal = record.normal;
+
+		if (!SurvivesRoulette(bounce, throughput))
+			return radiance;
+	}
+
+	// Paths that run out of bounces gather no more light
+	return radiance;
+}
+
+bool Camera::UsesLightSampling() const
+{
+	return lightSampling != LightSampling::Off && lights && lights->GetCount() > 0;
+}
+
+DirectX::XMVECTOR Camera::SampleLight(const Hittable& _world, const MaterialTable& _materials, const Ray& _rayIn, const HitRecord& _record, bool& _wasLightSampled) const
+{
+	auto evaluate = [&](const XMFLOAT3& _direction, XMFLOAT3& _value, float& _pdf) {
+		return _materials.Evaluate(_record.material, _rayIn, _record, _direction, _value, _pdf);
+	};
+	return SampleLightWith(_world, _record, evaluate, _wasLightSampled);
+}
+
+template<typename EVALUATE>
+DirectX::XMVECTOR Camera::SampleLightWith(const Hittable& _world, const HitRecord& _record, const EVALUATE& _evaluate, bool& _wasLightSampled) const
+{
+	// Draw the direction's numbers first, then the light's
+	float u = RandomFloat();
+	float v = RandomFloat();
+	float uLight = RandomFloat();
+
+	// Sampling only fails with no lights at all, so whether a sample was
+	// taken never depends on the numbers drawn, which EmissionWeight relies on
+	LightSample sample;
+	if (!lights->Sample(_record.point, _record.normal, lightSelection, uLight, u, v, sample))
+		return XMVectorZero();
 
+	XMFLOAT3 value;
+	float scatterPdf;
+	_wasLightSampled = _evaluate(sample.direction, value, scatterPdf);
+	if (!_wasLightSampled)
 		return XMVectorZero();
+
+	float cosine;
+	XMStoreFloat(&cosine, XMVector3Dot(XMLoadFloat3(&sample.direction), XMLoadFloat3(&_record.normal)));
+	XMVECTOR contribution = XMLoadFloat3(&value) * XMLoadFloat3(&sample.radiance);
+	if (cosine <= 0.0f || XMVector3Equal(contribution, XMVectorZero()))
+		return XMVectorZero();
+
+	// Only light the way there isn't blocked. Any blocker will do, so the
+	// shadow ray needn't find the nearest
+	Ray shadowRay = { _record.point, sample.direction };
+	if (_world.Occluded(shadowRay, Interval(0.001f, sample.distance - 0.001f)))
+		return XMVectorZero();
+
+	float weight = lightSampling == LightSampling::LightsOnly ? 1.0f : MISWeight(sample.pdf, scatterPdf);
+	return XMVectorScale(contribution, cosine * weight / sample.pdf);
+}
+
+float Camera::EmissionWeight(const Ray& _ray, const HitRecord& _record, float _scatterPdf, const DirectX::XMFLOAT3& _originNormal, bool _wasLightSampled) const
+{
+	// Camera rays, and rays off surfaces lights couldn't be sampled for, are
+	// the only way to find this light
+	if (!_wasLightSampled)
+		return 1.0f;
+
+	// The ray left from its origin, where lights were sampled too. Lights
+	// that couldn't have been sampled from there are only found this way
+	float lightPdf = lights->Pdf(_ray.Origin, _originNormal, lightSelection, _record.primitive);
+	if (lightPdf <= 0.0f)
+		return 1.0f;
+
+	return lightSampling == LightSampling::LightsOnly ? 0.0f : MISWeight(_scatterPdf, lightPdf);
+}
+
+float Camera::MISWeight(float _pdf, float _otherPdf) const
+{
+	if (lightSampling == LightSampling::PowerHeuristic) {
+		_pdf *= _pdf;
+		_otherPdf *= _otherPdf;
 	}
+	return _pdf / (_pdf + _otherPdf);
+}
 
-	// Sky color
+bool Camera::SurvivesRoulette(int _bounce, DirectX::XMVECTOR& _throughput) const
+{
+	if (!useRussianRoulette || _bounce < rouletteMinDepth)
+		return true;
+
+	// Past the minimum depth, end the path with a chance that grows as its
+	// throughput falls. Survivors are scaled up by the same chance, so the
+	// expected result doesn't change
+	XMFLOAT3 weight;
+	XMStoreFloat3(&weight, _throughput);
+	float survival = std::min(1.0f, std::max(weight.x, std::max(weight.y, weight.z)));
+	if (RandomFloat() >= survival)
+		return false;
+
+	_throughput = XMVectorScale(_throughput, 1.0f / survival);
+	return true;
+}
 
+DirectX::XMVECTOR Camera::SkyColor(const Ray& _ray) const
+{
 	// Unpack XMFLOAT3s
 	XMVECTOR vecRayOrigin = XMLoadFloat3(&_ray.Origin);
 	XMVECTOR vecRayDirection = XMLoadFloat3(&_ray.Direction);
@@ -346,10 +880,10 @@ DirectX::XMVECTOR Camera::RayColor(const Ray& _ray, int _depth, const Hittable&
 	XMFLOAT3 color2(0.5f, 0.7f, 1.0f);
 
 	// Calculate interpolated color
-	return XMVectorLerp(XMLoadFloat3(&color1), XMLoadFloat3(&color2), a);
+	return XMVectorScale(XMVectorLerp(XMLoadFloat3(&color1), XMLoadFloat3(&color2), a), skyBrightness);
 }
 
-DirectX::XMFLOAT3 Camera::DefocusDiskSample(DirectX::XMVECTOR _cameraPosition) const
+DirectX::XMFLOAT3 Camera::DefocusDiskSample(DirectX::XMVECTOR _center) const
 {
 	// Returns a random point in the camera's defocus disk
 	auto p = RandomInUnitDisk();
@@ -357,14 +891,502 @@ DirectX::XMFLOAT3 Camera::DefocusDiskSample(DirectX::XMVECTOR _cameraPosition) c
 	XMFLOAT3 result;
 	
 	XMStoreFloat3(&result,
-		_cameraPosition +
-		XMVectorScale(XMLoadFloat3(&defocusDiskU), p.x) +
-		XMVectorScale(XMLoadFloat3(&defocusDiskV), p.y)
+		_center +
+		XMVectorScale(XMLoadFloat3(&cameraRayConstants.defocusDiskU), p.x) +
+		XMVectorScale(XMLoadFloat3(&cameraRayConstants.defocusDiskV), p.y)
 	);
 
 	return result;
 }
 
+void Camera::RenderTile(const Hittable& _world, const MaterialTable& _materials, CPUTexture& _cpuTexture, unsigned int _minX, unsigned int _minY, unsigned int _maxX, unsigned int _maxY, int _firstSample, int _sampleCount, bool _accumulate) const
+{
+	if (packetSize > 1) {
+		RenderTilePackets(_world, _materials, _cpuTexture, _minX, _minY, _maxX, _maxY, _firstSample, _sampleCount, _accumulate);
+		return;
+	}
+
+	(this->*tileKernel)(_world, _materials, _cpuTexture, _minX, _minY, _maxX, _maxY, _firstSample, _sampleCount, _accumulate);
+}
+
+template<bool HAS_DEFOCUS, bool IS_ORTHOGRAPHIC, int MAX_DEPTH>
+void Camera::RenderTileKernel(const Hittable& _world, const MaterialTable& _materials, CPUTexture& _cpuTexture, unsigned int _minX, unsigned int _minY, unsigned int _maxX, unsigned int _maxY, int _firstSample, int _sampleCount, bool _accumulate) const
+{
+	unsigned int w = _cpuTexture.GetWidth();
+	unsigned int tileWidth = _maxX - _minX;
+	int pixelCount = (int)(tileWidth * (_maxY - _minY));
+	// Rays traced by this tile's paths, added to the camera's totals at the end
+	unsigned long long tileSegmentCount = 0;
+
+	// Each sample's camera rays for the whole tile are generated at once,
+	// then traced in order. Every pixel still sums its samples in order
+	CameraRayBatch rays;
+	std::vector<XMVECTOR> pixelColors(pixelCount, XMVectorZero());
+
+	for (int sample = _firstSample; sample < _firstSample + _sampleCount; sample++) {
+		rays.GenerateFor<HAS_DEFOCUS, IS_ORTHOGRAPHIC>(cameraRayConstants, _minX, _minY, _maxX, _maxY, w, sample);
+
+		for (int i = 0; i < pixelCount; i++) {
+			unsigned int x = _minX + i % tileWidth;
+			unsigned int y = _minY + i / tileWidth;
+
+			// Key random numbers to this pixel and sample, so the
+			// result doesn't depend on which thread renders it
+			Random::BeginSample(y * w + x, sample);
+
+			// Accumulate color
+			int segmentCount;
+			pixelColors[i] = pixelColors[i] + RayColor<MAX_DEPTH>(rays.GetRay(i), _world, _materials, segmentCount);
+			tileSegmentCount += segmentCount;
+		}
+	}
+
+	for (int i = 0; i < pixelCount; i++) {
+		StorePixel(_cpuTexture, _minX + i % tileWidth, _minY + i / tileWidth, pixelColors[i], _firstSample, _sampleCount, _accumulate);
+	}
+
+	pathCount += (unsigned long long)pixelCount * _sampleCount;
+	pathSegmentCount += tileSegmentCount;
+}
+
+template<bool HAS_DEFOCUS, bool IS_ORTHOGRAPHIC, int MAX_DEPTH>
+void Camera::RenderTileAdaptive(const Hittable& _world, const MaterialTable& _materials, CPUTexture& _cpuTexture, unsigned int _minX, unsigned int _minY, unsigned int _maxX, unsigned int _maxY, int _firstSample, int _sampleCount, bool _accumulate) const
+{
+	unsigned int w = _cpuTexture.GetWidth();
+	unsigned int tileWidth = _maxX - _minX;
+	int pixelCount = (int)(tileWidth * (_maxY - _minY));
+	unsigned long long tileSegmentCount = 0;
+	unsigned long long tileSampleCount = 0;
+
+	// Each pixel's new samples, and statistics over every sample it's taken
+	std::vector<XMVECTOR> pixelColors(pixelCount, XMVectorZero());
+	std::vector<int> newSampleCounts(pixelCount, 0);
+	std::vector<PixelVariance> variances(pixelCount);
+
+	// Pixels still taking samples. Carrying on an accumulated image, they're
+	// the ones that weren't done after the last frame, which have all taken
+	// _firstSample samples; the rest keep what they have
+	std::vector<int> activePixels;
+	activePixels.reserve(pixelCount);
+	for (int i = 0; i < pixelCount; i++) {
+		if (_accumulate && _firstSample > 0) {
+			variances[i] = accumulationBuffer->GetVariance(_minX + i % tileWidth, _minY + i / tileWidth);
+			if (IsPixelDone(variances[i]))
+				continue;
+		}
+		activePixels.push_back(i);
+	}
+
+	// A whole image in one go may spend _sampleCount samples per pixel on
+	// average, and up to ADAPTIVE_MAX_SAMPLE_SCALE times that on any one pixel.
+	// Accumulated images are budgeted across frames by the caller instead
+	int roundCount = _accumulate ? _sampleCount : _sampleCount * ADAPTIVE_MAX_SAMPLE_SCALE;
+	unsigned long long budget = _accumulate ? ULLONG_MAX : (unsigned long long)_sampleCount * pixelCount;
+
+	CameraRayBatch rays;
+	for (int round = 0; round < roundCount && !activePixels.empty(); round++) {
+		int sample = _firstSample + round;
+
+		// Once most of the tile is done, generate rays for just the rest
+		bool isBatched = activePixels.size() * 4 >= (size_t)pixelCount;
+		if (isBatched)
+			rays.GenerateFor<HAS_DEFOCUS, IS_ORTHOGRAPHIC>(cameraRayConstants, _minX, _minY, _maxX, _maxY, w, sample);
+
+		for (int i : activePixels) {
+			unsigned int x = _minX + i % tileWidth;
+			unsigned int y = _minY + i / tileWidth;
+			Random::BeginSample(y * w + x, sample);
+			Ray ray = isBatched ? rays.GetRay(i) : GetRay(x, y);
+
+			int segmentCount;
+			XMVECTOR color = RayColor<MAX_DEPTH>(ray, _world, _materials, segmentCount);
+			pixelColors[i] = pixelColors[i] + color;
+			newSampleCounts[i]++;
+			variances[i].Add(Luminance(color));
+			tileSegmentCount += segmentCount;
+		}
+		tileSampleCount += activePixels.size();
+
+		std::erase_if(activePixels, [&](int _i) { return IsPixelDone(variances[_i]); });
+
+		// Without the budget for another full round, only the noisiest carry on
+		unsigned long long remainingBudget = budget - tileSampleCount;
+		if (activePixels.size() > remainingBudget) {
+			std::nth_element(activePixels.begin(), activePixels.begin() + remainingBudget, activePixels.end(), [&](int _a, int _b) {
+				return PixelError(variances[_a]) > PixelError(variances[_b]);
+			});
+			activePixels.resize(remainingBudget);
+			std::sort(activePixels.begin(), activePixels.end());
+		}
+	}
+
+	unsigned int maxSampleCount = (unsigned int)samplesPerPixel * ADAPTIVE_MAX_SAMPLE_SCALE;
+	for (int i = 0; i < pixelCount; i++) {
+		unsigned int x = _minX + i % tileWidth;
+		unsigned int y = _minY + i / tileWidth;
+		if (newSampleCounts[i] > 0) {
+			StorePixel(_cpuTexture, x, y, pixelColors[i], _firstSample, newSampleCounts[i], _accumulate);
+			if (_accumulate)
+				accumulationBuffer->SetVariance(x, y, variances[i]);
+		}
+
+		if (showSampleCounts)
+			_cpuTexture.SetColor(x, y, SampleCountColor(variances[i].count, maxSampleCount));
+	}
+
+	adaptiveActivePixelCount += activePixels.size();
+	if (_accumulate)
+		adaptiveAccumulatedSampleCount += tileSampleCount;
+	pathCount += tileSampleCount;
+	pathSegmentCount += tileSegmentCount;
+}
+
+bool Camera::IsPixelDone(const PixelVariance& _variance) const
+{
+	return (int)_variance.count >= adaptiveMinSamples && PixelError(_variance) <= 1.0f;
+}
+
+float Camera::PixelError(const PixelVariance& _variance) const
+{
+	return _variance.ConfidenceHalfWidth() / (adaptiveThreshold * std::max(_variance.mean, ADAPTIVE_MIN_LUMINANCE));
+}
+
+void Camera::RenderTilePackets(const Hittable& _world, const MaterialTable& _materials, CPUTexture& _cpuTexture, unsigned int _minX, unsigned int _minY, unsigned int _maxX, unsigned int _maxY, int _firstSample, int _sampleCount, bool _accumulate) const
+{
+	unsigned int w = _cpuTexture.GetWidth();
+	unsigned long long tileSegmentCount = 0;
+
+	CameraRayBatch rays;
+	RayPacket packet;
+	RayHit hits[RayPacket::MAX_RAYS];
+	XMVECTOR pixelColors[RayPacket::MAX_RAYS];
+
+	for (unsigned int blockY = _minY; blockY < _maxY; blockY += packetSize) {
+		unsigned int blockMaxY = std::min(blockY + packetSize, _maxY);
+
+		for (unsigned int blockX = _minX; blockX < _maxX; blockX += packetSize) {
+			unsigned int blockMaxX = std::min(blockX + packetSize, _maxX);
+			unsigned int blockWidth = blockMaxX - blockX;
+			int pixelCount = (int)(blockWidth * (blockMaxY - blockY));
+
+			for (int i = 0; i < pixelCount; i++) {
+				pixelColors[i] = XMVectorZero();
+			}
+
+			for (int sample = _firstSample; sample < _firstSample + _sampleCount; sample++) {
+				// Camera rays for this sample of every pixel in the block, keyed
+				// just like RenderTile's. Thin-lens origins vary across the
+				// packet, which its interval test allows for
+				rays.Generate(cameraRayConstants, blockX, blockY, blockMaxX, blockMaxY, w, sample);
+				packet.count = pixelCount;
+				for (int i = 0; i < pixelCount; i++) {
+					packet.rays[i] = rays.GetRay(i);
+				}
+				packet.Prepare();
+				_world.IntersectPacket(packet, Interval(0.001f, infinity), hits);
+
+				// Each path carries on alone from its first hit
+				for (int i = 0; i < pixelCount; i++) {
+					unsigned int x = blockX + i % blockWidth;
+					unsigned int y = blockY + i / blockWidth;
+					Random::BeginSample(y * w + x, sample);
+
+					int segmentCount;
+					pixelColors[i] = pixelColors[i] + RayColor(packet.rays[i], _world, _materials, segmentCount, &hits[i]);
+					tileSegmentCount += segmentCount;
+				}
+			}
+
+			for (int i = 0; i < pixelCount; i++) {
+				StorePixel(_cpuTexture, blockX + i % blockWidth, blockY + i / blockWidth, pixelColors[i], _firstSample, _sampleCount, _accumulate);
+			}
+		}
+	}
+
+	pathCount += (unsigned long long)(_maxX - _minX) * (_maxY - _minY) * _sampleCount;
+	pathSegmentCount += tileSegmentCount;
+}
+
+void Camera::StorePixel(CPUTexture& _cpuTexture, unsigned int _x, unsigned int _y, DirectX::XMVECTOR _colorSum, int _firstSample, int _sampleCount, bool _accumulate) const
+{
+	// Average, either over this frame's samples or every sample so far
+	XMVECTOR vecMeanColor;
+	if (_accumulate) {
+		// The first samples overwrite whatever the buffer held before
+		if (_firstSample == 0) {
+			accumulationBuffer->SetSamples(_x, _y, _colorSum, _sampleCount);
+		}
+		else {
+			accumulationBuffer->AddSamples(_x, _y, _colorSum, _sampleCount);
+		}
+		vecMeanColor = accumulationBuffer->GetMean(_x, _y);
+	}
+	else {
+		vecMeanColor = XMVectorScale(_colorSum, 1.0f / _sampleCount);
+	}
+
+	// Gamma-correct & store
+	XMFLOAT3 pixelColor;
+	XMStoreFloat3(&pixelColor, LinearToGamma(vecMeanColor));
+	// Set final pixel color
+	_cpuTexture.SetColor(_x, _y, XMFLOAT4(pixelColor.x, pixelColor.y, pixelColor.z, 1.0f));
+}
+
+void Camera::RenderImage(const Hittable& _world, const MaterialTable& _materials, CPUTexture& _cpuTexture)
+{
+	RenderRows(_world, _materials, _cpuTexture, 0, _cpuTexture.GetHeight(), 0, samplesPerPixel, false);
+}
+
+void Camera::RenderRows(const Hittable& _world, const MaterialTable& _materials, CPUTexture& _cpuTexture, unsigned int _minY, unsigned int _maxY, int _firstSample, int _sampleCount, bool _accumulate)
+{
+	// Settings may have changed since the last render
+	UpdateCameraRayConstants();
+	SelectTileKernel();
+	adaptiveActivePixelCount = 0;
+
+	unsigned int w = _cpuTexture.GetWidth();
+	Random::ActiveSampler = sampler.get();
+	if (sampler)
+		sampler->SetImageWidth(w);
+
+	if (renderMode == RenderMode::Wavefront) {
+		RenderRowsWavefront(_world, _materials, _cpuTexture, _minY, _maxY, _firstSample, _sampleCount, _accumulate);
+		Random::ActiveSampler = nullptr;
+		return;
+	}
+
+	// Hand each tile to the pool; tiles on the right and bottom
+	// edges are clipped to the texture's bounds
+	for (unsigned int tileY = _minY; tileY < _maxY; tileY += tileSize) {
+		unsigned int tileMaxY = std::min(tileY + tileSize, _maxY);
+
+		for (unsigned int tileX = 0; tileX < w; tileX += tileSize) {
+			unsigned int tileMaxX = std::min(tileX + tileSize, w);
+
+			threadPool->Submit([=, this, &_world, &_materials, &_cpuTexture]() {
+				RenderTile(_world, _materials, _cpuTexture, tileX, tileY, tileMaxX, tileMaxY, _firstSample, _sampleCount, _accumulate);
+			});
+		}
+	}
+
+	// Don't return until the whole region has been drawn
+	threadPool->Wait();
+
+	// Numbers drawn outside a render, such as for building scenes, stay independent
+	Random::ActiveSampler = nullptr;
+}
+
+template<MaterialTable::MaterialType TYPE>
+void Camera::ShadeWavefrontPaths(const Hittable& _world, const MaterialTable& _materials, const uint32_t* _ids, size_t _count, int _bounce, unsigned int _firstPixel, int _firstSample, int _sampleCount)
+{
+	WavefrontQueues& queues = wavefrontQueues;
+	for (size_t i = 0; i < _count; i++) {
+		uint32_t id = _ids[i];
+		WavefrontPath& path = queues.paths[id];
+		XMVECTOR throughput = XMLoadFloat3(&path.throughput);
+		XMVECTOR radiance = XMLoadFloat3(&path.radiance);
+
+		// Key random numbers to the same sample and bounce as the megakernel
+		Random::BeginSample(_firstPixel + id / _sampleCount, _firstSample + (int)(id % _sampleCount));
+		Random::BeginBounce(_bounce);
+
+		const HitRecord& record = queues.hits[id];
+		const auto& material = _materials.GetAs<TYPE>(record.material);
+		XMVECTOR emitted = material.Emitted(record);
+		if (!XMVector3Equal(emitted, XMVectorZero()))
+			radiance = radiance + throughput * XMVectorScale(emitted, EmissionWeight(path.ray, record, path.scatterPdf, path.scatterNormal, path.wasLightSampled));
+
+		path.wasLightSampled = false;
+		if (UsesLightSampling()) {
+			auto evaluate = [&](const XMFLOAT3& _direction, XMFLOAT3& _value, float& _pdf) {
+				return material.Evaluate(path.ray, record, _direction, _value, _pdf);
+			};
+			radiance = radiance + throughput * SampleLightWith(_world, record, evaluate, path.wasLightSampled);
+		}
+		XMStoreFloat3(&path.radiance, radiance);
+
+		ScatterRecord scatter;
+		if (!material.Scatter(path.ray, record, scatter)) {
+			path.hasEnded = true;
+			continue;
+		}
+
+		throughput = throughput * scatter.Weight(record.normal);
+		path.ray = scatter.scattered;
+		path.scatterPdf = scatter.pdf;
+		path.scatterNormal = record.normal;
+		if (!SurvivesRoulette(_bounce, throughput)) {
+			path.hasEnded = true;
+			continue;
+		}
+		XMStoreFloat3(&path.throughput, throughput);
+	}
+}
+
+void Camera::RenderRowsWavefront(const Hittable& _world, const MaterialTable& _materials, CPUTexture& _cpuTexture, unsigned int _minY, unsigned int _maxY, int _firstSample, int _sampleCount, bool _accumulate)
+{
+	auto renderStart = std::chrono::high_resolution_clock::now();
+	auto secondsSince = [](std::chrono::high_resolution_clock::time_point _start) {
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - _start).count();
+	};
+	wavefrontStageTimes = WavefrontStageTimes();
+
+	unsigned int w = _cpuTexture.GetWidth();
+
+	// Shading queues: one per material type, then one for paths that escaped
+	const uint32_t skyQueue = MaterialTable::MATERIAL_TYPE_COUNT;
+	const uint32_t queueCount = skyQueue + 1;
+
+	// Waves hold whole pixels, every sample of each, so a pixel's samples
+	// can be summed in the same order the megakernel adds them
+	unsigned int wavePixelCount = std::max(1u, WAVEFRONT_WAVE_SIZE / (unsigned int)_sampleCount);
+	unsigned int endPixel = _maxY * w;
+	WavefrontQueues& queues = wavefrontQueues;
+
+	for (unsigned int firstPixel = _minY * w; firstPixel < endPixel; firstPixel += wavePixelCount) {
+		unsigned int pixelCount = std::min(wavePixelCount, endPixel - firstPixel);
+		size_t wavePathCount = (size_t)pixelCount * _sampleCount;
+		queues.paths.resize(wavePathCount);
+		queues.hits.resize(wavePathCount);
+		queues.active.resize(wavePathCount);
+		queues.sorted.resize(wavePathCount);
+
+		// Generate: a camera ray for every path, keyed just like RenderTile's
+		auto stageStart = std::chrono::high_resolution_clock::now();
+		threadPool->ParallelFor(wavePathCount, [&](size_t _begin, size_t _end) {
+			for (size_t i = _begin; i < _end; i++) {
+				unsigned int pixel = firstPixel + (unsigned int)(i / _sampleCount);
+				Random::BeginSample(pixel, _firstSample + (int)(i % _sampleCount));
+
+				WavefrontPath& path = queues.paths[i];
+				path.ray = GetRay(pixel % w, pixel / w);
+				path.throughput = XMFLOAT3(1.0f, 1.0f, 1.0f);
+				path.radiance = XMFLOAT3(0.0f, 0.0f, 0.0f);
+				path.scatterPdf = 0.0f;
+				path.scatterNormal = XMFLOAT3(0.0f, 0.0f, 0.0f);
+				path.wasLightSampled = false;
+				path.segmentCount = 0;
+				path.hasEnded = false;
+				queues.active[i] = (uint32_t)i;
+			}
+		});
+		size_t activeCount = wavePathCount;
+		wavefrontStageTimes.generateSeconds += secondsSince(stageStart);
+
+		for (int bounce = 1; bounce <= maxDepth && activeCount > 0; bounce++) {
+			// Intersect: find each path's closest hit and which queue shades it
+			stageStart = std::chrono::high_resolution_clock::now();
+			threadPool->ParallelFor(activeCount, [&](size_t _begin, size_t _end) {
+				for (size_t i = _begin; i < _end; i++) {
+					uint32_t id = queues.active[i];
+					WavefrontPath& path = queues.paths[id];
+					path.segmentCount++;
+
+					if (_world.Hit(path.ray, Interval(0.001f, infinity), queues.hits[id]))
+						path.queue = (uint32_t)_materials.GetType(queues.hits[id].material);
+					else
+						path.queue = skyQueue;
+				}
+			});
+			wavefrontStageTimes.intersectSeconds += secondsSince(stageStart);
+
+			// Sort: counting sort by queue, keeping paths in order within each one
+			stageStart = std::chrono::high_resolution_clock::now();
+			size_t queueStart[queueCount + 1] = {};
+			for (size_t i = 0; i < activeCount; i++) {
+				queueStart[queues.paths[queues.active[i]].queue + 1]++;
+			}
+			for (uint32_t queue = 0; queue < queueCount; queue++) {
+				queueStart[queue + 1] += queueStart[queue];
+			}
+			size_t queueFill[queueCount];
+			std::copy(queueStart, queueStart + queueCount, queueFill);
+			for (size_t i = 0; i < activeCount; i++) {
+				uint32_t id = queues.active[i];
+				queues.sorted[queueFill[queues.paths[id].queue]++] = id;
+			}
+			wavefrontStageTimes.sortSeconds += secondsSince(stageStart);
+
+			// Shade: each queue runs one material type's kernel, which calls
+			// that type's code directly, over a contiguous batch of paths
+			stageStart = std::chrono::high_resolution_clock::now();
+			for (uint32_t queue = 0; queue < queueCount; queue++) {
+				size_t queueBegin = queueStart[queue];
+				threadPool->ParallelFor(queueStart[queue + 1] - queueBegin, [&](size_t _begin, size_t _end) {
+					const uint32_t* ids = &queues.sorted[queueBegin + _begin];
+					size_t count = _end - _begin;
+					if (queue == skyQueue) {
+						for (size_t i = 0; i < count; i++) {
+							WavefrontPath& path = queues.paths[ids[i]];
+							XMVECTOR radiance = XMLoadFloat3(&path.radiance) + XMLoadFloat3(&path.throughput) * SkyColor(path.ray);
+							XMStoreFloat3(&path.radiance, radiance);
+							path.hasEnded = true;
+						}
+						return;
+					}
+
+					// Only closed-set dispatch calls materials by type
+					MaterialTable::MaterialType type = Dispatch::Mode == DispatchMode::ClosedSet ?
+						(MaterialTable::MaterialType)queue : MaterialTable::MaterialType::Other;
+					switch (type) {
+					case MaterialTable::MaterialType::Lambertian:
+						ShadeWavefrontPaths<MaterialTable::MaterialType::Lambertian>(_world, _materials, ids, count, bounce, firstPixel, _firstSample, _sampleCount);
+						break;
+					case MaterialTable::MaterialType::Metal:
+						ShadeWavefrontPaths<MaterialTable::MaterialType::Metal>(_world, _materials, ids, count, bounce, firstPixel, _firstSample, _sampleCount);
+						break;
+					case MaterialTable::MaterialType::Dielectric:
+						ShadeWavefrontPaths<MaterialTable::MaterialType::Dielectric>(_world, _materials, ids, count, bounce, firstPixel, _firstSample, _sampleCount);
+						break;
+					case MaterialTable::MaterialType::DiffuseLight:
+						ShadeWavefrontPaths<MaterialTable::MaterialType::DiffuseLight>(_world, _materials, ids, count, bounce, firstPixel, _firstSample, _sampleCount);
+						break;
+					default:
+						ShadeWavefrontPaths<MaterialTable::MaterialType::Other>(_world, _materials, ids, count, bounce, firstPixel, _firstSample, _sampleCount);
+						break;
+					}
+				});
+			}
+			wavefrontStageTimes.shadeSeconds += secondsSince(stageStart);
+
+			// Compact: keep the paths still bouncing, in their sorted order
+			stageStart = std::chrono::high_resolution_clock::now();
+			size_t aliveCount = 0;
+			for (size_t i = 0; i < activeCount; i++) {
+				uint32_t id = queues.sorted[i];
+				if (!queues.paths[id].hasEnded)
+					queues.active[aliveCount++] = id;
+			}
+			activeCount = aliveCount;
+			wavefrontStageTimes.compactSeconds += secondsSince(stageStart);
+		}
+
+		// Paths still active ran out of bounces and gathered no light.
+		// Sum every pixel's samples and store it
+		stageStart = std::chrono::high_resolution_clock::now();
+		threadPool->ParallelFor(pixelCount, [&](size_t _begin, size_t _end) {
+			unsigned long long segmentCount = 0;
+			for (size_t i = _begin; i < _end; i++) {
+				unsigned int pixel = firstPixel + (unsigned int)i;
+
+				XMVECTOR vecPixelColor = XMVectorZero();
+				for (int sample = 0; sample < _sampleCount; sample++) {
+					const WavefrontPath& path = queues.paths[i * _sampleCount + sample];
+					vecPixelColor = vecPixelColor + XMLoadFloat3(&path.radiance);
+					segmentCount += path.segmentCount;
+				}
+
+				StorePixel(_cpuTexture, pixel % w, pixel / w, vecPixelColor, _firstSample, _sampleCount, _accumulate);
+			}
+			pathSegmentCount += segmentCount;
+		});
+		pathCount += wavePathCount;
+		wavefrontStageTimes.accumulateSeconds += secondsSince(stageStart);
+	}
+
+	wavefrontStageTimes.totalSeconds = secondsSince(renderStart);
+}
+
 
 
 
@@ -457,7 +1479,7 @@ bool FPSCamera::Update(float dt)
 	return isInputDetected;
 }
 
-void FPSCamera::Render(const Hittable& _world, std::shared_ptr<CPUTexture> _cpuTexture, float _deltaTime, float _totalTime)
+void FPSCamera::Render(const Hittable& _world, const MaterialTable& _materials, std::shared_ptr<CPUTexture> _cpuTexture, float _deltaTime, float _totalTime)
 {
 	// Check for input and move Camera if needed
 	bool isInputDetected = Update(_deltaTime);
@@ -475,11 +1497,15 @@ void FPSCamera::Render(const Hittable& _world, std::shared_ptr<CPUTexture> _cpuT
 		);
 		// Reset scanline
 		currentScanline = 0;
-		UpdateViewportData();
+		if (UpdateViewportData()) {
+			accumulatedSamples = 0;
+		}
 	}
 	// If it hasn't already been, update viewport data with movement
 	else if (isInputDetected) {
-		UpdateViewportData();
+		if (UpdateViewportData()) {
+			accumulatedSamples = 0;
+		}
 	}
 
 
@@ -488,51 +1514,51 @@ void FPSCamera::Render(const Hittable& _world, std::shared_ptr<CPUTexture> _cpuT
 	unsigned int w = _cpuTexture->GetWidth();
 	unsigned int h = _cpuTexture->GetHeight();
 
-	float fWidth = (float)w;
-	float fHeight = (float)h;
-	float fSinTime = (float)sin(_totalTime) * 0.5f + 0.5f;
-
-	unsigned int y = currentScanline;
-	// If camera has detected input, render full screen;
-	// If not, set the max row to be rendered this frame so
-	// only one scanline is rendered
-	unsigned int frameRenderHeight = isInputDetected ? h : y + 1;
+	// A still, progressive camera adds a few samples to every pixel each
+	// frame until it reaches the full sample count
+	if (isProgressive && !isInputDetected) {
+		// Start over if the texture's size no longer matches
+		if (!accumulationBuffer) {
+			accumulationBuffer = std::make_shared<AccumulationBuffer>(w, h);
+			accumulatedSamples = 0;
+		}
+		else if (accumulationBuffer->GetWidth() != w || accumulationBuffer->GetHeight() != h) {
+			accumulationBuffer->Resize(w, h);
+			accumulatedSamples = 0;
+		}
 
-	// Get relevant information
-	XMVECTOR vecPixelDeltaU = XMLoadFloat3(&pixelDeltaU);
-	XMVECTOR vecPixelDeltaV = XMLoadFloat3(&pixelDeltaV);
-	XMFLOAT3 cameraPosition = transform->GetPosition();
-	XMVECTOR vecCameraPosition = XMLoadFloat3(&cameraPosition);
+		// Adaptive images stop early once every pixel is done, or once they've
+		// used the samples a fixed image would have, but noisy pixels may go
+		// on past the samples per pixel
+		int sampleLimit = samplesPerPixel;
+		bool isFinished = false;
+		if (UsesAdaptiveSampling()) {
+			if (accumulatedSamples == 0)
+				adaptiveAccumulatedSampleCount = 0;
+			sampleLimit *= ADAPTIVE_MAX_SAMPLE_SCALE;
+			isFinished = accumulatedSamples > 0 &&
+				(adaptiveActivePixelCount == 0 || adaptiveAccumulatedSampleCount >= (unsigned long long)samplesPerPixel * w * h);
+		}
 
-	while (y < frameRenderHeight)
-	{
-		for (unsigned int x = 0; x < w; x++)
-		{
-			XMFLOAT3 pixelColor = XMFLOAT3(0.0f, 0.0f, 0.0f);
-			XMVECTOR vecPixelColor = XMLoadFloat3(&pixelColor);
+		if (accumulatedSamples < sampleLimit && !isFinished) {
+			int frameSamples = std::min(progressiveSamplesPerFrame, sampleLimit - accumulatedSamples);
+			RenderRows(_world, _materials, *_cpuTexture, 0, h, accumulatedSamples, frameSamples, true);
+			accumulatedSamples += frameSamples;
+		}
 
-			for (int sample = 0; sample < samplesPerPixel; sample++) {
-				// Create ray
-				Ray ray = GetRay(x, y, vecPixelDeltaU, vecPixelDeltaV, vecCameraPosition);
+		wasInputDetectedLastFrame = isInputDetected;
+		return;
+	}
 
-				// Accumulate color
-				vecPixelColor = vecPixelColor + RayColor(ray, maxDepth, _world);
-			}
+	// If camera has detected input, render full screen;
+	// If not, only render one row of tiles starting at the current scanline
+	unsigned int minY = isInputDetected ? 0 : currentScanline;
+	unsigned int maxY = isInputDetected ? h : std::min(currentScanline + tileSize, h);
 
-			// Average, gamma-correct, & store
-			XMStoreFloat3(&pixelColor, 
-				LinearToGamma(
-					XMVectorScale(vecPixelColor, pixelSamplesScale)
-				)
-			);
-			// Set final pixel color
-			_cpuTexture->SetColor(x, y, XMFLOAT4(pixelColor.x, pixelColor.y, pixelColor.z, 1.0f));
-		}
-		y++;
-	}
+	RenderRows(_world, _materials, *_cpuTexture, minY, maxY, 0, samplesPerPixel, false);
 
 	if (!isInputDetected) {
-		currentScanline++;
+		currentScanline = maxY;
 		currentScanline %= h;
 	}
 
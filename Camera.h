@@ -1,8 +1,16 @@
 #pragma once
+#include <atomic>
 #include <memory>
 #include "Hittable.h"
 #include "Transform.h"
 #include "CPUTexture.h"
+#include "AccumulationBuffer.h"
+#include "ThreadPool.h"
+#include "MaterialTable.h"
+#include "Wavefront.h"
+#include "CameraRays.h"
+#include "Sampler.h"
+#include "LightList.h"
 
 enum class CameraProjectionType
 {
@@ -10,6 +18,15 @@ enum class CameraProjectionType
 	Orthographic
 };
 
+// How many camera paths were traced, and how many rays they took in total
+struct PathStats
+{
+	unsigned long long pathCount = 0;
+	unsigned long long segmentCount = 0;
+
+	double AverageLength() const { return pathCount > 0 ? (double)segmentCount / pathCount : 0.0; }
+};
+
 class Camera
 {
 public:
@@ -68,12 +85,104 @@ public:
 	int GetMaxDepth();
 	void SetMaxDepth(int _depth);
 
+	// Whether paths may be ended early by Russian roulette
+	bool GetRussianRoulette();
+	void SetRussianRoulette(bool _useRoulette);
+
+	// Bounces every path makes before Russian roulette may end it
+	int GetRouletteMinDepth();
+	void SetRouletteMinDepth(int _depth);
+
+	// Whether paths are followed one at a time or in wavefront batches
+	RenderMode GetRenderMode();
+	void SetRenderMode(RenderMode _mode);
+	// Stage timings from the last wavefront render
+	const WavefrontStageTimes& GetWavefrontStageTimes();
+
+	// Width and height of the pixel blocks whose camera rays are traced
+	// together as packets, up to 8. At 1, every ray is traced alone
+	unsigned int GetPacketSize();
+	void SetPacketSize(unsigned int _packetSize);
+
+	// Where pixel, lens and scatter numbers come from. Changing it starts
+	// progressive images over
+	SamplerType GetSamplerType();
+	void SetSamplerType(SamplerType _type);
+
+	// Emissive spheres bounces can sample directly; null or empty for none.
+	// The list is read at render time, so it can be rebuilt in place
+	std::shared_ptr<const LightList> GetLights();
+	void SetLights(std::shared_ptr<const LightList> _lights);
+
+	// How light from the emitters is found. Changing it starts progressive
+	// images over
+	LightSampling GetLightSampling();
+	void SetLightSampling(LightSampling _lightSampling);
+
+	// How a light is picked for each light sample. Changing it starts
+	// progressive images over
+	LightSelection GetLightSelection();
+	void SetLightSelection(LightSelection _lightSelection);
+
+	// Scales the sky's light, so emitters can be seen lighting the scene
+	float GetSkyBrightness();
+	void SetSkyBrightness(float _brightness);
+
+	// Whether pixels stop taking samples once their mean is known well enough,
+	// spending what they'd have used on noisier pixels instead. Each pixel
+	// takes at least the minimum samples and at most ADAPTIVE_MAX_SAMPLE_SCALE
+	// times the samples per pixel, and the image as a whole takes no more than
+	// the samples per pixel on average. Applies to single-ray megakernel renders
+	bool GetAdaptiveSampling();
+	void SetAdaptiveSampling(bool _isAdaptive);
+
+	// A pixel is done once the 95% confidence interval of its luminance is
+	// narrower than this fraction of its mean
+	float GetAdaptiveThreshold();
+	void SetAdaptiveThreshold(float _threshold);
+
+	int GetAdaptiveMinSamples();
+	void SetAdaptiveMinSamples(int _samples);
+
+	// Whether adaptive renders show how many samples each pixel took, from
+	// blue for the fewest through green to red for the most, instead of the image
+	bool GetShowSampleCounts();
+	void SetShowSampleCounts(bool _showSampleCounts);
+
+	// Paths traced since the stats were last reset
+	PathStats GetPathStats();
+	void ResetPathStats();
+
 	float GetDefocusAngle();
 	void  SetDefocusAngle(float _angle);
 
 	float GetFocusDist();
 	void  SetFocusDist(float _dist);
 
+	// Renders the whole image to the texture at full quality, blocking until done
+	void RenderImage(const Hittable& _world, const MaterialTable& _materials, CPUTexture& _cpuTexture);
+
+	unsigned int GetThreadCount();
+	void SetThreadCount(unsigned int _threadCount);
+	std::shared_ptr<ThreadPool> GetThreadPool();
+
+	unsigned int GetTileSize();
+	void SetTileSize(unsigned int _tileSize);
+
+	bool GetProgressive();
+	void SetProgressive(bool _isProgressive);
+
+	int GetProgressiveSamplesPerFrame();
+	void SetProgressiveSamplesPerFrame(int _samples);
+	// Throws away accumulated samples, such as after the scene changes
+	void ResetAccumulation();
+
+	// Generates, without tracing, the camera rays for _sampleCount samples of
+	// every pixel of a _width x _height image on the calling thread, either in
+	// tile-sized batches or one at a time. Only for timing ray generation on
+	// its own; returns a sum over the rays so the work can't be skipped
+	float GenerateCameraRays(unsigned int _width, unsigned int _height, int _sampleCount, bool _useBatches);
+
 
 
 	
@@ -108,6 +217,16 @@ protected:
 	// Whether the camera moved last frame
 	bool wasInputDetectedLastFrame = false;
 
+	// Whether a still camera refines the whole image each frame rather than
+	// finishing one row of tiles at a time
+	bool isProgressive;
+	// Samples added to every pixel each frame in progressive mode
+	int progressiveSamplesPerFrame;
+	// Samples every pixel of the accumulation buffer holds so far
+	int accumulatedSamples;
+	// Running per-pixel color sums for progressive mode
+	std::shared_ptr<AccumulationBuffer> accumulationBuffer;
+
 
 
 	// Image Variables
@@ -125,41 +244,175 @@ protected:
 	// U and V are Camera's Right and -Up vectors, respectively
 	DirectX::XMFLOAT3 viewportU;
 	DirectX::XMFLOAT3 viewportV;
-	// World delta vectors along each pixel
-	DirectX::XMFLOAT3 pixelDeltaU;
-	DirectX::XMFLOAT3 pixelDeltaV;
+	// World delta vectors along each pixel. These and the values below are
+	// zeroed so the first UpdateViewportData() compares against known values
+	DirectX::XMFLOAT3 pixelDeltaU{};
+	DirectX::XMFLOAT3 pixelDeltaV{};
 	// World position of the upper-leftmost position of the viewport
 	DirectX::XMFLOAT3 upperLeftViewportLocation;
 	// World position of the center of upper-leftmost pixel of the viewport
-	DirectX::XMFLOAT3 upperLeftPixelCenter;
+	DirectX::XMFLOAT3 upperLeftPixelCenter{};
 
 	// Defocus disk horizontal and vertical radius
-	DirectX::XMFLOAT3 defocusDiskU;
-	DirectX::XMFLOAT3 defocusDiskV;
+	DirectX::XMFLOAT3 defocusDiskU{};
+	DirectX::XMFLOAT3 defocusDiskV{};
+
+	// The above, with the camera's position, as of the current frame's render
+	CameraRayConstants cameraRayConstants;
 
 	int samplesPerPixel;
 	float pixelSamplesScale;
 	int maxDepth;
 
+	bool useRussianRoulette;
+	int rouletteMinDepth;
+
+	SamplerType samplerType;
+	// Null for independent numbers
+	std::shared_ptr<Sampler> sampler;
+
+	std::shared_ptr<const LightList> lights;
+	LightSampling lightSampling;
+	LightSelection lightSelection;
+	float skyBrightness;
+
+	bool isAdaptive;
+	float adaptiveThreshold;
+	int adaptiveMinSamples;
+	bool showSampleCounts;
+	// Most samples a pixel may take, as a multiple of samplesPerPixel
+	static const int ADAPTIVE_MAX_SAMPLE_SCALE = 4;
+	// Dark pixels' errors are measured against this luminance instead, so
+	// they aren't held to an ever smaller absolute error
+	static constexpr float ADAPTIVE_MIN_LUMINANCE = 0.1f;
+	// Pixels still taking samples after the last adaptive render, and samples
+	// taken so far by the progressive image in the accumulation buffer
+	mutable std::atomic<unsigned long long> adaptiveActivePixelCount;
+	mutable std::atomic<unsigned long long> adaptiveAccumulatedSampleCount;
+
+	RenderMode renderMode;
+	unsigned int packetSize;
+	// Most paths in flight at once in wavefront mode
+	static const unsigned int WAVEFRONT_WAVE_SIZE = 1 << 18;
+	WavefrontQueues wavefrontQueues;
+	WavefrontStageTimes wavefrontStageTimes;
+
+	// Running totals for GetPathStats(), added to once per tile
+	mutable std::atomic<unsigned long long> pathCount;
+	mutable std::atomic<unsigned long long> pathSegmentCount;
+
+
+
+	// Tile rendering specialized for the camera's settings as of the current
+	// frame's render, so they aren't checked once per sample
+	using TileKernel = void (Camera::*)(const Hittable&, const MaterialTable&, CPUTexture&, unsigned int, unsigned int, unsigned int, unsigned int, int, int, bool) const;
+	TileKernel tileKernel;
+
+
+
+	// Multithreading Variables
+
+	// Worker threads that render tiles of the image in parallel
+	std::shared_ptr<ThreadPool> threadPool;
+	// Width and height of each square tile of the image, in pixels
+	unsigned int tileSize;
+
 
 
 	// --- FUNCTIONS ---
 
 	// Image Rendering Functions
 	void Initialize();
-	// Resizes render texture and updates associated variables
-	void UpdateViewportData();
+	// Resizes render texture and updates associated variables.
+	// Returns whether any viewport data changed, which invalidates accumulated samples
+	bool UpdateViewportData();
 
 	// Drawing helper functions
 
+	// Gathers what camera rays are built from for this frame's render
+	void UpdateCameraRayConstants();
 	// Construct camera ray originating from origin and directed at randomly
-	// sampled point around pixel location _i, _j.
-	Ray GetRay(unsigned int _i, unsigned int _j, DirectX::XMVECTOR _pixelDeltaU, DirectX::XMVECTOR _pixelDeltaV, DirectX::XMVECTOR _cameraPosition) const;
+	// sampled point around pixel location _i, _j. Tiles build theirs in
+	// batches instead; both give the same rays
+	Ray GetRay(unsigned int _i, unsigned int _j) const;
 	// Returns a 2D vector to a random point in X: [-0.5, +0.5], Y: [-0.5, +0.5] unit square
 	DirectX::XMFLOAT2 SampleSquare() const;
-	// Find the color returned by a given ray
-	DirectX::XMVECTOR RayColor(const Ray& _ray, int _depth, const Hittable& _world);
+	// Find the color returned by a given ray, following it for up to maxDepth
+	// bounces. _segmentCount is set to how many rays the path traced. If the
+	// ray's closest hit is already known, such as from a packet, pass it as
+	// _primaryHit; a null primitive means it hit nothing. A MAX_DEPTH other
+	// than 0 replaces maxDepth with a compile-time constant
+	template<int MAX_DEPTH = 0>
+	DirectX::XMVECTOR RayColor(const Ray& _ray, const Hittable& _world, const MaterialTable& _materials, int& _segmentCount, const RayHit* _primaryHit = nullptr) const;
+	// Color of the sky in the ray's direction
+	DirectX::XMVECTOR SkyColor(const Ray& _ray) const;
+	// Whether bounces sample lights directly
+	bool UsesLightSampling() const;
+	// Picks a point on a light and traces a shadow ray to it, returning the
+	// light that reaches _record's surface from there and leaves back along
+	// _rayIn, before the path's throughput. Sets _wasLightSampled to whether
+	// the surface's BSDF let the light be sampled at all
+	DirectX::XMVECTOR SampleLight(const Hittable& _world, const MaterialTable& _materials, const Ray& _rayIn, const HitRecord& _record, bool& _wasLightSampled) const;
+	// SampleLight, evaluating the BSDF with _evaluate(direction, value, pdf)
+	// so callers that know the material's type can call it directly
+	template<typename EVALUATE>
+	DirectX::XMVECTOR SampleLightWith(const Hittable& _world, const HitRecord& _record, const EVALUATE& _evaluate, bool& _wasLightSampled) const;
+	// How much of an emitter's light counts when the scattered ray _ray finds
+	// it, given how likely the bounce it left from, which had a scatter
+	// density of _scatterPdf and a normal of _originNormal, was to have found
+	// it by sampling lights too
+	float EmissionWeight(const Ray& _ray, const HitRecord& _record, float _scatterPdf, const DirectX::XMFLOAT3& _originNormal, bool _wasLightSampled) const;
+	// Multiple importance sampling weight, by the camera's heuristic, of a
+	// sample picked with density _pdf by one strategy and _otherPdf by the other
+	float MISWeight(float _pdf, float _otherPdf) const;
+	// Plays Russian roulette with a path after _bounce bounces, if enabled.
+	// Returns whether it survives; survivors' throughput is scaled up to match
+	bool SurvivesRoulette(int _bounce, DirectX::XMVECTOR& _throughput) const;
 	DirectX::XMFLOAT3 DefocusDiskSample(DirectX::XMVECTOR _center) const;
+
+	// Renders samples [_firstSample, _firstSample + _sampleCount) of every pixel in
+	// X: [_minX, _maxX), Y: [_minY, _maxY) to the texture. If _accumulate is set, the
+	// samples are added to the accumulation buffer and the running mean is shown.
+	// Safe to call from several threads at once, as long as tiles don't overlap
+	void RenderTile(const Hittable& _world, const MaterialTable& _materials, CPUTexture& _cpuTexture, unsigned int _minX, unsigned int _minY, unsigned int _maxX, unsigned int _maxY, int _firstSample, int _sampleCount, bool _accumulate) const;
+	// RenderTile's loop with the lens and projection fixed at compile time,
+	// and the max depth too, unless MAX_DEPTH is 0
+	template<bool HAS_DEFOCUS, bool IS_ORTHOGRAPHIC, int MAX_DEPTH>
+	void RenderTileKernel(const Hittable& _world, const MaterialTable& _materials, CPUTexture& _cpuTexture, unsigned int _minX, unsigned int _minY, unsigned int _maxX, unsigned int _maxY, int _firstSample, int _sampleCount, bool _accumulate) const;
+	// Renders a tile like RenderTileKernel, but with adaptive sampling. Without
+	// _accumulate, every pixel takes samples until it's done or the tile has
+	// used up its budget. With it, pixels the accumulation buffer says are done
+	// are skipped, and the rest take up to _sampleCount more samples
+	template<bool HAS_DEFOCUS, bool IS_ORTHOGRAPHIC, int MAX_DEPTH>
+	void RenderTileAdaptive(const Hittable& _world, const MaterialTable& _materials, CPUTexture& _cpuTexture, unsigned int _minX, unsigned int _minY, unsigned int _maxX, unsigned int _maxY, int _firstSample, int _sampleCount, bool _accumulate) const;
+	// Whether renders go through RenderTileAdaptive; packets and wavefronts don't
+	bool UsesAdaptiveSampling() const;
+	// Whether a pixel's samples so far are enough, and how far it is from
+	// done; over 1 means it needs more samples
+	bool IsPixelDone(const PixelVariance& _variance) const;
+	float PixelError(const PixelVariance& _variance) const;
+	// Picks the tile kernel matching the camera's current settings. Only max
+	// depths of 1, 10 and 50 get kernels of their own
+	void SelectTileKernel();
+	template<bool HAS_DEFOCUS, bool IS_ORTHOGRAPHIC>
+	TileKernel SelectTileKernelForDepth() const;
+	// Renders a tile like RenderTile, but traces each sample's camera rays in
+	// packetSize x packetSize packets. Paths carry on one ray at a time after
+	// the first hit, since scattered rays are no longer coherent
+	void RenderTilePackets(const Hittable& _world, const MaterialTable& _materials, CPUTexture& _cpuTexture, unsigned int _minX, unsigned int _minY, unsigned int _maxX, unsigned int _maxY, int _firstSample, int _sampleCount, bool _accumulate) const;
+	// Writes a pixel given the sum of _sampleCount new samples of it, either
+	// averaging them or adding them to the accumulation buffer's running mean
+	void StorePixel(CPUTexture& _cpuTexture, unsigned int _x, unsigned int _y, DirectX::XMVECTOR _colorSum, int _firstSample, int _sampleCount, bool _accumulate) const;
+	// Renders the same samples as RenderRows, but in wavefront mode. Each stage
+	// runs over a whole wave of paths on the thread pool before the next starts
+	void RenderRowsWavefront(const Hittable& _world, const MaterialTable& _materials, CPUTexture& _cpuTexture, unsigned int _minY, unsigned int _maxY, int _firstSample, int _sampleCount, bool _accumulate);
+	// Wavefront shade stage for _count paths, named by _ids, whose hits all
+	// use materials of type TYPE. Emission, light sampling and scattering
+	// call that type's code directly rather than switching per path
+	template<MaterialTable::MaterialType TYPE>
+	void ShadeWavefrontPaths(const Hittable& _world, const MaterialTable& _materials, const uint32_t* _ids, size_t _count, int _bounce, unsigned int _firstPixel, int _firstSample, int _sampleCount);
+	// Splits rows [_minY, _maxY) of the texture into tiles and renders them on the thread pool
+	void RenderRows(const Hittable& _world, const MaterialTable& _materials, CPUTexture& _cpuTexture, unsigned int _minY, unsigned int _maxY, int _firstSample, int _sampleCount, bool _accumulate);
 };
 
 
@@ -188,7 +441,7 @@ public:
 	bool Update(float dt);
 
 	// Image Rendering Functions
-	void Render(const Hittable& _world, std::shared_ptr<CPUTexture> _cpuTexture, float _deltaTime, float _totalTime);
+	void Render(const Hittable& _world, const MaterialTable& _materials, std::shared_ptr<CPUTexture> _cpuTexture, float _deltaTime, float _totalTime);
 private:
 	float movementSpeed;
 	float mouseLookSpeed;
@@ -0,0 +1,261 @@
+#include "CameraRays.h"
+
+#include <immintrin.h>
+#include "Random.h"
+#include "SampleWarps.h"
+
+namespace
+{
+	// Steps, in rays, that the batch's arrays are padded to
+	const size_t LANE_COUNT = 8;
+
+	// The frame's constants split by axis, so loops can run over the axes
+	struct AxisConstants {
+		float origin[3];
+		float upperLeftPixelCenter[3];
+		float pixelDeltaU[3];
+		float pixelDeltaV[3];
+		float defocusDiskU[3];
+		float defocusDiskV[3];
+		float orthographicDirection[3];
+
+		AxisConstants(const CameraRayConstants& _constants)
+		{
+			const DirectX::XMFLOAT3* sources[] = {
+				&_constants.origin, &_constants.upperLeftPixelCenter, &_constants.pixelDeltaU, &_constants.pixelDeltaV,
+				&_constants.defocusDiskU, &_constants.defocusDiskV, &_constants.orthographicDirection };
+			float* destinations[] = { origin, upperLeftPixelCenter, pixelDeltaU, pixelDeltaV, defocusDiskU, defocusDiskV, orthographicDirection };
+			for (int i = 0; i < 7; i++) {
+				destinations[i][0] = sources[i]->x;
+				destinations[i][1] = sources[i]->y;
+				destinations[i][2] = sources[i]->z;
+			}
+		}
+	};
+
+	// Builds one ray from its pixel and random numbers, exactly as the SIMD
+	// loop does. Used for builds without AVX2 and for the end of each row
+	template<bool HAS_DEFOCUS, bool IS_ORTHOGRAPHIC>
+	void GenerateRay(const AxisConstants& _constants, float _pixelX, float _pixelY, float _offsetU, float _offsetV, float _lensU, float _lensV, float _origin[3], float _direction[3])
+	{
+		float u = _offsetU + _pixelX;
+		float v = _offsetV + _pixelY;
+		for (int axis = 0; axis < 3; axis++) {
+			float pixelSample = (_constants.upperLeftPixelCenter[axis] + _constants.pixelDeltaU[axis] * u) + _constants.pixelDeltaV[axis] * v;
+
+			// Perspective rays fan out from the camera; orthographic ones all
+			// head forward, from the point behind their pixel on the camera's plane
+			float origin;
+			if constexpr (IS_ORTHOGRAPHIC) {
+				origin = pixelSample - _constants.orthographicDirection[axis];
+				_direction[axis] = _constants.orthographicDirection[axis];
+			}
+			else {
+				origin = _constants.origin[axis];
+				_direction[axis] = pixelSample - _constants.origin[axis];
+			}
+
+			if constexpr (HAS_DEFOCUS)
+				origin = (origin + _constants.defocusDiskU[axis] * _lensU) + _constants.defocusDiskV[axis] * _lensV;
+			_origin[axis] = origin;
+		}
+	}
+
+#if defined(__AVX2__)
+	// Counter-based draw number _draw under each lane's key, as Random::NextFloat()
+	// would return it after Random::BeginSample()
+	__m256 DrawLanes(__m256i _key, __m256i _draw)
+	{
+		__m256i bits = Random::HashLanes(_mm256_xor_si256(_key, _mm256_mullo_epi32(_draw, _mm256_set1_epi32((int)0x9e3779b9u))));
+		return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(bits, 8)), _mm256_set1_ps(1.0f / 16777216.0f));
+	}
+#endif
+}
+
+void CameraRayBatch::Generate(const CameraRayConstants& _constants, unsigned int _minX, unsigned int _minY, unsigned int _maxX, unsigned int _maxY, unsigned int _imageWidth, int _sample)
+{
+	if (_constants.hasDefocus) {
+		if (_constants.isOrthographic)
+			GenerateFor<true, true>(_constants, _minX, _minY, _maxX, _maxY, _imageWidth, _sample);
+		else
+			GenerateFor<true, false>(_constants, _minX, _minY, _maxX, _maxY, _imageWidth, _sample);
+	}
+	else {
+		if (_constants.isOrthographic)
+			GenerateFor<false, true>(_constants, _minX, _minY, _maxX, _maxY, _imageWidth, _sample);
+		else
+			GenerateFor<false, false>(_constants, _minX, _minY, _maxX, _maxY, _imageWidth, _sample);
+	}
+}
+
+template<bool HAS_DEFOCUS, bool IS_ORTHOGRAPHIC>
+void CameraRayBatch::GenerateFor(const CameraRayConstants& _frameConstants, unsigned int _minX, unsigned int _minY, unsigned int _maxX, unsigned int _maxY, unsigned int _imageWidth, int _sample)
+{
+	AxisConstants constants(_frameConstants);
+	unsigned int width = _maxX - _minX;
+	unsigned int height = _maxY - _minY;
+	count = (int)(width * height);
+
+	size_t paddedCount = (count + LANE_COUNT - 1) / LANE_COUNT * LANE_COUNT;
+	for (std::vector<float>* lanes : { &originX, &originY, &originZ, &directionX, &directionY, &directionZ, &offsetU, &offsetV, &lensU, &lensV }) {
+		lanes->resize(paddedCount);
+	}
+
+	SampleRandomNumbers<HAS_DEFOCUS>(_minX, _minY, width, _imageWidth, _sample);
+
+	float* origins[3] = { originX.data(), originY.data(), originZ.data() };
+	float* directions[3] = { directionX.data(), directionY.data(), directionZ.data() };
+
+#if defined(__AVX2__)
+	// Every ray shares the frame's constants, so splat them once up front.
+	// Multiplies and adds are kept apart, in the same order as GenerateRay,
+	// so both give identical rays
+	const __m256 laneIndices = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+	__m256 laneOrigin[3], laneUpperLeft[3], laneDeltaU[3], laneDeltaV[3], laneDiskU[3], laneDiskV[3], laneOrthographicDirection[3];
+	for (int axis = 0; axis < 3; axis++) {
+		laneOrigin[axis] = _mm256_set1_ps(constants.origin[axis]);
+		laneUpperLeft[axis] = _mm256_set1_ps(constants.upperLeftPixelCenter[axis]);
+		laneDeltaU[axis] = _mm256_set1_ps(constants.pixelDeltaU[axis]);
+		laneDeltaV[axis] = _mm256_set1_ps(constants.pixelDeltaV[axis]);
+		laneDiskU[axis] = _mm256_set1_ps(constants.defocusDiskU[axis]);
+		laneDiskV[axis] = _mm256_set1_ps(constants.defocusDiskV[axis]);
+		laneOrthographicDirection[axis] = _mm256_set1_ps(constants.orthographicDirection[axis]);
+	}
+#endif
+
+	for (unsigned int row = 0; row < height; row++) {
+		size_t rowStart = (size_t)row * width;
+		float pixelY = (float)(_minY + row);
+		unsigned int column = 0;
+
+#if defined(__AVX2__)
+		for (; column + LANE_COUNT <= width; column += LANE_COUNT) {
+			size_t i = rowStart + column;
+			__m256 pixelX = _mm256_add_ps(_mm256_set1_ps((float)(_minX + column)), laneIndices);
+			__m256 u = _mm256_add_ps(_mm256_loadu_ps(&offsetU[i]), pixelX);
+			__m256 v = _mm256_add_ps(_mm256_loadu_ps(&offsetV[i]), _mm256_set1_ps(pixelY));
+			__m256 diskU = _mm256_loadu_ps(&lensU[i]);
+			__m256 diskV = _mm256_loadu_ps(&lensV[i]);
+
+			for (int axis = 0; axis < 3; axis++) {
+				__m256 pixelSample = _mm256_add_ps(
+					_mm256_add_ps(laneUpperLeft[axis], _mm256_mul_ps(laneDeltaU[axis], u)),
+					_mm256_mul_ps(laneDeltaV[axis], v));
+
+				__m256 origin;
+				if constexpr (IS_ORTHOGRAPHIC) {
+					origin = _mm256_sub_ps(pixelSample, laneOrthographicDirection[axis]);
+					_mm256_storeu_ps(directions[axis] + i, laneOrthographicDirection[axis]);
+				}
+				else {
+					origin = laneOrigin[axis];
+					_mm256_storeu_ps(directions[axis] + i, _mm256_sub_ps(pixelSample, laneOrigin[axis]));
+				}
+
+				if constexpr (HAS_DEFOCUS) {
+					origin = _mm256_add_ps(
+						_mm256_add_ps(origin, _mm256_mul_ps(laneDiskU[axis], diskU)),
+						_mm256_mul_ps(laneDiskV[axis], diskV));
+				}
+				_mm256_storeu_ps(origins[axis] + i, origin);
+			}
+		}
+#endif
+
+		for (; column < width; column++) {
+			size_t i = rowStart + column;
+			float origin[3], direction[3];
+			GenerateRay<HAS_DEFOCUS, IS_ORTHOGRAPHIC>(constants, (float)(_minX + column), pixelY, offsetU[i], offsetV[i], lensU[i], lensV[i], origin, direction);
+			for (int axis = 0; axis < 3; axis++) {
+				origins[axis][i] = origin[axis];
+				directions[axis][i] = direction[axis];
+			}
+		}
+	}
+}
+
+int CameraRayBatch::GetCount() const
+{
+	return count;
+}
+
+Ray CameraRayBatch::GetRay(int _index) const
+{
+	Ray ray;
+	ray.Origin = DirectX::XMFLOAT3(originX[_index], originY[_index], originZ[_index]);
+	ray.Direction = DirectX::XMFLOAT3(directionX[_index], directionY[_index], directionZ[_index]);
+	return ray;
+}
+
+template<bool HAS_DEFOCUS>
+void CameraRayBatch::SampleRandomNumbers(unsigned int _minX, unsigned int _minY, unsigned int _width, unsigned int _imageWidth, int _sample)
+{
+	// Generators that run a stream can only be drawn from in order, and
+	// samplers' numbers aren't hashes that can be drawn 8 at a time
+	if (Random::Mode != RandomMode::CounterBased || Random::ActiveSampler) {
+		for (int i = 0; i < count; i++) {
+			Random::BeginSample((_minY + i / _width) * _imageWidth + _minX + i % _width, _sample);
+			offsetU[i] = RandomFloat() - 0.5f;
+			offsetV[i] = RandomFloat() - 0.5f;
+			if constexpr (HAS_DEFOCUS) {
+				DirectX::XMFLOAT2 lens = RandomInUnitDisk();
+				lensU[i] = lens.x;
+				lensV[i] = lens.y;
+			}
+		}
+		return;
+	}
+
+	// Counter-based numbers are just hashes of each ray's pixel, sample and
+	// draw number, so they can be drawn for 8 rays at a time
+	unsigned int height = (unsigned int)count / _width;
+	for (unsigned int row = 0; row < height; row++) {
+		size_t rowStart = (size_t)row * _width;
+		uint32_t rowPixel = (_minY + row) * _imageWidth + _minX;
+		unsigned int column = 0;
+
+#if defined(__AVX2__)
+		const __m256i laneIndices = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		const __m256 half = _mm256_set1_ps(0.5f);
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 two = _mm256_set1_ps(2.0f);
+		for (; column + LANE_COUNT <= _width; column += LANE_COUNT) {
+			size_t i = rowStart + column;
+			__m256i pixel = _mm256_add_epi32(_mm256_set1_epi32((int)(Random::Seed + rowPixel + column)), laneIndices);
+			__m256i key = Random::HashLanes(_mm256_add_epi32(Random::HashLanes(pixel), _mm256_set1_epi32(_sample)));
+
+			// Draws 0 and 1 offset the ray within its pixel
+			_mm256_storeu_ps(&offsetU[i], _mm256_sub_ps(DrawLanes(key, _mm256_setzero_si256()), half));
+			_mm256_storeu_ps(&offsetV[i], _mm256_sub_ps(DrawLanes(key, _mm256_set1_epi32(1)), half));
+
+			if constexpr (!HAS_DEFOCUS)
+				continue;
+
+			// Draws 2 and 3 pick the point on the lens, warped like RandomInUnitDisk()
+			__m256 u = _mm256_sub_ps(_mm256_mul_ps(two, DrawLanes(key, _mm256_set1_epi32(2))), one);
+			__m256 v = _mm256_sub_ps(_mm256_mul_ps(two, DrawLanes(key, _mm256_set1_epi32(3))), one);
+			__m256 diskU, diskV;
+			SampleWarps<8>::ConcentricDisk(u, v, diskU, diskV);
+			_mm256_storeu_ps(&lensU[i], diskU);
+			_mm256_storeu_ps(&lensV[i], diskV);
+		}
+#endif
+
+		for (; column < _width; column++) {
+			size_t i = rowStart + column;
+			Random::BeginSample(rowPixel + column, _sample);
+			offsetU[i] = RandomFloat() - 0.5f;
+			offsetV[i] = RandomFloat() - 0.5f;
+			if constexpr (HAS_DEFOCUS) {
+				DirectX::XMFLOAT2 lens = RandomInUnitDisk();
+				lensU[i] = lens.x;
+				lensV[i] = lens.y;
+			}
+		}
+	}
+}
+
+template void CameraRayBatch::GenerateFor<false, false>(const CameraRayConstants&, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, int);
+template void CameraRayBatch::GenerateFor<false, true>(const CameraRayConstants&, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, int);
+template void CameraRayBatch::GenerateFor<true, false>(const CameraRayConstants&, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, int);
+template void CameraRayBatch::GenerateFor<true, true>(const CameraRayConstants&, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, int);
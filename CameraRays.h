@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include "Helpers.h"
+
+// Everything camera rays are built from that stays the same for a whole
+// frame, gathered once before rendering so no ray has to reload it
+struct CameraRayConstants {
+	DirectX::XMFLOAT3 origin;
+	// Center of the upper-left pixel, and the step to the next pixel right and down
+	DirectX::XMFLOAT3 upperLeftPixelCenter;
+	DirectX::XMFLOAT3 pixelDeltaU;
+	DirectX::XMFLOAT3 pixelDeltaV;
+	// Defocus disk radius along the camera's right and up vectors
+	DirectX::XMFLOAT3 defocusDiskU;
+	DirectX::XMFLOAT3 defocusDiskV;
+	// Whether rays start on the defocus disk rather than at the origin
+	bool hasDefocus;
+	// Whether rays all head along orthographicDirection, the camera's
+	// forward vector scaled to the focus distance, rather than fanning out
+	bool isOrthographic;
+	DirectX::XMFLOAT3 orthographicDirection;
+};
+
+// One sample's camera rays for a rectangle of pixels, such as a tile,
+// generated together. Rays are stored structure-of-arrays, and built with
+// AVX2 8 at a time. Ray i belongs to pixel (minX + i % width, minY + i / width)
+class CameraRayBatch
+{
+public:
+	// Generates the rays through X: [_minX, _maxX), Y: [_minY, _maxY) of an
+	// image _imageWidth pixels wide, for sample _sample of each pixel. Random
+	// numbers are drawn exactly as Random::BeginSample and two draws for the
+	// pixel offset, then two for the lens, would draw them one ray at a time
+	void Generate(const CameraRayConstants& _constants, unsigned int _minX, unsigned int _minY, unsigned int _maxX, unsigned int _maxY, unsigned int _imageWidth, int _sample);
+	// Generate() with the camera's features fixed at compile time, so no
+	// per-ray work depends on them. They must match _constants
+	template<bool HAS_DEFOCUS, bool IS_ORTHOGRAPHIC>
+	void GenerateFor(const CameraRayConstants& _constants, unsigned int _minX, unsigned int _minY, unsigned int _maxX, unsigned int _maxY, unsigned int _imageWidth, int _sample);
+
+	int GetCount() const;
+	Ray GetRay(int _index) const;
+
+private:
+	int count = 0;
+	// One entry per ray, padded to a whole number of SIMD steps
+	std::vector<float> originX, originY, originZ;
+	std::vector<float> directionX, directionY, directionZ;
+	// Random offsets within each ray's pixel, and points on the unit disk
+	std::vector<float> offsetU, offsetV;
+	std::vector<float> lensU, lensV;
+
+	// Draws every ray's pixel offset and lens sample
+	template<bool HAS_DEFOCUS>
+	void SampleRandomNumbers(unsigned int _minX, unsigned int _minY, unsigned int _width, unsigned int _imageWidth, int _sample);
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+// How the innermost loops call into primitives and materials
+enum class DispatchMode
+{
+	// Through the virtual Hittable and Material interfaces, one object at a time
+	Virtual,
+	// Through per-type arrays of the built-in types, switching on a type tag.
+	// Every call is direct, so the compiler can inline the sphere test and
+	// each scatter. Anything outside the closed set still goes through the
+	// virtual interface
+	ClosedSet
+};
+
+namespace Dispatch
+{
+	// Only change this while no render is in progress
+	inline DispatchMode Mode = DispatchMode::ClosedSet;
+}
@@ -1,4 +1,5 @@
 #include "Game.h"
+#include "Benchmark.h"
 #include "Graphics.h"
 #include "Input.h"
 #include "PathHelpers.h"
@@ -55,6 +56,17 @@ void Game::Initialize()
 	camera->SetSamplesPerPixel(100);
 	camera->SetMaxDepth(10);
 
+	// Render tiles on one thread per hardware core
+	camera->SetThreadCount(std::thread::hardware_concurrency());
+	camera->SetTileSize(16);
+
+	// While still, add a few samples to the whole image each frame
+	camera->SetProgressive(true);
+	camera->SetProgressiveSamplesPerFrame(4);
+
+	// Stop sampling pixels once they've converged, and spend the rest on noisy ones
+	camera->SetAdaptiveSampling(true);
+
 	camera->SetDefocusAngle(0.6f);
 	camera->SetFocusDist(10.0f);
 
@@ -111,8 +123,13 @@ void Game::OnResize()
 
 void Game::InitializeWorld()
 {
-	auto matGround = make_shared<Lambertian>(XMFLOAT3(0.5f, 0.5f, 0.5f));
-	world.Add(make_shared<Sphere>(XMFLOAT3(0.0f, -1000.0f, 0.0f), 1000.0f, matGround));
+	// Start from an empty scene. Each build rolls a new layout
+	scene = std::make_shared<Scene>(camera->GetThreadPool());
+	animatedSpheres.clear();
+	animatedSphereRestOrigins.clear();
+
+	MaterialIndex matGround = scene->AddMaterial(make_shared<Lambertian>(XMFLOAT3(0.5f, 0.5f, 0.5f)));
+	scene->Add(make_shared<Sphere>(XMFLOAT3(0.0f, -1000.0f, 0.0f), 1000.0f, matGround));
 
 	XMFLOAT3 emptyPoint(4.0f, 0.2f, 0.0f);
 
@@ -124,40 +141,113 @@ void Game::InitializeWorld()
 			float sqLength;
 			XMStoreFloat(&sqLength, XMVector3LengthSq(XMLoadFloat3(&center) - XMLoadFloat3(&emptyPoint)));
 			if (sqLength > 0.81f) {
-				shared_ptr<Material> sphereMaterial;
-
-				if (chooseMat < 0.8f) {
+				MaterialIndex sphereMaterial;
+
+				if (hasGlowingSpheres && chooseMat < 0.2f) {
+					// Light
+					XMFLOAT3 emit;
+					XMStoreFloat3(&emit, XMVectorScale(RandomVector(0.5f, 1.0f), GLOWING_SPHERE_BRIGHTNESS));
+					sphereMaterial = scene->AddMaterial(make_shared<DiffuseLight>(emit));
+					scene->Add(make_shared<Sphere>(center, 0.2f, sphereMaterial));
+				}
+				else if (chooseMat < 0.8f) {
 					// Diffuse
 					XMFLOAT3 albedo;
 					XMStoreFloat3(&albedo, RandomVector() * RandomVector());
-					sphereMaterial = make_shared<Lambertian>(albedo);
-					world.Add(make_shared<Sphere>(center, 0.2f, sphereMaterial));
+					sphereMaterial = scene->AddMaterial(make_shared<Lambertian>(albedo));
+					auto sphere = make_shared<Sphere>(center, 0.2f, sphereMaterial);
+					scene->Add(sphere);
+
+					// Diffuse spheres bounce when animation is on
+					animatedSpheres.push_back(sphere);
+					animatedSphereRestOrigins.push_back(center);
 				}
 				else if (chooseMat < 0.95f) {
 					// Metal
 					XMFLOAT3 albedo;
 					XMStoreFloat3(&albedo, RandomVector(0.5, 1.0f));
 					float fuzz = RandomFloat(0.0f, 0.5f);
-					sphereMaterial = make_shared<Metal>(albedo, fuzz);
-					world.Add(make_shared<Sphere>(center, 0.2f, sphereMaterial));
+					sphereMaterial = scene->AddMaterial(make_shared<Metal>(albedo, fuzz));
+					scene->Add(make_shared<Sphere>(center, 0.2f, sphereMaterial));
 				}
 				else {
 					// Glass
-					sphereMaterial = make_shared<Dielectric>(1.5f);
-					world.Add(make_shared<Sphere>(center, 0.2f, sphereMaterial));
+					sphereMaterial = scene->AddMaterial(make_shared<Dielectric>(1.5f));
+					scene->Add(make_shared<Sphere>(center, 0.2f, sphereMaterial));
 				}
 			}
 		}
 	}
 
-	auto material1 = make_shared<Dielectric>(1.5f);
-	world.Add(make_shared<Sphere>(XMFLOAT3(0.0f, 1.0f, 0.0f), 1.0f, material1));
+	MaterialIndex material1 = scene->AddMaterial(make_shared<Dielectric>(1.5f));
+	scene->Add(make_shared<Sphere>(XMFLOAT3(0.0f, 1.0f, 0.0f), 1.0f, material1));
+
+	MaterialIndex material2 = scene->AddMaterial(make_shared<Lambertian>(XMFLOAT3(0.4f, 0.2f, 0.1f)));
+	scene->Add(make_shared<Sphere>(XMFLOAT3(-4.0f, 1.0f, 0.0f), 1.0f, material2));
 
-	auto material2 = make_shared<Lambertian>(XMFLOAT3(0.4f, 0.2f, 0.1f));
-	world.Add(make_shared<Sphere>(XMFLOAT3(-4.0f, 1.0f, 0.0f), 1.0f, material2));
+	MaterialIndex material3 = scene->AddMaterial(make_shared<Metal>(XMFLOAT3(0.7f, 0.6f, 0.5f), 0.0f));
+	scene->Add(make_shared<Sphere>(XMFLOAT3(4.0f, 1.0f, 0.0f), 1.0f, material3));
+
+	scene->SetAccelerator(SceneAccelerator::BVH);
+	PrintSceneStats();
+
+	// Glowing spheres light the scene at night
+	camera->SetLights(scene->GetLights());
+	camera->SetSkyBrightness(hasGlowingSpheres ? NIGHT_SKY_BRIGHTNESS : 1.0f);
+}
+
+// --------------------------------------------------------
+// Prints the work-stealing counters for each render thread
+// since they were last reset, then resets them
+// --------------------------------------------------------
+void Game::PrintSchedulerStats()
+{
+	shared_ptr<ThreadPool> threadPool = camera->GetThreadPool();
+
+	printf("\n--- Render Scheduler ---\n");
+	for (unsigned int i = 0; i < threadPool->GetThreadCount(); i++) {
+		ThreadPoolStats stats = threadPool->GetWorkerStats(i);
+		printf("Thread %2u: %8llu tiles, %6llu steals, %6llu idle\n", i, stats.tasksRun, stats.steals, stats.idleWaits);
+	}
+
+	ThreadPoolStats total = threadPool->GetStats();
+	printf("Total:     %8llu tiles, %6llu steals, %6llu idle\n", total.tasksRun, total.steals, total.idleWaits);
+
+	threadPool->ResetStats();
+}
+
+// --------------------------------------------------------
+// Prints which structure rays are traced against, and
+// what the scene did the last time it was updated
+// --------------------------------------------------------
+void Game::PrintSceneStats()
+{
+	const char* acceleratorNames[] = { "HittableList", "BVH", "BVH4", "BVH8", "LBVH" };
+	const SceneUpdateStats& stats = scene->GetLastUpdateStats();
+
+	printf("Scene accelerator: %s%s, %s in %.3f ms, SAH cost %.2f (%.2f when built)\n",
+		acceleratorNames[(int)scene->GetAccelerator()],
+		scene->GetSphereBatching() ? " (sphere batches)" : "",
+		stats.wasRebuilt ? "built" : stats.wasRefit ? "refit" : "unchanged",
+		stats.seconds * 1000.0,
+		stats.sahCost,
+		stats.builtSAHCost);
+}
+
+// --------------------------------------------------------
+// Moves each animated sphere up and down on its own
+// bounce, then marks the scene as needing an update
+// --------------------------------------------------------
+void Game::AnimateSpheres(float _totalTime)
+{
+	for (size_t i = 0; i < animatedSpheres.size(); i++) {
+		XMFLOAT3 origin = animatedSphereRestOrigins[i];
+		origin.y += 0.5f * std::fabs(std::sin(3.0f * _totalTime + (float)i));
+		animatedSpheres[i]->SetOrigin(origin);
+	}
 
-	auto material3 = make_shared<Metal>(XMFLOAT3(0.7f, 0.6f, 0.5f), 0.0f);
-	world.Add(make_shared<Sphere>(XMFLOAT3(4.0f, 1.0f, 0.0f), 1.0f, material3));
+	scene->MarkObjectsMoved();
+	camera->ResetAccumulation();
 }
 
 // --------------------------------------------------------
@@ -169,7 +259,130 @@ void Game::Update(float deltaTime, float totalTime)
 	if (Input::KeyDown(VK_ESCAPE))
 		Window::Quit();
 
-	camera->Render(world, cpuTexture, deltaTime, totalTime);
+	// Print and reset the render scheduler's counters
+	if (Input::KeyPress('T'))
+		PrintSchedulerStats();
+
+	// Run the benchmarks and print their results
+	if (Input::KeyPress('B')) {
+		Benchmark::RunRandomBenchmark();
+		Benchmark::RunWarpBenchmark();
+		Benchmark::RunReproducibilityCheck(*camera, scene->GetHittable(), scene->GetMaterials());
+		Benchmark::RunRenderBenchmark(*camera, scene->GetHittable(), scene->GetMaterials());
+		Benchmark::RunPathLengthBenchmark(*camera, scene->GetHittable(), scene->GetMaterials());
+		Benchmark::RunWavefrontBenchmark(*camera, scene->GetHittable(), scene->GetMaterials());
+		Benchmark::RunPacketBenchmark(*camera, scene->GetHittable(), scene->GetMaterials());
+		Benchmark::RunAdaptiveSamplingBenchmark(*camera, scene->GetHittable(), scene->GetMaterials());
+		Benchmark::RunSamplerBenchmark(*camera, scene->GetHittable(), scene->GetMaterials());
+		Benchmark::RunLightSamplingBenchmark(*camera, scene->GetHittable(), scene->GetMaterials());
+		Benchmark::RunBVHBenchmark();
+		Benchmark::RunOcclusionBenchmark();
+		Benchmark::RunBVHBuildBenchmark();
+		Benchmark::RunRefitBenchmark();
+		Benchmark::RunLightBVHBenchmark();
+	}
+
+	// Switch between the daytime scene and the night-time one lit by glowing spheres
+	if (Input::KeyPress('G')) {
+		hasGlowingSpheres = !hasGlowingSpheres;
+		InitializeWorld();
+		printf("Glowing spheres: %s, %zu lights\n", hasGlowingSpheres ? "on" : "off", scene->GetLights()->GetCount());
+	}
+
+	// Cycle how light from glowing spheres is found
+	if (Input::KeyPress('L')) {
+		LightSampling lightSampling = camera->GetLightSampling();
+		switch (lightSampling) {
+		case LightSampling::Off: lightSampling = LightSampling::LightsOnly; break;
+		case LightSampling::LightsOnly: lightSampling = LightSampling::BalanceHeuristic; break;
+		case LightSampling::BalanceHeuristic: lightSampling = LightSampling::PowerHeuristic; break;
+		default: lightSampling = LightSampling::Off; break;
+		}
+		camera->SetLightSampling(lightSampling);
+
+		const char* lightSamplingNames[] = { "off", "lights only", "MIS (balance heuristic)", "MIS (power heuristic)" };
+		printf("Light sampling: %s\n", lightSamplingNames[(int)lightSampling]);
+	}
+
+	// Switch between picking lights uniformly and through the light BVH
+	if (Input::KeyPress('J')) {
+		LightSelection lightSelection = camera->GetLightSelection() == LightSelection::BVH ? LightSelection::Uniform : LightSelection::BVH;
+		camera->SetLightSelection(lightSelection);
+		printf("Light selection: %s\n", lightSelection == LightSelection::BVH ? "light BVH" : "uniform");
+	}
+
+	// Switch what rays are traced against. The scene itself doesn't
+	// change, so progressive renders carry on accumulating
+	SceneAccelerator previousAccelerator = scene->GetAccelerator();
+	SceneAccelerator accelerator = previousAccelerator;
+	if (Input::KeyPress('1')) accelerator = SceneAccelerator::List;
+	if (Input::KeyPress('2')) accelerator = SceneAccelerator::BVH;
+	if (Input::KeyPress('3')) accelerator = SceneAccelerator::BVH4;
+	if (Input::KeyPress('4')) accelerator = SceneAccelerator::BVH8;
+	if (Input::KeyPress('5')) accelerator = SceneAccelerator::LBVH;
+	if (accelerator != previousAccelerator) {
+		scene->SetAccelerator(accelerator);
+		PrintSceneStats();
+	}
+
+	// Switch between following paths one at a time and in wavefront batches
+	if (Input::KeyPress('P')) {
+		bool isWavefront = camera->GetRenderMode() == RenderMode::Wavefront;
+		camera->SetRenderMode(isWavefront ? RenderMode::Megakernel : RenderMode::Wavefront);
+		printf("Render mode: %s\n", isWavefront ? "megakernel" : "wavefront");
+	}
+
+	// Cycle camera ray packets between off, 4x4 and 8x8
+	if (Input::KeyPress('K')) {
+		unsigned int packetSize = camera->GetPacketSize();
+		camera->SetPacketSize(packetSize == 1 ? 4 : packetSize == 4 ? 8 : 1);
+		printf("Camera ray packets: %ux%u\n", camera->GetPacketSize(), camera->GetPacketSize());
+	}
+
+	// Cycle where sample numbers come from
+	if (Input::KeyPress('N')) {
+		SamplerType samplerType = camera->GetSamplerType();
+		switch (samplerType) {
+		case SamplerType::Independent: samplerType = SamplerType::Sobol; break;
+		case SamplerType::Sobol: samplerType = SamplerType::Halton; break;
+		case SamplerType::Halton: samplerType = SamplerType::BlueNoise; break;
+		default: samplerType = SamplerType::Independent; break;
+		}
+		camera->SetSamplerType(samplerType);
+
+		const char* samplerNames[] = { "independent", "Sobol", "Halton", "blue noise" };
+		printf("Sampler: %s\n", samplerNames[(int)samplerType]);
+	}
+
+	// Toggle adaptive sampling, and showing how many samples each pixel took
+	if (Input::KeyPress('V')) {
+		camera->SetAdaptiveSampling(!camera->GetAdaptiveSampling());
+		printf("Adaptive sampling: %s\n", camera->GetAdaptiveSampling() ? "on" : "off");
+	}
+	if (Input::KeyPress('H')) {
+		camera->SetShowSampleCounts(!camera->GetShowSampleCounts());
+		camera->ResetAccumulation();
+	}
+
+	// Toggle packing spheres into SIMD batches
+	if (Input::KeyPress('C')) {
+		scene->SetSphereBatching(!scene->GetSphereBatching());
+		PrintSceneStats();
+	}
+
+	// Toggle bouncing spheres, and print how the scene is keeping up with them
+	if (Input::KeyPress('M'))
+		isAnimating = !isAnimating;
+	if (Input::KeyPress('U'))
+		PrintSceneStats();
+
+	if (isAnimating)
+		AnimateSpheres(totalTime);
+
+	// Refit or rebuild the accelerator before any rays are traced against it
+	scene->Update();
+
+	camera->Render(scene->GetHittable(), scene->GetMaterials(), cpuTexture, deltaTime, totalTime);
 }
 
 
@@ -10,6 +10,7 @@
 #include "RayTracingStructs.h"
 #include "Sphere.h"
 #include "HittableList.h"
+#include "Scene.h"
 
 class Game
 {
@@ -34,13 +35,24 @@ private:
 	const float STATIC_TEXTURE_SCALE = 0.5f;
 	const float MOVING_TEXTURE_SCALE = 0.05f;
 
+	// Light given off by glowing spheres, and how bright the sky is while they're out
+	const float GLOWING_SPHERE_BRIGHTNESS = 4.0f;
+	const float NIGHT_SKY_BRIGHTNESS = 0.02f;
+
 	// --- VARIABLES ---
 
 	std::shared_ptr<FPSCamera> camera;
 	std::shared_ptr<CPUTexture> cpuTexture;
 
 	// Scene Variables
-	HittableList world;
+	std::shared_ptr<Scene> scene;
+
+	// Small spheres that bounce while animation is on, and where each rests
+	std::vector<std::shared_ptr<Sphere>> animatedSpheres;
+	std::vector<DirectX::XMFLOAT3> animatedSphereRestOrigins;
+	bool isAnimating = false;
+	// Whether some small spheres glow, lighting the scene under a dark sky
+	bool hasGlowingSpheres = false;
 
 
 
@@ -61,6 +73,19 @@ private:
 
 	// Initialization helper functions
 
+	// Builds a new scene of random small spheres around three big ones
 	void InitializeWorld();
+
+	// Update helper functions
+
+	// Bounces the animated spheres and tells the scene they moved
+	void AnimateSpheres(float _totalTime);
+
+	// Debug helper functions
+
+	// Prints how render tiles were spread across worker threads
+	void PrintSchedulerStats();
+	// Prints which accelerator the scene is using and how it was last updated
+	void PrintSceneStats();
 };
 
@@ -5,6 +5,7 @@
 #include <limits>
 #include <memory>
 
+#include "Random.h"
 
 
 // C++ Std Usings
@@ -23,8 +24,8 @@ inline float DegreesToRadians(float degrees) {
 }
 
 inline float RandomFloat() {
-	// Returns a random real in [0,1).
-	return std::rand() / (RAND_MAX + 1.0f);
+	// Returns a random real in [0,1) from the calling thread's generator.
+	return Random::NextFloat();
 }
 
 inline float RandomFloat(float _min, float _max) {
@@ -12,3 +12,28 @@ void HitRecord::SetFaceNormal(const DirectX::XMVECTOR& _rayDirection, const Dire
 	isFrontFace = dotRayNormal < 0;
 	XMStoreFloat3(&normal, isFrontFace ? _outwardNormal : -_outwardNormal);
 }
+
+bool Hittable::Hit(const Ray& _ray, Interval _rayT, HitRecord& _record) const
+{
+	RayHit hit;
+	if (!Intersect(_ray, _rayT, hit))
+		return false;
+
+	hit.primitive->GetSurfaceInteraction(_ray, hit, _record);
+	_record.primitive = hit.primitive;
+	return true;
+}
+
+bool Hittable::Occluded(const Ray& _ray, Interval _rayT) const
+{
+	RayHit hit;
+	return Intersect(_ray, _rayT, hit);
+}
+
+void Hittable::IntersectPacket(const RayPacket& _packet, Interval _rayT, RayHit* _hits) const
+{
+	for (int i = 0; i < _packet.count; i++) {
+		if (!Intersect(_packet.rays[i], _rayT, _hits[i]))
+			_hits[i].primitive = nullptr;
+	}
+}
@@ -1,23 +1,58 @@
 #pragma once
+#include <cstdint>
 #include "Helpers.h"
+#include "AABB.h"
+#include "RayPacket.h"
 
-class Material;
+class Hittable;
+
+// Which entry of the scene's MaterialTable a surface uses
+using MaterialIndex = uint32_t;
 
 class HitRecord {
 public:
 	DirectX::XMFLOAT3 point;
 	DirectX::XMFLOAT3 normal;
-	shared_ptr<Material> material;
+	MaterialIndex material;
+	// The primitive that was hit, so lights can recognize themselves
+	const Hittable* primitive;
 	float t;
 	bool isFrontFace;
 
 	void SetFaceNormal(const DirectX::XMVECTOR& _rayDirection, const DirectX::XMVECTOR& _outwardNormal);
 };
 
+// The closest hit found by an intersection query: just how far along the
+// ray it is and which primitive was hit. Queries keep only this while they
+// search, so the full HitRecord is worked out once, for the final hit
+struct RayHit {
+	float t;
+	const Hittable* primitive;
+};
+
 class Hittable
 {
 public:
 	virtual ~Hittable() = default;
-	virtual bool Hit(const Ray& _ray, Interval _rayT, HitRecord& _record) const = 0;
+
+	// Finds the closest hit within _rayT and fills in _record for it,
+	// by running Intersect and then evaluating the surface that was hit
+	bool Hit(const Ray& _ray, Interval _rayT, HitRecord& _record) const;
+
+	// Finds the closest hit within _rayT, recording only its distance and primitive
+	virtual bool Intersect(const Ray& _ray, Interval _rayT, RayHit& _hit) const = 0;
+	// Finds the closest hit within _rayT for every ray in a prepared packet.
+	// Rays that hit nothing get a null primitive. By default each ray is
+	// traced alone; structures that can share work across rays override this
+	virtual void IntersectPacket(const RayPacket& _packet, Interval _rayT, RayHit* _hits) const;
+	// Whether anything is hit within _rayT, for shadow and visibility rays.
+	// Any hit will do, so overrides stop at the first one they find rather
+	// than searching for the closest. By default this runs Intersect
+	virtual bool Occluded(const Ray& _ray, Interval _rayT) const;
+	// Fills in _record for a hit Intersect found on this object. Only
+	// primitives are ever recorded as hit, so collections needn't override this
+	virtual void GetSurfaceInteraction(const Ray& _ray, const RayHit& _hit, HitRecord& _record) const {}
+
+	virtual AABB BoundingBox() const = 0;
 };
 
@@ -8,26 +8,37 @@ HittableList::HittableList(std::shared_ptr<Hittable> _object)
 void HittableList::Clear()
 {
 	objects.clear();
+	boundingBox = AABB();
 }
 
 void HittableList::Add(std::shared_ptr<Hittable> _object)
 {
 	objects.push_back(_object);
+	boundingBox = AABB(boundingBox, _object->BoundingBox());
 }
 
-bool HittableList::Hit(const Ray& _ray, Interval _rayT, HitRecord& _record) const
+bool HittableList::Intersect(const Ray& _ray, Interval _rayT, RayHit& _hit) const
 {
-	HitRecord temporaryRecord;
 	bool hasHitAnything = false;
 	float closestSoFar = _rayT.maximum;
 
+	// Each closer hit overwrites the last, which only costs a float and a pointer
 	for (const auto& object : objects) {
-		if (object->Hit(_ray, Interval(_rayT.minimum, closestSoFar), temporaryRecord)) {
+		if (object->Intersect(_ray, Interval(_rayT.minimum, closestSoFar), _hit)) {
 			hasHitAnything = true;
-			closestSoFar = temporaryRecord.t;
-			_record = temporaryRecord;
+			closestSoFar = _hit.t;
 		}
 	}
 
 	return hasHitAnything;
 }
+
+bool HittableList::Occluded(const Ray& _ray, Interval _rayT) const
+{
+	for (const auto& object : objects) {
+		if (object->Occluded(_ray, _rayT))
+			return true;
+	}
+
+	return false;
+}
@@ -15,6 +15,11 @@ public:
 
     void Clear();
     void Add(shared_ptr<Hittable> _object);
-    bool Hit(const Ray& _ray, Interval _rayT, HitRecord& _record) const override;
+    bool Intersect(const Ray& _ray, Interval _rayT, RayHit& _hit) const override;
+    bool Occluded(const Ray& _ray, Interval _rayT) const override;
+    AABB BoundingBox() const override { return boundingBox; }
+
+private:
+    AABB boundingBox;
 };
 
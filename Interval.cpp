@@ -22,5 +22,10 @@ float Interval::Clamp(float _x) const
     return _x;
 }
 
+float Interval::Center() const
+{
+    return 0.5f * (minimum + maximum);
+}
+
 const Interval Interval::Empty      = Interval(+infinity, -infinity);
 const Interval Interval::Universe   = Interval(-infinity, +infinity);
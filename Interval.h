@@ -8,11 +8,16 @@ public:
 
 	Interval() : minimum(+infinity), maximum(-infinity) {} // Default interval is empty
 	Interval(float _minimum, float _maximum) : minimum(_minimum), maximum(_maximum) {}
+	// Creates the tightest interval enclosing both intervals
+	Interval(const Interval& _a, const Interval& _b) :
+		minimum(_a.minimum <= _b.minimum ? _a.minimum : _b.minimum),
+		maximum(_a.maximum >= _b.maximum ? _a.maximum : _b.maximum) {}
 
 	float Size() const;
 	bool Contains(float _x) const;
 	bool Surrounds(float _x) const;
 	float Clamp(float _x) const;
+	float Center() const;
 
 	static const Interval Empty, Universe;
 };
@@ -0,0 +1,531 @@
+#include "LBVHBuilder.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+
+using namespace DirectX;
+
+namespace
+{
+	// Returns seconds elapsed since _start, and moves _start up to now
+	double Lap(std::chrono::high_resolution_clock::time_point& _start)
+	{
+		auto now = std::chrono::high_resolution_clock::now();
+		double seconds = std::chrono::duration<double>(now - _start).count();
+		_start = now;
+		return seconds;
+	}
+
+	// Spreads the low 10 bits of _value out so two zeros follow each one
+	uint32_t ExpandBits(uint32_t _value)
+	{
+		_value = (_value * 0x00010001u) & 0xFF0000FFu;
+		_value = (_value * 0x00000101u) & 0x0F00F00Fu;
+		_value = (_value * 0x00000011u) & 0xC30C30C3u;
+		_value = (_value * 0x00000005u) & 0x49249249u;
+		return _value;
+	}
+
+	// Maps a point in [0, 1] on each axis to its place along a 30-bit Morton curve
+	uint32_t MortonCode(float _x, float _y, float _z, float _scale)
+	{
+		uint32_t x = (uint32_t)std::clamp(_x * _scale, 0.0f, _scale);
+		uint32_t y = (uint32_t)std::clamp(_y * _scale, 0.0f, _scale);
+		uint32_t z = (uint32_t)std::clamp(_z * _scale, 0.0f, _scale);
+		return (ExpandBits(x) << 2) | (ExpandBits(y) << 1) | ExpandBits(z);
+	}
+
+	// Gets one component of a point by axis index
+	float AxisComponent(const XMFLOAT3& _point, int _axis)
+	{
+		if (_axis == 1) return _point.y;
+		if (_axis == 2) return _point.z;
+		return _point.x;
+	}
+}
+
+LBVHBuilder::LBVHBuilder(std::shared_ptr<ThreadPool> _threadPool) :
+	threadPool(_threadPool),
+	optimizeTreelets(true),
+	leafStart(0),
+	maxDepth(0)
+{
+}
+
+bool LBVHBuilder::GetTreeletOptimization() const { return optimizeTreelets; }
+void LBVHBuilder::SetTreeletOptimization(bool _optimizeTreelets) { optimizeTreelets = _optimizeTreelets; }
+
+const LBVHBuildTimes& LBVHBuilder::GetLastBuildTimes() const { return lastBuildTimes; }
+
+std::shared_ptr<BVH> LBVHBuilder::Build(const HittableList& _list)
+{
+	auto buildStart = std::chrono::high_resolution_clock::now();
+	auto stageStart = buildStart;
+	lastBuildTimes = LBVHBuildTimes();
+
+	uint32_t primitiveCount = (uint32_t)_list.objects.size();
+	if (primitiveCount == 0)
+		return std::make_shared<BVH>(_list);
+
+	// Gather each primitive's bounds, and bound their centroids chunk by chunk
+	std::vector<AABB> primitiveBounds(primitiveCount);
+	AABB centroidBounds;
+	std::mutex centroidBoundsMutex;
+	threadPool->ParallelFor(primitiveCount, [&](size_t _begin, size_t _end) {
+		AABB chunkCentroidBounds;
+		for (size_t i = _begin; i < _end; i++) {
+			primitiveBounds[i] = _list.objects[i]->BoundingBox();
+			XMFLOAT3 centroid = primitiveBounds[i].Centroid();
+			chunkCentroidBounds = AABB(chunkCentroidBounds, AABB(centroid, centroid));
+		}
+
+		std::lock_guard<std::mutex> lock(centroidBoundsMutex);
+		centroidBounds = AABB(centroidBounds, chunkCentroidBounds);
+	});
+
+	// Place each centroid along a Morton curve through the centroids' bounds
+	mortonPrimitives.resize(primitiveCount);
+	threadPool->ParallelFor(primitiveCount, [&](size_t _begin, size_t _end) {
+		float scale = (float)((1 << MORTON_BITS_PER_AXIS) - 1);
+		for (size_t i = _begin; i < _end; i++) {
+			XMFLOAT3 centroid = primitiveBounds[i].Centroid();
+			float normalized[3];
+			for (int axis = 0; axis < 3; axis++) {
+				const Interval& axisBounds = centroidBounds.AxisInterval(axis);
+				float size = axisBounds.Size();
+				normalized[axis] = size > 0.0f ? (AxisComponent(centroid, axis) - axisBounds.minimum) / size : 0.0f;
+			}
+
+			mortonPrimitives[i].code = MortonCode(normalized[0], normalized[1], normalized[2], scale);
+			mortonPrimitives[i].index = (uint32_t)i;
+		}
+	});
+	lastBuildTimes.mortonSeconds = Lap(stageStart);
+
+	RadixSort();
+	lastBuildTimes.sortSeconds = Lap(stageStart);
+
+	// n - 1 internal nodes, then n leaves
+	leafStart = primitiveCount - 1;
+	buildNodes.assign(2 * primitiveCount - 1, BuildNode());
+	buildNodes[0].parent = UINT32_MAX;
+
+	threadPool->ParallelFor(primitiveCount - 1, [&](size_t _begin, size_t _end) {
+		for (size_t i = _begin; i < _end; i++) {
+			BuildInternalNode((uint32_t)i);
+		}
+	});
+	lastBuildTimes.hierarchySeconds = Lap(stageStart);
+
+	// Fill in leaves and walk up from each of them. The second walk to reach
+	// a node finishes it, so each node is finished after both its children
+	std::unique_ptr<std::atomic<uint32_t>[]> visitCounts(new std::atomic<uint32_t>[primitiveCount]);
+	threadPool->ParallelFor(primitiveCount, [&](size_t _begin, size_t _end) {
+		for (size_t i = _begin; i < _end; i++) {
+			visitCounts[i].store(0, std::memory_order_relaxed);
+		}
+	});
+	threadPool->ParallelFor(primitiveCount, [&](size_t _begin, size_t _end) {
+		for (size_t i = _begin; i < _end; i++) {
+			uint32_t leaf = leafStart + (uint32_t)i;
+			BuildNode& node = buildNodes[leaf];
+			node.children[0] = mortonPrimitives[i].index;
+			node.bounds = primitiveBounds[node.children[0]];
+			node.primitiveCount = 1;
+			node.nodeCount = 1;
+			node.cost = node.bounds.SurfaceArea();
+			node.isCollapsed = true;
+
+			PropagateUp(leaf, visitCounts.get());
+		}
+	});
+	lastBuildTimes.bottomUpSeconds = Lap(stageStart);
+
+	// Emit the top of the tree serially, down to subtrees big enough to be
+	// worth a task each, then emit those subtrees in parallel
+	std::vector<LinearBVHNode> nodes(buildNodes[0].nodeCount);
+	std::vector<shared_ptr<Hittable>> primitives(primitiveCount);
+	maxDepth = 0;
+
+	struct Subtree {
+		uint32_t node;
+		uint32_t nodeOffset;
+		uint32_t primitiveOffset;
+		int depth;
+	};
+	std::vector<Subtree> subtrees;
+	uint32_t taskPrimitives = std::max<uint32_t>(1024, primitiveCount / (threadPool->GetThreadCount() * 16));
+
+	std::vector<Subtree> toSplit = { { 0, 0, 0, 0 } };
+	while (!toSplit.empty()) {
+		Subtree subtree = toSplit.back();
+		toSplit.pop_back();
+
+		const BuildNode& node = buildNodes[subtree.node];
+		if (node.primitiveCount <= taskPrimitives || node.isCollapsed) {
+			subtrees.push_back(subtree);
+			continue;
+		}
+
+		// Write just this node; its children go back on the list
+		uint32_t first, second;
+		EmitNode(subtree.node, subtree.nodeOffset, subtree.primitiveOffset, subtree.depth, nodes, primitives, _list, first, second);
+		toSplit.push_back({ first, subtree.nodeOffset + 1, subtree.primitiveOffset, subtree.depth + 1 });
+		toSplit.push_back({ second, nodes[subtree.nodeOffset].secondChildOffset, subtree.primitiveOffset + buildNodes[first].primitiveCount, subtree.depth + 1 });
+	}
+
+	threadPool->ParallelFor(subtrees.size(), [&](size_t _begin, size_t _end) {
+		for (size_t i = _begin; i < _end; i++) {
+			EmitSubtree(subtrees[i].node, subtrees[i].nodeOffset, subtrees[i].primitiveOffset, subtrees[i].depth, nodes, primitives, _list);
+		}
+	});
+	lastBuildTimes.emitSeconds = Lap(stageStart);
+
+	// Drop the build state before handing the tree over
+	mortonPrimitives = std::vector<MortonPrimitive>();
+	buildNodes = std::vector<BuildNode>();
+
+	// Morton trees are shallow in practice, but nothing guarantees it;
+	// traversal's stack can't take a deeper tree, so fall back to SAH
+	std::shared_ptr<BVH> bvh;
+	if (maxDepth > BVH::MAX_DEPTH) {
+		printf("LBVH was %d levels deep (limit %d), building with SAH instead\n", maxDepth.load(), BVH::MAX_DEPTH);
+		bvh = std::make_shared<BVH>(_list);
+	}
+	else {
+		bvh = std::make_shared<BVH>(std::move(nodes), std::move(primitives));
+	}
+
+	lastBuildTimes.totalSeconds = Lap(buildStart);
+	return bvh;
+}
+
+bool LBVHBuilder::IsLeaf(uint32_t _node) const
+{
+	return _node >= leafStart;
+}
+
+void LBVHBuilder::RadixSort()
+{
+	const uint32_t bucketCount = 1u << RADIX_BITS;
+	const int totalBits = 3 * MORTON_BITS_PER_AXIS;
+
+	size_t count = mortonPrimitives.size();
+	size_t chunkCount = std::min(count, (size_t)threadPool->GetThreadCount() * 4);
+	size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+	chunkCount = (count + chunkSize - 1) / chunkSize;
+
+	std::vector<MortonPrimitive> scratch(count);
+	std::vector<uint32_t> offsets(chunkCount * bucketCount);
+
+	for (int shift = 0; shift < totalBits; shift += RADIX_BITS) {
+		// Count how many codes in each chunk fall in each bucket
+		threadPool->ParallelFor(chunkCount, [&](size_t _begin, size_t _end) {
+			for (size_t chunk = _begin; chunk < _end; chunk++) {
+				uint32_t* chunkCounts = &offsets[chunk * bucketCount];
+				std::fill(chunkCounts, chunkCounts + bucketCount, 0);
+
+				size_t end = std::min(count, (chunk + 1) * chunkSize);
+				for (size_t i = chunk * chunkSize; i < end; i++) {
+					chunkCounts[(mortonPrimitives[i].code >> shift) & (bucketCount - 1)]++;
+				}
+			}
+		});
+
+		// Turn the counts into where each chunk starts writing each bucket.
+		// Buckets go in order, and within one, earlier chunks go first,
+		// so the sort is stable
+		uint32_t total = 0;
+		for (uint32_t bucket = 0; bucket < bucketCount; bucket++) {
+			for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+				uint32_t bucketCountInChunk = offsets[chunk * bucketCount + bucket];
+				offsets[chunk * bucketCount + bucket] = total;
+				total += bucketCountInChunk;
+			}
+		}
+
+		// Scatter each chunk's codes to their places
+		threadPool->ParallelFor(chunkCount, [&](size_t _begin, size_t _end) {
+			for (size_t chunk = _begin; chunk < _end; chunk++) {
+				uint32_t* chunkOffsets = &offsets[chunk * bucketCount];
+
+				size_t end = std::min(count, (chunk + 1) * chunkSize);
+				for (size_t i = chunk * chunkSize; i < end; i++) {
+					scratch[chunkOffsets[(mortonPrimitives[i].code >> shift) & (bucketCount - 1)]++] = mortonPrimitives[i];
+				}
+			}
+		});
+
+		mortonPrimitives.swap(scratch);
+	}
+}
+
+int LBVHBuilder::CommonPrefix(int _i, int _j) const
+{
+	if (_j < 0 || _j >= (int)mortonPrimitives.size())
+		return -1;
+
+	uint32_t codeI = mortonPrimitives[_i].code;
+	uint32_t codeJ = mortonPrimitives[_j].code;
+	if (codeI == codeJ)
+		return 32 + std::countl_zero((uint32_t)(_i ^ _j));
+	return std::countl_zero(codeI ^ codeJ);
+}
+
+void LBVHBuilder::BuildInternalNode(uint32_t _node)
+{
+	// Karras, "Maximizing Parallelism in the Construction of BVHs, Octrees,
+	// and k-d Trees". Each internal node's range starts or ends at its own
+	// index; grow it in whichever direction shares the longer prefix
+	int i = (int)_node;
+	int direction = CommonPrefix(i, i + 1) - CommonPrefix(i, i - 1) > 0 ? 1 : -1;
+	int minPrefix = CommonPrefix(i, i - direction);
+
+	// Find an upper bound on the range's length, then binary search the other end
+	int maxLength = 2;
+	while (CommonPrefix(i, i + maxLength * direction) > minPrefix) {
+		maxLength *= 2;
+	}
+
+	int length = 0;
+	for (int step = maxLength / 2; step >= 1; step /= 2) {
+		if (CommonPrefix(i, i + (length + step) * direction) > minPrefix)
+			length += step;
+	}
+	int j = i + length * direction;
+
+	// Binary search for where the range's shared prefix stops being shared
+	int nodePrefix = CommonPrefix(i, j);
+	int split = 0;
+	for (int divisor = 2; ; divisor *= 2) {
+		int step = (length + divisor - 1) / divisor;
+		if (CommonPrefix(i, i + (split + step) * direction) > nodePrefix)
+			split += step;
+		if (step <= 1)
+			break;
+	}
+	int gamma = i + split * direction + std::min(direction, 0);
+
+	// Each half is a leaf if it holds a single primitive
+	uint32_t left = std::min(i, j) == gamma ? leafStart + gamma : (uint32_t)gamma;
+	uint32_t right = std::max(i, j) == gamma + 1 ? leafStart + gamma + 1 : (uint32_t)(gamma + 1);
+
+	BuildNode& node = buildNodes[_node];
+	node.children[0] = left;
+	node.children[1] = right;
+	buildNodes[left].parent = _node;
+	buildNodes[right].parent = _node;
+}
+
+void LBVHBuilder::UpdateNode(uint32_t _node)
+{
+	BuildNode& node = buildNodes[_node];
+	const BuildNode& left = buildNodes[node.children[0]];
+	const BuildNode& right = buildNodes[node.children[1]];
+
+	node.bounds = AABB(left.bounds, right.bounds);
+	node.primitiveCount = left.primitiveCount + right.primitiveCount;
+
+	// Same trade-off the SAH builder makes: a leaf if that's no more expensive
+	float area = node.bounds.SurfaceArea();
+	float splitCost = BVH::TRAVERSAL_COST * area + left.cost + right.cost;
+	float leafCost = node.primitiveCount <= BVH::MAX_LEAF_PRIMITIVES ? area * node.primitiveCount : infinity;
+
+	node.isCollapsed = leafCost <= splitCost;
+	node.cost = node.isCollapsed ? leafCost : splitCost;
+	node.nodeCount = node.isCollapsed ? 1 : 1 + left.nodeCount + right.nodeCount;
+}
+
+void LBVHBuilder::PropagateUp(uint32_t _leaf, std::atomic<uint32_t>* _visitCounts)
+{
+	uint32_t current = buildNodes[_leaf].parent;
+	while (current != UINT32_MAX) {
+		// The first child to arrive stops here; the second finishes the node.
+		// acq_rel makes the first child's writes visible to the second
+		if (_visitCounts[current].fetch_add(1, std::memory_order_acq_rel) == 0)
+			return;
+
+		UpdateNode(current);
+		if (optimizeTreelets && buildNodes[current].primitiveCount >= TREELET_SIZE)
+			OptimizeTreelet(current);
+
+		current = buildNodes[current].parent;
+	}
+}
+
+void LBVHBuilder::OptimizeTreelet(uint32_t _node)
+{
+	// Karras and Aila, "Fast Parallel Construction of High-Quality BVHs".
+	// Grow a treelet from the node by repeatedly opening its largest
+	// internal leaf, then find its cheapest topology over every subset
+	uint32_t treeletLeaves[TREELET_SIZE] = { buildNodes[_node].children[0], buildNodes[_node].children[1] };
+	uint32_t treeletInternals[TREELET_SIZE - 2];
+	int leafCount = 2;
+	int internalCount = 0;
+
+	while (leafCount < TREELET_SIZE) {
+		int largest = -1;
+		float largestArea = -1.0f;
+		for (int i = 0; i < leafCount; i++) {
+			const BuildNode& candidate = buildNodes[treeletLeaves[i]];
+			if (!IsLeaf(treeletLeaves[i]) && candidate.bounds.SurfaceArea() > largestArea) {
+				largest = i;
+				largestArea = candidate.bounds.SurfaceArea();
+			}
+		}
+		if (largest < 0)
+			break;
+
+		uint32_t opened = treeletLeaves[largest];
+		treeletInternals[internalCount++] = opened;
+		treeletLeaves[largest] = buildNodes[opened].children[0];
+		treeletLeaves[leafCount++] = buildNodes[opened].children[1];
+	}
+
+	if (leafCount < 3)
+		return;
+
+	// Cheapest cost, and the split that gets it, for every subset of leaves
+	const int subsetCount = 1 << leafCount;
+	AABB subsetBounds[1 << TREELET_SIZE];
+	float subsetCost[1 << TREELET_SIZE];
+	uint32_t subsetPrimitives[1 << TREELET_SIZE];
+	uint8_t bestSplit[1 << TREELET_SIZE];
+
+	for (int subset = 1; subset < subsetCount; subset++) {
+		int lowest = std::countr_zero((uint32_t)subset);
+		int rest = subset & (subset - 1);
+		const BuildNode& leaf = buildNodes[treeletLeaves[lowest]];
+
+		if (rest == 0) {
+			subsetBounds[subset] = leaf.bounds;
+			subsetPrimitives[subset] = leaf.primitiveCount;
+			subsetCost[subset] = leaf.cost;
+			continue;
+		}
+		subsetBounds[subset] = AABB(subsetBounds[rest], leaf.bounds);
+		subsetPrimitives[subset] = subsetPrimitives[rest] + leaf.primitiveCount;
+
+		// Try every way of splitting the subset in two. Keeping the
+		// lowest leaf on the left skips each split's mirror image
+		float best = infinity;
+		int split = 0;
+		for (int left = (subset - 1) & subset; left > 0; left = (left - 1) & subset) {
+			if ((left & (1 << lowest)) == 0)
+				continue;
+
+			float cost = subsetCost[left] + subsetCost[subset ^ left];
+			if (cost < best) {
+				best = cost;
+				split = left;
+			}
+		}
+
+		float area = subsetBounds[subset].SurfaceArea();
+		float splitCost = BVH::TRAVERSAL_COST * area + best;
+		float leafCost = subsetPrimitives[subset] <= (uint32_t)BVH::MAX_LEAF_PRIMITIVES ? area * subsetPrimitives[subset] : infinity;
+		subsetCost[subset] = std::min(splitCost, leafCost);
+		bestSplit[subset] = (uint8_t)split;
+	}
+
+	// Only rebuild if it's actually cheaper
+	if (subsetCost[subsetCount - 1] >= buildNodes[_node].cost * 0.9999f)
+		return;
+
+	// Rebuild the treelet's internal nodes into the best topology, reusing the
+	// nodes it already has. Children are finished before their parents
+	int nextInternal = 0;
+	auto restructure = [&](auto& _self, int _subset, uint32_t _target) -> void {
+		int sides[2] = { bestSplit[_subset], _subset ^ bestSplit[_subset] };
+		for (int side = 0; side < 2; side++) {
+			uint32_t child;
+			if (std::has_single_bit((uint32_t)sides[side])) {
+				child = treeletLeaves[std::countr_zero((uint32_t)sides[side])];
+			}
+			else {
+				child = treeletInternals[nextInternal++];
+				_self(_self, sides[side], child);
+			}
+			buildNodes[_target].children[side] = child;
+			buildNodes[child].parent = _target;
+		}
+		UpdateNode(_target);
+	};
+	restructure(restructure, subsetCount - 1, _node);
+}
+
+void LBVHBuilder::EmitSubtree(uint32_t _node, uint32_t _nodeOffset, uint32_t _primitiveOffset, int _depth,
+	std::vector<LinearBVHNode>& _nodes, std::vector<shared_ptr<Hittable>>& _primitives, const HittableList& _list)
+{
+	uint32_t first, second;
+	if (EmitNode(_node, _nodeOffset, _primitiveOffset, _depth, _nodes, _primitives, _list, first, second))
+		return;
+
+	EmitSubtree(first, _nodeOffset + 1, _primitiveOffset, _depth + 1, _nodes, _primitives, _list);
+	EmitSubtree(second, _nodes[_nodeOffset].secondChildOffset, _primitiveOffset + buildNodes[first].primitiveCount, _depth + 1, _nodes, _primitives, _list);
+}
+
+bool LBVHBuilder::EmitNode(uint32_t _node, uint32_t _nodeOffset, uint32_t _primitiveOffset, int _depth,
+	std::vector<LinearBVHNode>& _nodes, std::vector<shared_ptr<Hittable>>& _primitives, const HittableList& _list,
+	uint32_t& _first, uint32_t& _second)
+{
+	const BuildNode& buildNode = buildNodes[_node];
+	LinearBVHNode& node = _nodes[_nodeOffset];
+
+	node.boundsMin[0] = buildNode.bounds.x.minimum;
+	node.boundsMin[1] = buildNode.bounds.y.minimum;
+	node.boundsMin[2] = buildNode.bounds.z.minimum;
+	node.boundsMax[0] = buildNode.bounds.x.maximum;
+	node.boundsMax[1] = buildNode.bounds.y.maximum;
+	node.boundsMax[2] = buildNode.bounds.z.maximum;
+	node.pad = 0;
+
+	if (buildNode.isCollapsed) {
+		node.primitiveOffset = _primitiveOffset;
+		node.primitiveCount = (uint16_t)buildNode.primitiveCount;
+		node.axis = 0;
+		GatherPrimitives(_node, _primitiveOffset, _primitives, _list);
+
+		int depth = maxDepth.load(std::memory_order_relaxed);
+		while (_depth > depth && !maxDepth.compare_exchange_weak(depth, _depth)) {}
+		return true;
+	}
+
+	// Traversal visits the second child first when the ray points down the
+	// split axis, so put the child with the lower centroid along it first
+	_first = buildNode.children[0];
+	_second = buildNode.children[1];
+	XMFLOAT3 firstCentroid = buildNodes[_first].bounds.Centroid();
+	XMFLOAT3 secondCentroid = buildNodes[_second].bounds.Centroid();
+
+	int axis = 0;
+	float widestGap = -1.0f;
+	for (int i = 0; i < 3; i++) {
+		float gap = std::fabs(AxisComponent(secondCentroid, i) - AxisComponent(firstCentroid, i));
+		if (gap > widestGap) {
+			widestGap = gap;
+			axis = i;
+		}
+	}
+	if (AxisComponent(secondCentroid, axis) < AxisComponent(firstCentroid, axis))
+		std::swap(_first, _second);
+
+	node.secondChildOffset = _nodeOffset + 1 + buildNodes[_first].nodeCount;
+	node.primitiveCount = 0;
+	node.axis = (uint8_t)axis;
+	return false;
+}
+
+void LBVHBuilder::GatherPrimitives(uint32_t _node, uint32_t& _primitiveOffset,
+	std::vector<shared_ptr<Hittable>>& _primitives, const HittableList& _list) const
+{
+	if (IsLeaf(_node)) {
+		_primitives[_primitiveOffset++] = _list.objects[buildNodes[_node].children[0]];
+		return;
+	}
+	GatherPrimitives(buildNodes[_node].children[0], _primitiveOffset, _primitives, _list);
+	GatherPrimitives(buildNodes[_node].children[1], _primitiveOffset, _primitives, _list);
+}
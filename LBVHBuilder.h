@@ -0,0 +1,107 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "BVH.h"
+#include "HittableList.h"
+#include "ThreadPool.h"
+
+// How long each stage of the last LBVH build took
+struct LBVHBuildTimes {
+	double mortonSeconds = 0.0;		// Primitive bounds and Morton codes
+	double sortSeconds = 0.0;		// Radix sorting the codes
+	double hierarchySeconds = 0.0;	// Finding every internal node's children
+	double bottomUpSeconds = 0.0;	// Bounds, costs and treelet optimization
+	double emitSeconds = 0.0;		// Writing the flattened BVH
+	double totalSeconds = 0.0;
+};
+
+// Builds a BVH in parallel as a linear BVH: primitives are sorted along a
+// Morton curve through their centroids, and the hierarchy falls out of
+// the sorted codes' shared prefixes, so every internal node can be found
+// independently. An optional pass then reshapes small treelets into their
+// cheapest SAH topology, recovering most of a full SAH build's quality.
+// The result is an ordinary BVH, so it's traversed like any other
+class LBVHBuilder
+{
+public:
+	LBVHBuilder(std::shared_ptr<ThreadPool> _threadPool);
+
+	// Builds a hierarchy over every object in the list
+	std::shared_ptr<BVH> Build(const HittableList& _list);
+
+	bool GetTreeletOptimization() const;
+	void SetTreeletOptimization(bool _optimizeTreelets);
+
+	const LBVHBuildTimes& GetLastBuildTimes() const;
+
+private:
+	// Leaves in each treelet that gets reshaped
+	static const int TREELET_SIZE = 7;
+	// Bits per axis in each Morton code, and per radix sort pass
+	static const int MORTON_BITS_PER_AXIS = 10;
+	static const int RADIX_BITS = 10;
+
+	// A primitive's Morton code and where it sits in the list
+	struct MortonPrimitive {
+		uint32_t code;
+		uint32_t index;
+	};
+
+	// One node of the tree while it's being built. Internal nodes come first,
+	// then one leaf per sorted primitive, so the tree's root is node 0
+	struct BuildNode {
+		AABB bounds;
+		// SAH cost of the subtree, scaled by area rather than normalized
+		float cost;
+		uint32_t children[2];	// Leaves: children[0] is the primitive's list index
+		uint32_t parent;
+		uint32_t primitiveCount;
+		// Nodes the subtree takes up once flattened
+		uint32_t nodeCount;
+		// Whether the subtree is cheaper flattened into one leaf
+		bool isCollapsed;
+	};
+
+	std::shared_ptr<ThreadPool> threadPool;
+	bool optimizeTreelets;
+	LBVHBuildTimes lastBuildTimes;
+
+	// State for the build in progress
+	std::vector<MortonPrimitive> mortonPrimitives;
+	std::vector<BuildNode> buildNodes;
+	uint32_t leafStart;
+	std::atomic<int> maxDepth;
+
+	bool IsLeaf(uint32_t _node) const;
+
+	// Sorts mortonPrimitives by code, keeping equal codes in list order
+	void RadixSort();
+	// Length of the prefix shared by the sorted codes at _i and _j, or -1 if
+	// _j is out of range. Equal codes are told apart by their position
+	int CommonPrefix(int _i, int _j) const;
+	// Finds the range an internal node covers and where it splits
+	void BuildInternalNode(uint32_t _node);
+
+	// Recomputes a node's bounds, counts and cost from its children
+	void UpdateNode(uint32_t _node);
+	// Walks from a leaf towards the root, finishing each node once
+	// both of its children are done
+	void PropagateUp(uint32_t _leaf, std::atomic<uint32_t>* _visitCounts);
+	// Reshapes the treelet rooted at _node into its cheapest topology
+	void OptimizeTreelet(uint32_t _node);
+
+	// Writes a subtree to the flattened arrays, starting at the given offsets
+	void EmitSubtree(uint32_t _node, uint32_t _nodeOffset, uint32_t _primitiveOffset, int _depth,
+		std::vector<LinearBVHNode>& _nodes, std::vector<shared_ptr<Hittable>>& _primitives, const HittableList& _list);
+	// Writes a single node. Returns true for leaves; otherwise sets _first and
+	// _second to its children in the order they're laid out after it
+	bool EmitNode(uint32_t _node, uint32_t _nodeOffset, uint32_t _primitiveOffset, int _depth,
+		std::vector<LinearBVHNode>& _nodes, std::vector<shared_ptr<Hittable>>& _primitives, const HittableList& _list,
+		uint32_t& _first, uint32_t& _second);
+	// Copies a collapsed subtree's primitives out in depth-first order
+	void GatherPrimitives(uint32_t _node, uint32_t& _primitiveOffset,
+		std::vector<shared_ptr<Hittable>>& _primitives, const HittableList& _list) const;
+};
+
@@ -0,0 +1,421 @@
+#include "LightBVH.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	// Gets one component of a point by axis index
+	float AxisComponent(const XMFLOAT3& _point, int _axis)
+	{
+		if (_axis == 1) return _point.y;
+		if (_axis == 2) return _point.z;
+		return _point.x;
+	}
+
+	float SafeSqrt(float _x)
+	{
+		return std::sqrt(std::max(0.0f, _x));
+	}
+
+	float SafeAcos(float _x)
+	{
+		return std::acos(std::clamp(_x, -1.0f, 1.0f));
+	}
+
+	// Cosine of max(0, a - b), given both angles' sines and cosines
+	float CosSubClamped(float _sinA, float _cosA, float _sinB, float _cosB)
+	{
+		if (_cosA > _cosB)
+			return 1.0f;
+		return _cosA * _cosB + _sinA * _sinB;
+	}
+
+	LightBounds UnionBounds(const LightBounds& _a, const LightBounds& _b)
+	{
+		return { AABB(_a.bounds, _b.bounds), LightCone::Union(_a.cone, _b.cone), _a.power + _b.power };
+	}
+
+	// Reads a node's bounds back out
+	LightBounds NodeLightBounds(const LightBVHNode& _node)
+	{
+		LightBounds bounds;
+		bounds.bounds = AABB(
+			Interval(_node.boundsMin[0], _node.boundsMax[0]),
+			Interval(_node.boundsMin[1], _node.boundsMax[1]),
+			Interval(_node.boundsMin[2], _node.boundsMax[2]));
+		bounds.cone.axis = XMFLOAT3(_node.axis[0], _node.axis[1], _node.axis[2]);
+		bounds.cone.cosThetaO = _node.cosThetaO;
+		bounds.cone.cosThetaE = _node.cosThetaE;
+		bounds.power = _node.power;
+		return bounds;
+	}
+
+	// Writes bounds into a node
+	void SetNodeLightBounds(LightBVHNode& _node, const LightBounds& _bounds)
+	{
+		_node.boundsMin[0] = _bounds.bounds.x.minimum;
+		_node.boundsMin[1] = _bounds.bounds.y.minimum;
+		_node.boundsMin[2] = _bounds.bounds.z.minimum;
+		_node.boundsMax[0] = _bounds.bounds.x.maximum;
+		_node.boundsMax[1] = _bounds.bounds.y.maximum;
+		_node.boundsMax[2] = _bounds.bounds.z.maximum;
+		_node.power = _bounds.power;
+		_node.axis[0] = _bounds.cone.axis.x;
+		_node.axis[1] = _bounds.cone.axis.y;
+		_node.axis[2] = _bounds.cone.axis.z;
+		_node.cosThetaO = _bounds.cone.cosThetaO;
+		_node.cosThetaE = _bounds.cone.cosThetaE;
+	}
+
+	// Splits are costed as power times orientation times surface area: the
+	// chance, roughly, that a shading point picks the group and that it matters
+	float SplitCost(const LightBounds& _bounds)
+	{
+		return _bounds.power * _bounds.cone.OrientationMeasure() * _bounds.bounds.SurfaceArea();
+	}
+}
+
+LightCone LightCone::Omnidirectional()
+{
+	// Normals face every way, and each gives off light over its hemisphere
+	return { XMFLOAT3(0.0f, 0.0f, 1.0f), -1.0f, 0.0f };
+}
+
+LightCone LightCone::Union(const LightCone& _a, const LightCone& _b)
+{
+	LightCone result = Omnidirectional();
+	result.cosThetaE = std::min(_a.cosThetaE, _b.cosThetaE);
+	if (_a.cosThetaO <= -1.0f || _b.cosThetaO <= -1.0f)
+		return result;
+
+	// Either cone may already hold the other
+	float thetaA = SafeAcos(_a.cosThetaO);
+	float thetaB = SafeAcos(_b.cosThetaO);
+	XMVECTOR axisA = XMLoadFloat3(&_a.axis);
+	XMVECTOR axisB = XMLoadFloat3(&_b.axis);
+	float cosThetaD;
+	XMStoreFloat(&cosThetaD, XMVector3Dot(axisA, axisB));
+	float thetaD = SafeAcos(cosThetaD);
+	if (std::min(thetaD + thetaB, pi) <= thetaA) {
+		result.axis = _a.axis;
+		result.cosThetaO = _a.cosThetaO;
+		return result;
+	}
+	if (std::min(thetaD + thetaA, pi) <= thetaB) {
+		result.axis = _b.axis;
+		result.cosThetaO = _b.cosThetaO;
+		return result;
+	}
+
+	// Otherwise the new cone spans from A's far edge to B's, with its axis
+	// rotated from A's toward B's by the difference
+	float thetaO = 0.5f * (thetaA + thetaD + thetaB);
+	XMVECTOR rotationAxis = XMVector3Cross(axisA, axisB);
+	float rotationAxisLengthSquared;
+	XMStoreFloat(&rotationAxisLengthSquared, XMVector3LengthSq(rotationAxis));
+	if (thetaO >= pi || rotationAxisLengthSquared <= 0.0f)
+		return result;
+
+	float thetaR = thetaO - thetaA;
+	rotationAxis = XMVectorScale(rotationAxis, 1.0f / std::sqrt(rotationAxisLengthSquared));
+	XMStoreFloat3(&result.axis, XMVector3Normalize(
+		XMVectorScale(axisA, std::cos(thetaR)) + XMVectorScale(XMVector3Cross(rotationAxis, axisA), std::sin(thetaR))));
+	result.cosThetaO = std::cos(thetaO);
+	return result;
+}
+
+float LightCone::OrientationMeasure() const
+{
+	float thetaO = SafeAcos(cosThetaO);
+	float thetaW = std::min(thetaO + SafeAcos(cosThetaE), pi);
+	float sinThetaO = SafeSqrt(1.0f - cosThetaO * cosThetaO);
+	return 2.0f * pi * (1.0f - cosThetaO) +
+		pi / 2.0f * (2.0f * thetaW * sinThetaO - std::cos(thetaO - 2.0f * thetaW) - 2.0f * thetaO * sinThetaO + cosThetaO);
+}
+
+void LightBVH::Build(const std::vector<LightBounds>& _lights)
+{
+	Clear();
+	if (_lights.empty())
+		return;
+
+	std::vector<BuildLight> buildLights(_lights.size());
+	for (size_t i = 0; i < _lights.size(); i++) {
+		buildLights[i].bounds = _lights[i];
+		buildLights[i].centroid = _lights[i].bounds.Centroid();
+		buildLights[i].index = (uint32_t)i;
+	}
+
+	lightLeaves.resize(_lights.size());
+	lightPaths.resize(_lights.size());
+	nodes.reserve(2 * _lights.size());
+	BuildRecursive(buildLights, 0, buildLights.size(), 0, 0);
+}
+
+void LightBVH::Refit(const std::vector<LightBounds>& _lights)
+{
+	// Children are always stored after their parent, so walking the array
+	// backwards finishes both of a node's children before the node itself
+	for (size_t i = nodes.size(); i-- > 0;) {
+		LightBVHNode& node = nodes[i];
+		if (node.isLeaf)
+			SetNodeLightBounds(node, _lights[node.lightIndex]);
+		else
+			SetNodeLightBounds(node, UnionBounds(NodeLightBounds(nodes[i + 1]), NodeLightBounds(nodes[node.secondChildOffset])));
+	}
+}
+
+void LightBVH::Clear()
+{
+	nodes.clear();
+	lightLeaves.clear();
+	lightPaths.clear();
+	depth = 0;
+}
+
+size_t LightBVH::GetNodeCount() const { return nodes.size(); }
+int LightBVH::GetDepth() const { return depth; }
+
+bool LightBVH::Sample(const DirectX::XMFLOAT3& _point, const DirectX::XMFLOAT3& _normal, float _u, uint32_t& _light, float& _probability) const
+{
+	if (nodes.empty())
+		return false;
+
+	// Walk down, reusing _u for each choice by stretching whichever part of
+	// [0,1) it fell in back over the whole range
+	uint32_t nodeIndex = 0;
+	_probability = 1.0f;
+	while (!nodes[nodeIndex].isLeaf) {
+		const LightBVHNode& node = nodes[nodeIndex];
+		float firstProbability = FirstChildProbability(nodeIndex, _point, _normal);
+		if (_u < firstProbability) {
+			nodeIndex = nodeIndex + 1;
+			_u = std::min(_u / firstProbability, 0x1.fffffep-1f);
+			_probability *= firstProbability;
+		}
+		else {
+			nodeIndex = node.secondChildOffset;
+			_u = std::min((_u - firstProbability) / (1.0f - firstProbability), 0x1.fffffep-1f);
+			_probability *= 1.0f - firstProbability;
+		}
+	}
+
+	_light = nodes[nodeIndex].lightIndex;
+	return true;
+}
+
+float LightBVH::Probability(const DirectX::XMFLOAT3& _point, const DirectX::XMFLOAT3& _normal, uint32_t _light) const
+{
+	if (_light >= lightLeaves.size())
+		return 0.0f;
+
+	// Retrace the walk Sample() would take to the light's leaf
+	uint64_t path = lightPaths[_light];
+	uint32_t nodeIndex = 0;
+	float probability = 1.0f;
+	while (nodeIndex != lightLeaves[_light]) {
+		const LightBVHNode& node = nodes[nodeIndex];
+		float firstProbability = FirstChildProbability(nodeIndex, _point, _normal);
+		if (path & 1) {
+			nodeIndex = node.secondChildOffset;
+			probability *= 1.0f - firstProbability;
+		}
+		else {
+			nodeIndex = nodeIndex + 1;
+			probability *= firstProbability;
+		}
+		path >>= 1;
+	}
+
+	return probability;
+}
+
+float LightBVH::FirstChildProbability(uint32_t _node, const DirectX::XMFLOAT3& _point, const DirectX::XMFLOAT3& _normal) const
+{
+	float firstImportance = Importance(nodes[_node + 1], _point, _normal);
+	float secondImportance = Importance(nodes[nodes[_node].secondChildOffset], _point, _normal);
+
+	// A parent's looser bounds can reach the point when neither child's do.
+	// Splitting evenly then keeps every walk going to a leaf, so sampling
+	// lights never fails partway down for some _u and not others
+	float totalImportance = firstImportance + secondImportance;
+	return totalImportance > 0.0f ? firstImportance / totalImportance : 0.5f;
+}
+
+float LightBVH::Importance(const LightBVHNode& _node, const DirectX::XMFLOAT3& _point, const DirectX::XMFLOAT3& _normal) const
+{
+	// Direction from the box's center to the point, and the box's size
+	float toPoint[3];
+	float distanceSquared = 0.0f;
+	float halfDiagonalSquared = 0.0f;
+	const float point[3] = { _point.x, _point.y, _point.z };
+	for (int axis = 0; axis < 3; axis++) {
+		float halfExtent = 0.5f * (_node.boundsMax[axis] - _node.boundsMin[axis]);
+		toPoint[axis] = point[axis] - (_node.boundsMin[axis] + halfExtent);
+		distanceSquared += toPoint[axis] * toPoint[axis];
+		halfDiagonalSquared += halfExtent * halfExtent;
+	}
+
+	// Angle the box covers as seen from the point; from inside, everything
+	float cosThetaB = -1.0f;
+	float sinThetaB = 0.0f;
+	if (distanceSquared > halfDiagonalSquared) {
+		float sinThetaBSquared = halfDiagonalSquared / distanceSquared;
+		cosThetaB = SafeSqrt(1.0f - sinThetaBSquared);
+		sinThetaB = std::sqrt(sinThetaBSquared);
+	}
+
+	float distance = std::sqrt(distanceSquared);
+	float inverseDistance = distance > 0.0f ? 1.0f / distance : 0.0f;
+	for (int axis = 0; axis < 3; axis++) {
+		toPoint[axis] *= inverseDistance;
+	}
+
+	// Smallest angle between any light's emitting normal and the point,
+	// allowing for the normals' spread and the box's size. Past the edge of
+	// the emission cone, none of the lights can reach the point
+	float cosThetaW = toPoint[0] * _node.axis[0] + toPoint[1] * _node.axis[1] + toPoint[2] * _node.axis[2];
+	float sinThetaW = SafeSqrt(1.0f - cosThetaW * cosThetaW);
+	float sinThetaO = SafeSqrt(1.0f - _node.cosThetaO * _node.cosThetaO);
+	float cosThetaX = CosSubClamped(sinThetaW, cosThetaW, sinThetaO, _node.cosThetaO);
+	float sinThetaX = SafeSqrt(1.0f - cosThetaX * cosThetaX);
+	float cosThetaP = CosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+	if (cosThetaP <= _node.cosThetaE)
+		return 0.0f;
+
+	// Points in or right next to the box would otherwise see it as infinitely bright
+	float importance = _node.power * cosThetaP / std::max(distanceSquared, halfDiagonalSquared);
+
+	// Lights wholly below the shading point's horizon can't light it
+	if (_normal.x != 0.0f || _normal.y != 0.0f || _normal.z != 0.0f) {
+		float cosThetaI = -(toPoint[0] * _normal.x + toPoint[1] * _normal.y + toPoint[2] * _normal.z);
+		float sinThetaI = SafeSqrt(1.0f - cosThetaI * cosThetaI);
+		importance *= std::max(0.0f, CosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB));
+	}
+
+	return importance;
+}
+
+uint32_t LightBVH::BuildRecursive(std::vector<BuildLight>& _buildLights, size_t _start, size_t _end, int _depth, uint64_t _path)
+{
+	// Claim this node's slot before its children take the ones after it
+	uint32_t nodeIndex = (uint32_t)nodes.size();
+	nodes.emplace_back();
+	depth = std::max(depth, _depth);
+
+	LightBounds bounds = _buildLights[_start].bounds;
+	for (size_t i = _start + 1; i < _end; i++) {
+		bounds = UnionBounds(bounds, _buildLights[i].bounds);
+	}
+
+	if (_end - _start == 1) {
+		uint32_t light = _buildLights[_start].index;
+		LightBVHNode& node = nodes[nodeIndex];
+		node.lightIndex = light;
+		node.isLeaf = 1;
+		lightLeaves[light] = nodeIndex;
+		lightPaths[light] = _path;
+	}
+	else {
+		size_t mid = _depth < MAX_SAOH_DEPTH ? PartitionSAOH(_buildLights, _start, _end) : _end;
+		if (mid == _start || mid == _end) {
+			// Too deep to trust the heuristic to stay balanced, or nothing
+			// to split by, so halve the range
+			int axis = bounds.bounds.LongestAxis();
+			mid = _start + (_end - _start) / 2;
+			std::nth_element(_buildLights.begin() + _start, _buildLights.begin() + mid, _buildLights.begin() + _end,
+				[axis](const BuildLight& _a, const BuildLight& _b) {
+					return AxisComponent(_a.centroid, axis) < AxisComponent(_b.centroid, axis);
+				});
+		}
+
+		// The first child lands at nodeIndex + 1 by construction
+		BuildRecursive(_buildLights, _start, mid, _depth + 1, _path);
+		uint32_t secondChild = BuildRecursive(_buildLights, mid, _end, _depth + 1, _path | (1ull << _depth));
+
+		// Children may have reallocated the array, so index it again
+		LightBVHNode& node = nodes[nodeIndex];
+		node.secondChildOffset = secondChild;
+		node.isLeaf = 0;
+	}
+
+	SetNodeLightBounds(nodes[nodeIndex], bounds);
+	return nodeIndex;
+}
+
+size_t LightBVH::PartitionSAOH(std::vector<BuildLight>& _buildLights, size_t _start, size_t _end)
+{
+	// Bound the lights' centroids, since that's what they're binned by
+	AABB centroidBounds;
+	for (size_t i = _start; i < _end; i++) {
+		centroidBounds = AABB(centroidBounds, AABB(_buildLights[i].centroid, _buildLights[i].centroid));
+	}
+
+	// Finds which bin a centroid falls in along an axis
+	auto binIndex = [&centroidBounds](const BuildLight& _light, int _axis) {
+		const Interval& axisBounds = centroidBounds.AxisInterval(_axis);
+		float centroid = AxisComponent(_light.centroid, _axis);
+		int bin = (int)(SAOH_BIN_COUNT * (centroid - axisBounds.minimum) / axisBounds.Size());
+		return std::min(bin, SAOH_BIN_COUNT - 1);
+	};
+
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = infinity;
+
+	for (int axis = 0; axis < 3; axis++) {
+		if (centroidBounds.AxisInterval(axis).Size() <= 0.0f)
+			continue;
+
+		// Sort lights into bins, growing each bin's bounds around them
+		LightBounds binBounds[SAOH_BIN_COUNT];
+		size_t binCounts[SAOH_BIN_COUNT] = {};
+		for (size_t i = _start; i < _end; i++) {
+			int bin = binIndex(_buildLights[i], axis);
+			binBounds[bin] = binCounts[bin] == 0 ? _buildLights[i].bounds : UnionBounds(binBounds[bin], _buildLights[i].bounds);
+			binCounts[bin]++;
+		}
+
+		// Sweep from the right, recording the cost of everything right of
+		// each split plane. Split i falls between bins i and i + 1
+		float rightCosts[SAOH_BIN_COUNT - 1];
+		LightBounds rightBounds;
+		size_t rightCount = 0;
+		for (int i = SAOH_BIN_COUNT - 1; i > 0; i--) {
+			if (binCounts[i] > 0)
+				rightBounds = rightCount == 0 ? binBounds[i] : UnionBounds(rightBounds, binBounds[i]);
+			rightCount += binCounts[i];
+			rightCosts[i - 1] = rightCount > 0 ? SplitCost(rightBounds) : -1.0f;
+		}
+
+		LightBounds leftBounds;
+		size_t leftCount = 0;
+		for (int i = 0; i < SAOH_BIN_COUNT - 1; i++) {
+			if (binCounts[i] > 0)
+				leftBounds = leftCount == 0 ? binBounds[i] : UnionBounds(leftBounds, binBounds[i]);
+			leftCount += binCounts[i];
+
+			if (leftCount == 0 || rightCosts[i] < 0.0f)
+				continue;
+
+			float cost = SplitCost(leftBounds) + rightCosts[i];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = i;
+			}
+		}
+	}
+
+	if (bestAxis < 0)
+		return _end;
+
+	auto mid = std::partition(_buildLights.begin() + _start, _buildLights.begin() + _end,
+		[&binIndex, bestAxis, bestSplit](const BuildLight& _light) {
+			return binIndex(_light, bestAxis) <= bestSplit;
+		});
+
+	return mid - _buildLights.begin();
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "AABB.h"
+
+// Bounds on which way a group of lights face: every emitting surface's
+// normal is within thetaO of axis, and each gives off light up to thetaE
+// past its normal. Stored as cosines; a thetaO of pi covers every direction
+struct LightCone {
+	DirectX::XMFLOAT3 axis;
+	float cosThetaO;
+	float cosThetaE;
+
+	// A cone for lights that face every way, such as spheres
+	static LightCone Omnidirectional();
+	// The narrowest cone around both cones' normals
+	static LightCone Union(const LightCone& _a, const LightCone& _b);
+	// How much of the sphere of directions the cone lights, for weighing
+	// splits against each other while building
+	float OrientationMeasure() const;
+};
+
+// What the tree keeps about each light, or group of lights
+struct LightBounds {
+	AABB bounds;
+	LightCone cone;
+	// Total light given off, in any consistent unit
+	float power;
+};
+
+// One node of a flattened light BVH. Nodes are stored depth-first, so an
+// interior node's first child is always the node right after it. Every
+// leaf holds exactly one light
+struct LightBVHNode {
+	float boundsMin[3];
+	union {
+		uint32_t lightIndex;		// Leaf: which light
+		uint32_t secondChildOffset;	// Interior: index of the second child
+	};
+	float boundsMax[3];
+	float power;
+	float axis[3];
+	float cosThetaO;
+	float cosThetaE;
+	uint32_t isLeaf;
+};
+
+// A bounding volume hierarchy over lights, with a cone of directions as
+// well as a box and total power at every node (Conty Estevez and Kulla
+// 2018). Lights are picked by walking from the root, choosing each child
+// in proportion to an estimate of how much light it sends toward the
+// shading point, so one pick costs a walk down the tree's depth
+class LightBVH
+{
+public:
+	// Builds over _lights, splitting by the surface area orientation heuristic
+	void Build(const std::vector<LightBounds>& _lights);
+	// Updates every node's bounds after lights move. _lights must hold the
+	// same lights, in the same order, as the last build
+	void Refit(const std::vector<LightBounds>& _lights);
+	void Clear();
+
+	size_t GetNodeCount() const;
+	int GetDepth() const;
+
+	// Picks a light for a shading point at _point with normal _normal, or a
+	// zero normal for none, using _u in [0,1). Sets _probability to the
+	// chance it was picked. Returns false only if the tree is empty
+	bool Sample(const DirectX::XMFLOAT3& _point, const DirectX::XMFLOAT3& _normal, float _u, uint32_t& _light, float& _probability) const;
+	// The chance Sample() picks _light for the same shading point
+	float Probability(const DirectX::XMFLOAT3& _point, const DirectX::XMFLOAT3& _normal, uint32_t _light) const;
+
+	// Deepest the tree is allowed to get; each light's path from the root is kept as bits
+	static const int MAX_DEPTH = 64;
+
+private:
+	// Depth after which nodes are split at the median rather than by the
+	// heuristic, which keeps the tree inside MAX_DEPTH
+	static const int MAX_SAOH_DEPTH = 32;
+	// Number of buckets centroids are sorted into when evaluating splits
+	static const int SAOH_BIN_COUNT = 12;
+
+	struct BuildLight {
+		LightBounds bounds;
+		DirectX::XMFLOAT3 centroid;
+		uint32_t index;
+	};
+
+	std::vector<LightBVHNode> nodes;
+	// For each light, its leaf, and which child leads to it from each node
+	// on the way down: bit i is set when the second child is taken at depth i
+	std::vector<uint32_t> lightLeaves;
+	std::vector<uint64_t> lightPaths;
+	int depth = 0;
+
+	// Estimate of the light a node sends toward the shading point, which
+	// never rounds down to 0 while any of its lights could reach it
+	float Importance(const LightBVHNode& _node, const DirectX::XMFLOAT3& _point, const DirectX::XMFLOAT3& _normal) const;
+	// Chance of walking from interior node _node to its first child
+	float FirstChildProbability(uint32_t _node, const DirectX::XMFLOAT3& _point, const DirectX::XMFLOAT3& _normal) const;
+
+	uint32_t BuildRecursive(std::vector<BuildLight>& _buildLights, size_t _start, size_t _end, int _depth, uint64_t _path);
+	// Picks the cheapest binned split of the range and partitions around it,
+	// returning the index the second group starts at
+	size_t PartitionSAOH(std::vector<BuildLight>& _buildLights, size_t _start, size_t _end);
+};
@@ -0,0 +1,155 @@
+#include "LightList.h"
+
+#include <algorithm>
+#include "VectorHelpers.h"
+
+using namespace DirectX;
+
+void LightList::Build(const HittableList& _objects, const MaterialTable& _materials)
+{
+	Clear();
+
+	for (const shared_ptr<Hittable>& object : _objects.objects) {
+		const Sphere* sphere = dynamic_cast<const Sphere*>(object.get());
+		if (!sphere)
+			continue;
+
+		// Lights give off light from their outsides
+		HitRecord record = {};
+		record.material = sphere->GetMaterial();
+		record.primitive = sphere;
+		record.isFrontFace = true;
+		XMFLOAT3 radiance;
+		XMStoreFloat3(&radiance, _materials.Emitted(record.material, record));
+		if (radiance.x <= 0.0f && radiance.y <= 0.0f && radiance.z <= 0.0f)
+			continue;
+
+		// Power is only compared between lights, so constant factors are left out
+		float radius = sphere->GetRadius();
+		float luminance = 0.2126f * radiance.x + 0.7152f * radiance.y + 0.0722f * radiance.z;
+		float power = luminance * radius * radius;
+
+		lightIndices[sphere] = (uint32_t)lights.size();
+		lights.push_back({ sphere, radiance, power });
+	}
+
+	bvh.Build(GatherLightBounds());
+}
+
+void LightList::Refit()
+{
+	bvh.Refit(GatherLightBounds());
+}
+
+void LightList::Clear()
+{
+	lights.clear();
+	lightIndices.clear();
+	bvh.Clear();
+}
+
+size_t LightList::GetCount() const { return lights.size(); }
+const LightBVH& LightList::GetBVH() const { return bvh; }
+
+bool LightList::Sample(const DirectX::XMFLOAT3& _point, const DirectX::XMFLOAT3& _normal, LightSelection _selection, float _uLight, float _u, float _v, LightSample& _sample) const
+{
+	if (lights.empty())
+		return false;
+
+	uint32_t index;
+	float selectionPdf;
+	if (_selection == LightSelection::BVH) {
+		if (!bvh.Sample(_point, _normal, _uLight, index, selectionPdf))
+			return false;
+	}
+	else {
+		index = std::min((uint32_t)(_uLight * lights.size()), (uint32_t)lights.size() - 1);
+		selectionPdf = 1.0f / lights.size();
+	}
+	const SphereLight& light = lights[index];
+
+	XMFLOAT3 center = light.sphere->GetOrigin();
+	float radius = light.sphere->GetRadius();
+	XMVECTOR toCenter = XMLoadFloat3(&center) - XMLoadFloat3(&_point);
+	float distanceSquared;
+	XMStoreFloat(&distanceSquared, XMVector3LengthSq(toCenter));
+
+	// From inside the sphere, every direction reaches it, but only its
+	// inside, which gives off no light
+	if (distanceSquared <= radius * radius) {
+		_sample.direction = UniformSampleSphere(2.0f * _u - 1.0f, 2.0f * _v - 1.0f);
+		_sample.distance = radius;
+		_sample.pdf = selectionPdf / (4.0f * pi);
+		_sample.radiance = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		return true;
+	}
+
+	// Pick uniformly within the cone of directions that hit the sphere.
+	// 1 - cos is found from sin^2, which keeps small, distant lights' cones
+	// from rounding away to nothing
+	float distance = std::sqrt(distanceSquared);
+	float sinMaxSquared = radius * radius / distanceSquared;
+	float cosMax = std::sqrt(std::max(0.0f, 1.0f - sinMaxSquared));
+	float oneMinusCosMax = sinMaxSquared / (1.0f + cosMax);
+
+	float cosTheta = 1.0f - _u * oneMinusCosMax;
+	float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+	float phi = 2.0f * pi * _v;
+
+	XMFLOAT3 axis, tangent, bitangent;
+	XMStoreFloat3(&axis, XMVectorScale(toCenter, 1.0f / distance));
+	OrthonormalBasis(axis, tangent, bitangent);
+	XMVECTOR direction = XMVectorScale(XMLoadFloat3(&tangent), sinTheta * std::cos(phi));
+	direction = direction + XMVectorScale(XMLoadFloat3(&bitangent), sinTheta * std::sin(phi));
+	direction = direction + XMVectorScale(XMLoadFloat3(&axis), cosTheta);
+	XMStoreFloat3(&_sample.direction, XMVector3Normalize(direction));
+
+	// Nearest point along the direction on the sphere
+	float closestSquared = distanceSquared * sinTheta * sinTheta;
+	_sample.distance = distance * cosTheta - std::sqrt(std::max(0.0f, radius * radius - closestSquared));
+	_sample.pdf = selectionPdf / (2.0f * pi * oneMinusCosMax);
+	_sample.radiance = light.radiance;
+	return true;
+}
+
+float LightList::Pdf(const DirectX::XMFLOAT3& _point, const DirectX::XMFLOAT3& _normal, LightSelection _selection, const Hittable* _primitive) const
+{
+	auto found = lightIndices.find(_primitive);
+	if (found == lightIndices.end())
+		return 0.0f;
+
+	float selectionPdf = SelectionProbability(_point, _normal, _selection, found->second);
+	return selectionPdf > 0.0f ? selectionPdf * ConePdf(_point, lights[found->second]) : 0.0f;
+}
+
+std::vector<LightBounds> LightList::GatherLightBounds() const
+{
+	std::vector<LightBounds> bounds(lights.size());
+	for (size_t i = 0; i < lights.size(); i++) {
+		bounds[i] = { lights[i].sphere->BoundingBox(), LightCone::Omnidirectional(), lights[i].power };
+	}
+	return bounds;
+}
+
+float LightList::SelectionProbability(const DirectX::XMFLOAT3& _point, const DirectX::XMFLOAT3& _normal, LightSelection _selection, uint32_t _light) const
+{
+	if (_selection == LightSelection::BVH)
+		return bvh.Probability(_point, _normal, _light);
+
+	return 1.0f / lights.size();
+}
+
+float LightList::ConePdf(const DirectX::XMFLOAT3& _point, const SphereLight& _light)
+{
+	XMFLOAT3 center = _light.sphere->GetOrigin();
+	float radius = _light.sphere->GetRadius();
+	float distanceSquared;
+	XMStoreFloat(&distanceSquared, XMVector3LengthSq(XMLoadFloat3(&center) - XMLoadFloat3(&_point)));
+
+	if (distanceSquared <= radius * radius)
+		return 1.0f / (4.0f * pi);
+
+	float sinMaxSquared = radius * radius / distanceSquared;
+	float cosMax = std::sqrt(std::max(0.0f, 1.0f - sinMaxSquared));
+	return 1.0f / (2.0f * pi * (sinMaxSquared / (1.0f + cosMax)));
+}
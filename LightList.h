@@ -0,0 +1,90 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+#include "HittableList.h"
+#include "LightBVH.h"
+#include "MaterialTable.h"
+#include "Sphere.h"
+
+// How the camera finds the light emissive surfaces give off
+enum class LightSampling
+{
+	// Only when a scattered ray happens to hit an emitter
+	Off,
+	// Only with shadow rays toward a sampled light, at every bounce off a
+	// surface that isn't a perfect mirror or glass
+	LightsOnly,
+	// Both, weighted against each other by the balance heuristic
+	BalanceHeuristic,
+	// Both, weighted against each other by the power heuristic
+	PowerHeuristic
+};
+
+// How a light is picked for each shading point
+enum class LightSelection
+{
+	// Every light is as likely as any other
+	Uniform,
+	// Lights are picked through a light BVH, in proportion to how much
+	// light they're estimated to send the shading point
+	BVH
+};
+
+// A direction toward a point on a light, as seen from a shading point
+struct LightSample {
+	DirectX::XMFLOAT3 direction;
+	// How far along the direction the light is
+	float distance;
+	// Probability density, per solid angle, of picking this direction,
+	// including the chance of picking this light
+	float pdf;
+	// Light given off toward the shading point
+	DirectX::XMFLOAT3 radiance;
+};
+
+// Every sphere in a scene whose material gives off light, for sampling
+// lights directly. A light is picked, uniformly or through a light BVH, then
+// a direction is picked uniformly within the cone the light's sphere covers
+// from the shading point. Spheres are read when sampled, but the light BVH
+// keeps its own bounds, so call Refit() after lights move
+class LightList
+{
+public:
+	// Finds the emissive spheres among _objects and builds a light BVH over them
+	void Build(const HittableList& _objects, const MaterialTable& _materials);
+	// Updates the light BVH's bounds to where the spheres are now
+	void Refit();
+	void Clear();
+
+	size_t GetCount() const;
+	const LightBVH& GetBVH() const;
+
+	// Picks a light with _uLight, by _selection, for a shading point at
+	// _point with normal _normal, or a zero normal for none. Then picks a
+	// direction toward it with _u and _v, all in [0,1). Returns false only
+	// if there are no lights; lights that can't reach the point give a
+	// sample with no radiance
+	bool Sample(const DirectX::XMFLOAT3& _point, const DirectX::XMFLOAT3& _normal, LightSelection _selection, float _uLight, float _u, float _v, LightSample& _sample) const;
+	// Density, per solid angle, that Sample() for the same shading point
+	// picks the direction a ray took to hit _primitive; 0 if it isn't a light
+	float Pdf(const DirectX::XMFLOAT3& _point, const DirectX::XMFLOAT3& _normal, LightSelection _selection, const Hittable* _primitive) const;
+
+private:
+	struct SphereLight {
+		const Sphere* sphere;
+		DirectX::XMFLOAT3 radiance;
+		float power;
+	};
+
+	std::vector<SphereLight> lights;
+	// Where each light's sphere is in lights
+	std::unordered_map<const Hittable*, uint32_t> lightIndices;
+	LightBVH bvh;
+
+	// What the light BVH needs to know about each light, where it is now
+	std::vector<LightBounds> GatherLightBounds() const;
+	// Chance of picking _light for the shading point, by _selection
+	float SelectionProbability(const DirectX::XMFLOAT3& _point, const DirectX::XMFLOAT3& _normal, LightSelection _selection, uint32_t _light) const;
+	// Density of directions toward _light from _point, as if it were the only light
+	static float ConePdf(const DirectX::XMFLOAT3& _point, const SphereLight& _light);
+};
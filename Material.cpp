@@ -3,48 +3,124 @@
 
 using namespace DirectX;
 
-bool Lambertian::Scatter(const Ray& _rayIn, const HitRecord& _record, DirectX::XMVECTOR& _attenuation, Ray& _scattered) const
+DirectX::XMVECTOR ScatterRecord::Weight(const DirectX::XMFLOAT3& _normal) const
 {
+	if (isDelta)
+		return XMLoadFloat3(&value);
+
+	float cosine;
+	XMStoreFloat(&cosine, XMVector3Dot(XMLoadFloat3(&scattered.Direction), XMLoadFloat3(&_normal)));
+	return XMVectorScale(XMLoadFloat3(&value), std::abs(cosine) / pdf);
+}
+
+bool Lambertian::Scatter(const Ray& _rayIn, const HitRecord& _record, ScatterRecord& _scatter) const
+{
+	// Scatter in proportion to the cosine from the normal, which cancels the
+	// cosine in the weight, leaving just the albedo
+	XMVECTOR direction = RandomCosineDirection(_record.normal);
+	float cosine;
+	XMStoreFloat(&cosine, XMVector3Dot(direction, XMLoadFloat3(&_record.normal)));
+	if (cosine <= 0.0f)
+		return false;
+
+	_scatter.scattered.Origin = _record.point;
+	XMStoreFloat3(&_scatter.scattered.Direction, direction);
+	XMStoreFloat3(&_scatter.value, XMVectorScale(XMLoadFloat3(&albedo), 1.0f / pi));
+	_scatter.pdf = cosine / pi;
+	_scatter.isDelta = false;
+	return true;
+}
+
+bool Lambertian::Evaluate(const Ray& _rayIn, const HitRecord& _record, const DirectX::XMFLOAT3& _direction, DirectX::XMFLOAT3& _value, float& _pdf) const
+{
+	float cosine;
+	XMStoreFloat(&cosine, XMVector3Dot(XMLoadFloat3(&_direction), XMLoadFloat3(&_record.normal)));
+	if (cosine <= 0.0f) {
+		_value = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		_pdf = 0.0f;
+		return true;
+	}
+
+	XMStoreFloat3(&_value, XMVectorScale(XMLoadFloat3(&albedo), 1.0f / pi));
+	_pdf = cosine / pi;
+	return true;
+}
+
+bool Metal::Scatter(const Ray& _rayIn, const HitRecord& _record, ScatterRecord& _scatter) const
+{
+	_scatter.scattered.Origin = _record.point;
 	XMVECTOR vecNormal = XMLoadFloat3(&_record.normal);
-	XMVECTOR scatterDirection = vecNormal + RandomUnitVector();
+	// Normalize reflected ray
+	XMVECTOR reflected = XMVector3Normalize(XMVector3Reflect(XMLoadFloat3(&_rayIn.Direction), vecNormal));
 
-	// Catch degenerate scatter condition
-	float scatterDirectionLength;
-	XMStoreFloat(&scatterDirectionLength, XMVector3LengthSq(scatterDirection));
-	if (scatterDirectionLength < std::numeric_limits<float>::epsilon()) {
-		scatterDirection = vecNormal;
+	if (fuzz <= 0.0f) {
+		XMStoreFloat3(&_scatter.scattered.Direction, reflected);
+		_scatter.value = albedo;
+		_scatter.pdf = 1.0f;
+		_scatter.isDelta = true;
+		return true;
 	}
 
-	_scattered.Origin = _record.point;
-	XMStoreFloat3(&_scattered.Direction, scatterDirection);
-	_attenuation = XMLoadFloat3(&albedo);
+	// Add fuzz
+	XMVECTOR direction = XMVector3Normalize(reflected + XMVectorScale(RandomUnitVector(), fuzz));
+
+	// Only scatter if fuzz doesn't make scattered vector go into the surface
+	float cosine;
+	XMStoreFloat(&cosine, XMVector3Dot(direction, vecNormal));
+	float pdf = FuzzPdf(reflected, direction);
+	if (cosine <= 0.0f || pdf <= 0.0f)
+		return false;
+
+	// The BSDF is whatever makes the weight come out to the albedo
+	XMStoreFloat3(&_scatter.scattered.Direction, direction);
+	XMStoreFloat3(&_scatter.value, XMVectorScale(XMLoadFloat3(&albedo), pdf / cosine));
+	_scatter.pdf = pdf;
+	_scatter.isDelta = false;
 	return true;
 }
 
-bool Metal::Scatter(const Ray& _rayIn, const HitRecord& _record, DirectX::XMVECTOR& _attenuation, Ray& _scattered) const
+bool Metal::Evaluate(const Ray& _rayIn, const HitRecord& _record, const DirectX::XMFLOAT3& _direction, DirectX::XMFLOAT3& _value, float& _pdf) const
 {
-	_scattered.Origin = _record.point;
+	// A perfect mirror only ever reflects one way
+	if (fuzz <= 0.0f)
+		return false;
+
 	XMVECTOR vecNormal = XMLoadFloat3(&_record.normal);
-	XMVECTOR scatterDirection =
-		// Normalize reflected ray
-		XMVector3Normalize(
-			// Calculate reflected ray
-			XMVector3Reflect(XMLoadFloat3(&_rayIn.Direction), vecNormal)
-		) +
-		// Add fuzz
-		XMVectorScale(RandomUnitVector(), fuzz);
-
-	XMStoreFloat3(&_scattered.Direction, scatterDirection);
-
-	_attenuation = XMLoadFloat3(&albedo);
-	float dotScatteredNormal;
-	XMStoreFloat(&dotScatteredNormal, XMVector3Dot(scatterDirection, vecNormal));
-	
-	// Only return if fuzz doesn't make scattered vector go into the surface
-	return dotScatteredNormal > 0.0f;
+	XMVECTOR direction = XMLoadFloat3(&_direction);
+	XMVECTOR reflected = XMVector3Normalize(XMVector3Reflect(XMLoadFloat3(&_rayIn.Direction), vecNormal));
+
+	float cosine;
+	XMStoreFloat(&cosine, XMVector3Dot(direction, vecNormal));
+	float pdf = cosine > 0.0f ? FuzzPdf(reflected, direction) : 0.0f;
+	if (pdf <= 0.0f) {
+		_value = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		_pdf = 0.0f;
+		return true;
+	}
+
+	XMStoreFloat3(&_value, XMVectorScale(XMLoadFloat3(&albedo), pdf / cosine));
+	_pdf = pdf;
+	return true;
 }
 
-bool Dielectric::Scatter(const Ray& _rayIn, const HitRecord& _record, DirectX::XMVECTOR& _attenuation, Ray& _scattered) const
+float Metal::FuzzPdf(DirectX::XMVECTOR _reflected, DirectX::XMVECTOR _direction) const
+{
+	// Fuzzed points lie on a sphere of radius fuzz around the tip of the
+	// reflection, which is 1 away. A direction's ray passes through that
+	// sphere at t = c +/- sqrt(d), where c is its cosine with the reflection
+	// and d = c^2 - 1 + fuzz^2, and both points map to it. Converting each
+	// point's share of the sphere's area to solid angle, t^2 / cos, and
+	// summing them gives the density
+	float c;
+	XMStoreFloat(&c, XMVector3Dot(_reflected, _direction));
+	float discriminant = c * c - 1.0f + fuzz * fuzz;
+	if (c <= 0.0f || discriminant <= 0.0f)
+		return 0.0f;
+
+	return (2.0f * c * c - 1.0f + fuzz * fuzz) / (2.0f * pi * fuzz * std::sqrt(discriminant));
+}
+
+bool Dielectric::Scatter(const Ray& _rayIn, const HitRecord& _record, ScatterRecord& _scatter) const
 {
 	XMVECTOR vecUnitDirection = XMVector3Normalize(XMLoadFloat3(&_rayIn.Direction));
 	XMVECTOR vecNormal = XMLoadFloat3(&_record.normal);
@@ -58,13 +134,18 @@ bool Dielectric::Scatter(const Ray& _rayIn, const HitRecord& _record, DirectX::X
 
 	bool cannotRefract = ri * sinTheta > 1.0f;
 
-	_scattered.Origin = _record.point;
-	XMStoreFloat3(&_scattered.Direction, 
+	// Reflection and refraction are each a single direction; which one is
+	// taken is chosen in proportion to how much light goes each way, so the
+	// weight is just 1
+	_scatter.scattered.Origin = _record.point;
+	XMStoreFloat3(&_scatter.scattered.Direction, 
 		cannotRefract || Reflectance(cosTheta, ri) > RandomFloat() ?
 		XMVector3Reflect(vecUnitDirection, vecNormal) :
 		XMVector3Refract(vecUnitDirection, vecNormal, ri)
 	);
-	_attenuation = XMLoadFloat3(&UNIT_VECTOR3);
+	_scatter.value = UNIT_VECTOR3;
+	_scatter.pdf = 1.0f;
+	_scatter.isDelta = true;
 
 	return true;
 }
@@ -76,3 +157,8 @@ float Dielectric::Reflectance(float _cosine, float _refractionIndex)
 	r0 = r0 * r0;
 	return r0 + (1.0f - r0) * std::powf((1.0f - _cosine), 5.0f);
 }
+
+DirectX::XMVECTOR DiffuseLight::Emitted(const HitRecord& _record) const
+{
+	return _record.isFrontFace ? XMLoadFloat3(&emit) : XMVectorZero();
+}
@@ -2,49 +2,100 @@
 #include "Helpers.h"
 #include "Hittable.h"
 
+// The direction a material scattered a ray in, and how likely and how
+// bright that direction is, so the integrator can weight it
+struct ScatterRecord
+{
+	// Leaves the hit point. Its direction is unit length
+	Ray scattered;
+	// The BSDF's value for the scattered direction. For delta lobes, which
+	// have no finite value, it's the whole weight the path is scaled by
+	DirectX::XMFLOAT3 value;
+	// Probability density, per solid angle, of scattering in this direction.
+	// Unused for delta lobes
+	float pdf;
+	// Whether this was the only direction the lobe could scatter in, as for
+	// a perfect mirror or a refraction, so no other sampling could find it
+	bool isDelta;
+
+	// What the path's throughput is scaled by: the BSDF times the cosine
+	// between the direction and _normal, over the PDF
+	DirectX::XMVECTOR Weight(const DirectX::XMFLOAT3& _normal) const;
+};
+
 class Material
 {
 public:
 	virtual ~Material() = default;
 
+	// Picks a direction for a ray that hit the surface to leave in. Returns
+	// false if the ray is absorbed instead
 	virtual bool Scatter(
-		const Ray& _rayIn, const HitRecord& _record, DirectX::XMVECTOR& _attenuation, Ray& _scattered
+		const Ray& _rayIn, const HitRecord& _record, ScatterRecord& _scatter
 	) const {
 		return false;
 	}
+
+	// Finds the BSDF's value for leaving in the unit _direction, and the
+	// density Scatter() picks that direction with. Returns false if the
+	// material has only delta lobes, which no other direction can reach, so
+	// lights can't be sampled for it. Materials with other lobes must
+	// override this, or light sampling will count their light twice
+	virtual bool Evaluate(
+		const Ray& _rayIn, const HitRecord& _record, const DirectX::XMFLOAT3& _direction, DirectX::XMFLOAT3& _value, float& _pdf
+	) const {
+		return false;
+	}
+
+	// Light the surface gives off back along the ray that hit it
+	virtual DirectX::XMVECTOR Emitted(const HitRecord& _record) const {
+		return DirectX::XMVectorZero();
+	}
 };
 
-class Lambertian : public Material {
+class Lambertian final : public Material {
 public:
 	Lambertian(const DirectX::XMFLOAT3& _albedo) : albedo(_albedo) {}
 
 	bool Scatter(
-		const Ray& _rayIn, const HitRecord& _record, DirectX::XMVECTOR& _attenuation, Ray& _scattered
+		const Ray& _rayIn, const HitRecord& _record, ScatterRecord& _scatter
+	) const override;
+	bool Evaluate(
+		const Ray& _rayIn, const HitRecord& _record, const DirectX::XMFLOAT3& _direction, DirectX::XMFLOAT3& _value, float& _pdf
 	) const override;
 
 private:
 	DirectX::XMFLOAT3 albedo;
 };
 
-class Metal : public Material {
+// Reflects about the normal, then offsets the reflection by a random point
+// on a sphere fuzz across. With no fuzz it's a perfect mirror, a delta lobe
+class Metal final : public Material {
 public:
 	Metal(const DirectX::XMFLOAT3& _albedo, float _fuzz) : albedo(_albedo), fuzz(_fuzz < 1.0f ? _fuzz : 1.0f) {}
 
 	bool Scatter(
-		const Ray& _rayIn, const HitRecord& _record, DirectX::XMVECTOR& _attenuation, Ray& _scattered
+		const Ray& _rayIn, const HitRecord& _record, ScatterRecord& _scatter
+	) const override;
+	bool Evaluate(
+		const Ray& _rayIn, const HitRecord& _record, const DirectX::XMFLOAT3& _direction, DirectX::XMFLOAT3& _value, float& _pdf
 	) const override;
 
 private:
 	DirectX::XMFLOAT3 albedo;
 	float fuzz;
+
+	// Density, per solid angle, of fuzzing the unit _reflected direction
+	// into the unit _direction
+	float FuzzPdf(DirectX::XMVECTOR _reflected, DirectX::XMVECTOR _direction) const;
 };
 
-class Dielectric : public Material {
+class Dielectric final : public Material {
 public:
 	Dielectric(float _refractionIndex) : refractionIndex(_refractionIndex) {}
 
 	bool Scatter(
-		const Ray& _rayIn, const HitRecord& _record, DirectX::XMVECTOR& _attenuation, Ray& _scattered
+		const Ray& _rayIn, const HitRecord& _record, ScatterRecord& _scatter
 	) const override;
 
 private:
@@ -55,4 +106,14 @@ private:
 	static float Reflectance(float _cosine, float _refractionIndex);
 };
 
+// Gives off the same light in every direction from its front faces, and
+// absorbs whatever hits it
+class DiffuseLight final : public Material {
+public:
+	DiffuseLight(const DirectX::XMFLOAT3& _emit) : emit(_emit) {}
+
+	DirectX::XMVECTOR Emitted(const HitRecord& _record) const override;
 
+private:
+	DirectX::XMFLOAT3 emit;
+};
@@ -0,0 +1,52 @@
+#include "MaterialTable.h"
+
+#include <typeinfo>
+
+MaterialIndex MaterialTable::Add(shared_ptr<Material> _material)
+{
+	// Materials don't change once added, so the built-in types can be
+	// copied by value. The classes are final, so typeid can't miss a subclass
+	const std::type_info& type = typeid(*_material);
+	if (type == typeid(Lambertian)) {
+		entries.push_back({ MaterialType::Lambertian, (uint32_t)lambertians.size() });
+		lambertians.push_back(static_cast<const Lambertian&>(*_material));
+	}
+	else if (type == typeid(Metal)) {
+		entries.push_back({ MaterialType::Metal, (uint32_t)metals.size() });
+		metals.push_back(static_cast<const Metal&>(*_material));
+	}
+	else if (type == typeid(Dielectric)) {
+		entries.push_back({ MaterialType::Dielectric, (uint32_t)dielectrics.size() });
+		dielectrics.push_back(static_cast<const Dielectric&>(*_material));
+	}
+	else if (type == typeid(DiffuseLight)) {
+		entries.push_back({ MaterialType::DiffuseLight, (uint32_t)diffuseLights.size() });
+		diffuseLights.push_back(static_cast<const DiffuseLight&>(*_material));
+	}
+	else {
+		entries.push_back({ MaterialType::Other, 0 });
+	}
+
+	materials.push_back(_material);
+	return (MaterialIndex)(materials.size() - 1);
+}
+
+void MaterialTable::Clear()
+{
+	materials.clear();
+	entries.clear();
+	lambertians.clear();
+	metals.clear();
+	dielectrics.clear();
+	diffuseLights.clear();
+}
+
+size_t MaterialTable::GetCount() const
+{
+	return materials.size();
+}
+
+const Material& MaterialTable::Get(MaterialIndex _index) const
+{
+	return *materials[_index];
+}
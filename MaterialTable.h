@@ -0,0 +1,127 @@
+#pragma once
+#include <vector>
+#include "DispatchMode.h"
+#include "Helpers.h"
+#include "Material.h"
+
+// Every material in a scene, stored contiguously and referred to by index.
+// Surfaces and hit records carry a 32-bit MaterialIndex rather than a
+// shared_ptr, so tracing a ray never touches a reference count, and render
+// threads never fight over the cache lines those counts live on.
+// The built-in materials are also copied into an array per type, so in
+// closed-set dispatch mode scattering is a switch and a direct call
+class MaterialTable
+{
+public:
+	enum class MaterialType : uint32_t {
+		Lambertian,
+		Metal,
+		Dielectric,
+		DiffuseLight,
+		// Anything else, reached through the virtual interface
+		Other
+	};
+	static const uint32_t MATERIAL_TYPE_COUNT = (uint32_t)MaterialType::Other + 1;
+
+	// Adds a material and returns the index surfaces should use for it
+	MaterialIndex Add(shared_ptr<Material> _material);
+	void Clear();
+
+	size_t GetCount() const;
+	const Material& Get(MaterialIndex _index) const;
+	// Which scatter code a material runs, for grouping hits by it
+	MaterialType GetType(MaterialIndex _index) const { return entries[_index].type; }
+
+	// The material at _index as its concrete type, for code that already
+	// knows the type, such as a wavefront queue of one type's hits. The
+	// built-in types are final, so calls on the result are direct. Other
+	// gives the virtual interface, whatever the material's type
+	template<MaterialType TYPE>
+	const auto& GetAs(MaterialIndex _index) const {
+		if constexpr (TYPE == MaterialType::Lambertian)
+			return lambertians[entries[_index].index];
+		else if constexpr (TYPE == MaterialType::Metal)
+			return metals[entries[_index].index];
+		else if constexpr (TYPE == MaterialType::Dielectric)
+			return dielectrics[entries[_index].index];
+		else if constexpr (TYPE == MaterialType::DiffuseLight)
+			return diffuseLights[entries[_index].index];
+		else
+			return *materials[_index];
+	}
+
+	// Scatters a ray off the surface using the material the hit record names
+	bool Scatter(
+		MaterialIndex _index, const Ray& _rayIn, const HitRecord& _record, ScatterRecord& _scatter
+	) const {
+		if (Dispatch::Mode == DispatchMode::ClosedSet) {
+			const MaterialEntry& entry = entries[_index];
+			switch (entry.type) {
+			case MaterialType::Lambertian:
+				return lambertians[entry.index].Scatter(_rayIn, _record, _scatter);
+			case MaterialType::Metal:
+				return metals[entry.index].Scatter(_rayIn, _record, _scatter);
+			case MaterialType::Dielectric:
+				return dielectrics[entry.index].Scatter(_rayIn, _record, _scatter);
+			default:
+				break;
+			}
+		}
+
+		return materials[_index]->Scatter(_rayIn, _record, _scatter);
+	}
+
+	// Evaluates the BSDF of the material the hit record names, for light sampling
+	bool Evaluate(
+		MaterialIndex _index, const Ray& _rayIn, const HitRecord& _record, const DirectX::XMFLOAT3& _direction, DirectX::XMFLOAT3& _value, float& _pdf
+	) const {
+		if (Dispatch::Mode == DispatchMode::ClosedSet) {
+			const MaterialEntry& entry = entries[_index];
+			switch (entry.type) {
+			case MaterialType::Lambertian:
+				return lambertians[entry.index].Evaluate(_rayIn, _record, _direction, _value, _pdf);
+			case MaterialType::Metal:
+				return metals[entry.index].Evaluate(_rayIn, _record, _direction, _value, _pdf);
+			case MaterialType::Dielectric:
+			case MaterialType::DiffuseLight:
+				return false;
+			default:
+				break;
+			}
+		}
+
+		return materials[_index]->Evaluate(_rayIn, _record, _direction, _value, _pdf);
+	}
+
+	// Light given off by the surface the hit record names
+	DirectX::XMVECTOR Emitted(MaterialIndex _index, const HitRecord& _record) const {
+		if (Dispatch::Mode == DispatchMode::ClosedSet) {
+			const MaterialEntry& entry = entries[_index];
+			switch (entry.type) {
+			case MaterialType::DiffuseLight:
+				return diffuseLights[entry.index].Emitted(_record);
+			case MaterialType::Other:
+				break;
+			default:
+				return DirectX::XMVectorZero();
+			}
+		}
+
+		return materials[_index]->Emitted(_record);
+	}
+
+private:
+	// Which per-type array a material is in, and where
+	struct MaterialEntry {
+		MaterialType type;
+		uint32_t index;
+	};
+
+	std::vector<shared_ptr<Material>> materials;
+	std::vector<MaterialEntry> entries;
+	std::vector<Lambertian> lambertians;
+	std::vector<Metal> metals;
+	std::vector<Dielectric> dielectrics;
+	std::vector<DiffuseLight> diffuseLights;
+};
+
@@ -0,0 +1,40 @@
+#include "PrimitiveStore.h"
+
+#include <typeinfo>
+
+PrimitiveStore::PrimitiveStore(const std::vector<shared_ptr<Hittable>>& _primitives)
+{
+	refs.reserve(_primitives.size());
+	objects.reserve(_primitives.size());
+
+	for (const shared_ptr<Hittable>& primitive : _primitives) {
+		objects.push_back(primitive.get());
+
+		// Only exact Spheres are copied; a subclass may test differently
+		if (typeid(*primitive) == typeid(Sphere)) {
+			refs.push_back({ PrimitiveType::Sphere, (uint32_t)spheres.size() });
+			spheres.push_back({ {}, 0.0f, static_cast<const Sphere*>(primitive.get()) });
+		}
+		else if (typeid(*primitive) == typeid(SphereBatch)) {
+			refs.push_back({ PrimitiveType::SphereBatch, (uint32_t)sphereBatches.size() });
+			sphereBatches.push_back(static_cast<SphereBatch*>(primitive.get()));
+		}
+		else {
+			refs.push_back({ PrimitiveType::Other, 0 });
+		}
+	}
+
+	Sync();
+}
+
+void PrimitiveStore::Sync()
+{
+	for (SphereGeometry& sphere : spheres) {
+		sphere.origin = sphere.source->GetOrigin();
+		sphere.radius = sphere.source->GetRadius();
+	}
+
+	for (SphereBatch* batch : sphereBatches) {
+		batch->Sync();
+	}
+}
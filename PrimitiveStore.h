@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "DispatchMode.h"
+#include "Hittable.h"
+#include "Sphere.h"
+#include "SphereBatch.h"
+
+// A closed-set copy of a list of primitives for acceleration structures to
+// test against. Built-in types are copied into their own contiguous arrays
+// and reached by type tag and index, so testing one is a direct, inlinable
+// call on data already laid out together. Any other Hittable keeps going
+// through its virtual interface. Primitives are numbered in the order given
+class PrimitiveStore
+{
+public:
+	PrimitiveStore() {}
+	PrimitiveStore(const std::vector<shared_ptr<Hittable>>& _primitives);
+
+	// Copies the built-in primitives' current geometry again, after they move.
+	// Call before reading their bounding boxes
+	void Sync();
+
+	// Finds the closest hit on a single primitive, dispatched per Dispatch::Mode.
+	// Hits on copied primitives still report the original as the one hit
+	bool Intersect(uint32_t _primitive, const Ray& _ray, Interval _rayT, RayHit& _hit) const
+	{
+		if (Dispatch::Mode == DispatchMode::ClosedSet) {
+			const PrimitiveRef& ref = refs[_primitive];
+			if (ref.type == PrimitiveType::Sphere) {
+				const SphereGeometry& sphere = spheres[ref.index];
+				if (!Sphere::IntersectGeometry(sphere.origin, sphere.radius, _ray, _rayT, _hit.t))
+					return false;
+
+				_hit.primitive = sphere.source;
+				return true;
+			}
+			if (ref.type == PrimitiveType::SphereBatch)
+				return sphereBatches[ref.index]->Intersect(_ray, _rayT, _hit);
+		}
+
+		return objects[_primitive]->Intersect(_ray, _rayT, _hit);
+	}
+
+	// Whether a single primitive is hit anywhere within _rayT, dispatched per Dispatch::Mode
+	bool Occluded(uint32_t _primitive, const Ray& _ray, Interval _rayT) const
+	{
+		if (Dispatch::Mode == DispatchMode::ClosedSet) {
+			const PrimitiveRef& ref = refs[_primitive];
+			if (ref.type == PrimitiveType::Sphere) {
+				const SphereGeometry& sphere = spheres[ref.index];
+				float t;
+				return Sphere::IntersectGeometry(sphere.origin, sphere.radius, _ray, _rayT, t);
+			}
+			if (ref.type == PrimitiveType::SphereBatch)
+				return sphereBatches[ref.index]->Occluded(_ray, _rayT);
+		}
+
+		return objects[_primitive]->Occluded(_ray, _rayT);
+	}
+
+private:
+	enum class PrimitiveType : uint32_t {
+		Sphere,
+		SphereBatch,
+		// Anything else, reached through the virtual interface
+		Other
+	};
+
+	// Which per-type array a primitive is in, and where
+	struct PrimitiveRef {
+		PrimitiveType type;
+		uint32_t index;
+	};
+
+	// Everything the sphere test reads, and the sphere it was copied from
+	struct SphereGeometry {
+		DirectX::XMFLOAT3 origin;
+		float radius;
+		const Sphere* source;
+	};
+
+	std::vector<PrimitiveRef> refs;
+	std::vector<SphereGeometry> spheres;
+	// Batches already keep their spheres packed; the store just calls them
+	// directly, and tells them to copy their spheres again on Sync()
+	std::vector<SphereBatch*> sphereBatches;
+	// Every primitive, in order, for the virtual path
+	std::vector<const Hittable*> objects;
+};
+
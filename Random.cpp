@@ -0,0 +1,51 @@
+#include "Random.h"
+#include <atomic>
+
+namespace
+{
+	// Hands each thread that draws random numbers its own stream
+	std::atomic<uint64_t> nextStream(0);
+
+	// Expands a 64-bit seed into well-mixed state words ("splitmix64")
+	uint64_t SplitMix64(uint64_t& _x)
+	{
+		uint64_t z = (_x += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+}
+
+void Pcg32::Seed(uint64_t _seed, uint64_t _stream)
+{
+	// Stream increment must be odd
+	state = 0;
+	increment = (_stream << 1u) | 1u;
+	NextUInt();
+	state += _seed;
+	NextUInt();
+}
+
+void Xoshiro128Plus::Seed(uint64_t _seed)
+{
+	// Fill the state from splitmix64, as the xoshiro authors recommend
+	uint64_t a = SplitMix64(_seed);
+	uint64_t b = SplitMix64(_seed);
+	s[0] = (uint32_t)a;
+	s[1] = (uint32_t)(a >> 32);
+	s[2] = (uint32_t)b;
+	s[3] = (uint32_t)(b >> 32);
+}
+
+RandomThreadState::RandomThreadState() :
+	sampleKey(0),
+	key(0),
+	counter(0),
+	pixelIndex(0),
+	sampleIndex(0),
+	dimension(0)
+{
+	uint64_t stream = nextStream++;
+	pcg.Seed(Random::Seed, stream);
+	xoshiro.Seed(((uint64_t)Random::Seed << 32) ^ stream);
+}
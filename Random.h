@@ -0,0 +1,186 @@
+#pragma once
+#include <cstdint>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+class Sampler;
+
+// Which generator RandomFloat() draws from
+enum class RandomMode
+{
+	// Each thread runs its own PCG32 stream
+	Pcg32,
+	// Each thread runs its own xoshiro128+ stream
+	Xoshiro128Plus,
+	// Numbers are hashed from (seed, pixel, sample, bounce, draw), so a
+	// render comes out the same no matter which thread draws which pixel
+	CounterBased
+};
+
+// PCG-XSH-RR generator with 64 bits of state and selectable streams
+class Pcg32
+{
+public:
+	void Seed(uint64_t _seed, uint64_t _stream);
+	uint32_t NextUInt();
+
+private:
+	uint64_t state;
+	uint64_t increment;
+};
+
+// xoshiro128+ generator with 128 bits of state
+class Xoshiro128Plus
+{
+public:
+	void Seed(uint64_t _seed);
+	uint32_t NextUInt();
+
+private:
+	uint32_t s[4];
+};
+
+// Random number state owned by a single thread
+struct RandomThreadState
+{
+	// Seeds this thread's generators with a stream no other thread uses
+	RandomThreadState();
+
+	Pcg32 pcg;
+	Xoshiro128Plus xoshiro;
+
+	// Counter-based mode: key for the current pixel sample and bounce,
+	// and how many numbers have been drawn under that key
+	uint32_t sampleKey;
+	uint32_t key;
+	uint32_t counter;
+
+	// Sampler mode: the current pixel sample, and the next dimension to draw
+	uint32_t pixelIndex;
+	uint32_t sampleIndex;
+	uint32_t dimension;
+};
+
+namespace Random
+{
+	// --- GLOBAL VARS ---
+
+	// Only change these while no render is in progress
+	inline RandomMode Mode = RandomMode::CounterBased;
+	inline uint32_t Seed = 0;
+
+	inline thread_local RandomThreadState ThreadState;
+
+	// When set, draws made between BeginSample() and the end of the sample
+	// come from this sampler instead of Mode's generator. Set by the camera
+	// for the length of a render
+	inline const Sampler* ActiveSampler = nullptr;
+
+	// Sampler dimensions used by the camera (pixel offset and lens) and by
+	// each bounce (light sample, scatter direction, plus one-off choices)
+	static const uint32_t CAMERA_DIMENSIONS = 4;
+	static const uint32_t BOUNCE_DIMENSIONS = 8;
+
+	// --- FUNCTIONS ---
+
+	// Integer hash used to build and consume counter-based keys
+	// ("lowbias32", Chris Wellons)
+	inline uint32_t Hash(uint32_t _x)
+	{
+		_x ^= _x >> 16;
+		_x *= 0x7feb352du;
+		_x ^= _x >> 15;
+		_x *= 0x846ca68bu;
+		_x ^= _x >> 16;
+		return _x;
+	}
+
+#if defined(__AVX2__)
+	// Hash() on 8 values at once
+	inline __m256i HashLanes(__m256i _x)
+	{
+		_x = _mm256_xor_si256(_x, _mm256_srli_epi32(_x, 16));
+		_x = _mm256_mullo_epi32(_x, _mm256_set1_epi32((int)0x7feb352du));
+		_x = _mm256_xor_si256(_x, _mm256_srli_epi32(_x, 15));
+		_x = _mm256_mullo_epi32(_x, _mm256_set1_epi32((int)0x846ca68bu));
+		_x = _mm256_xor_si256(_x, _mm256_srli_epi32(_x, 16));
+		return _x;
+	}
+#endif
+
+	// Keys the calling thread's counter-based numbers to one camera sample
+	// of one pixel. Numbers drawn before the first bounce (e.g. for the
+	// pixel offset and lens) come from the sample's own key
+	inline void BeginSample(uint32_t _pixelIndex, uint32_t _sampleIndex)
+	{
+		ThreadState.sampleKey = Hash(Hash(Seed + _pixelIndex) + _sampleIndex);
+		ThreadState.key = ThreadState.sampleKey;
+		ThreadState.counter = 0;
+		ThreadState.pixelIndex = _pixelIndex;
+		ThreadState.sampleIndex = _sampleIndex;
+		ThreadState.dimension = 0;
+	}
+
+	// Keys the calling thread's counter-based numbers to one bounce of
+	// the current sample; _bounce starts at 1 for the first surface hit
+	inline void BeginBounce(uint32_t _bounce)
+	{
+		ThreadState.key = Hash(ThreadState.sampleKey + _bounce);
+		ThreadState.counter = 0;
+		ThreadState.dimension = CAMERA_DIMENSIONS + (_bounce - 1) * BOUNCE_DIMENSIONS;
+	}
+
+	// Draws the next dimension of the current sample from ActiveSampler
+	float NextSampledFloat();
+
+	// Returns a uniformly distributed 32-bit integer from the current mode
+	inline uint32_t NextUInt()
+	{
+		switch (Mode) {
+		case RandomMode::Pcg32:
+			return ThreadState.pcg.NextUInt();
+		case RandomMode::Xoshiro128Plus:
+			return ThreadState.xoshiro.NextUInt();
+		default:
+			return Hash(ThreadState.key ^ (ThreadState.counter++ * 0x9e3779b9u));
+		}
+	}
+
+	// Returns a random real in [0,1)
+	inline float NextFloat()
+	{
+		if (ActiveSampler)
+			return NextSampledFloat();
+
+		// Use the top 24 bits, which fit exactly in a float's mantissa
+		return (NextUInt() >> 8) * (1.0f / 16777216.0f);
+	}
+}
+
+inline uint32_t Pcg32::NextUInt()
+{
+	uint64_t oldState = state;
+	state = oldState * 6364136223846793005ull + increment;
+
+	// Permute the old state into the output
+	uint32_t xorShifted = (uint32_t)(((oldState >> 18u) ^ oldState) >> 27u);
+	uint32_t rotation = (uint32_t)(oldState >> 59u);
+	return (xorShifted >> rotation) | (xorShifted << ((0u - rotation) & 31u));
+}
+
+inline uint32_t Xoshiro128Plus::NextUInt()
+{
+	uint32_t result = s[0] + s[3];
+	uint32_t t = s[1] << 9;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = (s[3] << 11) | (s[3] >> 21);
+
+	return result;
+}
+
@@ -0,0 +1,68 @@
+#include "RayPacket.h"
+
+#include <algorithm>
+
+void RayPacket::Prepare()
+{
+	for (int axis = 0; axis < 3; axis++) {
+		originMin[axis] = inverseDirectionMin[axis] = +infinity;
+		originMax[axis] = inverseDirectionMax[axis] = -infinity;
+	}
+
+	hasCommonSigns = count > 0;
+	for (int i = 0; i < count; i++) {
+		const float origin[3] = { rays[i].Origin.x, rays[i].Origin.y, rays[i].Origin.z };
+		const float direction[3] = { rays[i].Direction.x, rays[i].Direction.y, rays[i].Direction.z };
+		float inverseDirection[3];
+
+		for (int axis = 0; axis < 3; axis++) {
+			inverseDirection[axis] = 1.0f / direction[axis];
+			origins[axis][i] = origin[axis];
+			inverseDirections[axis][i] = inverseDirection[axis];
+
+			originMin[axis] = std::min(originMin[axis], origin[axis]);
+			originMax[axis] = std::max(originMax[axis], origin[axis]);
+			inverseDirectionMin[axis] = std::min(inverseDirectionMin[axis], inverseDirection[axis]);
+			inverseDirectionMax[axis] = std::max(inverseDirectionMax[axis], inverseDirection[axis]);
+
+			// Axis-parallel rays give infinite inverse directions, which
+			// interval arithmetic can't bound
+			bool isNegative = direction[axis] < 0.0f;
+			if (direction[axis] == 0.0f || (i > 0 && isNegative != isDirectionNegative[axis]))
+				hasCommonSigns = false;
+			isDirectionNegative[axis] = isNegative;
+		}
+	}
+
+	for (int axis = 0; axis < 3; axis++) {
+		std::fill(origins[axis] + count, origins[axis] + MAX_RAYS, 0.0f);
+		std::fill(inverseDirections[axis] + count, inverseDirections[axis] + MAX_RAYS, 0.0f);
+	}
+}
+
+bool RayPacket::MayHitBox(const float _boundsMin[3], const float _boundsMax[3], float _tMin, float _tMax) const
+{
+	if (!hasCommonSigns)
+		return true;
+
+	for (int axis = 0; axis < 3; axis++) {
+		// Every ray enters the slab through the same plane and leaves through the other
+		float nearPlane = isDirectionNegative[axis] ? _boundsMax[axis] : _boundsMin[axis];
+		float farPlane = isDirectionNegative[axis] ? _boundsMin[axis] : _boundsMax[axis];
+
+		// Distances to each plane span these ranges over the packet's origins...
+		float nearLow = nearPlane - originMax[axis], nearHigh = nearPlane - originMin[axis];
+		float farLow = farPlane - originMax[axis], farHigh = farPlane - originMin[axis];
+
+		// ...so the earliest any ray enters and the latest any leaves are the
+		// extremes of those ranges times the range of inverse directions
+		float inverseLow = inverseDirectionMin[axis], inverseHigh = inverseDirectionMax[axis];
+		float earliestEntry = std::min(std::min(nearLow * inverseLow, nearLow * inverseHigh), std::min(nearHigh * inverseLow, nearHigh * inverseHigh));
+		float latestExit = std::max(std::max(farLow * inverseLow, farLow * inverseHigh), std::max(farHigh * inverseLow, farHigh * inverseHigh));
+
+		_tMin = std::max(_tMin, earliestEntry);
+		_tMax = std::min(_tMax, latestExit);
+	}
+
+	return _tMin <= _tMax;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "Helpers.h"
+
+// Up to 8x8 coherent rays, such as the camera rays through a block of
+// neighboring pixels, traced through the scene together. Besides the rays
+// themselves, it keeps the range their origins and inverse directions span
+// on each axis, so a whole packet can be culled against a box at once
+struct alignas(32) RayPacket {
+	static const int MAX_RAYS = 64;
+
+	Ray rays[MAX_RAYS];
+	int count = 0;
+
+	// Only valid after Prepare(). Each ray's origin and inverse direction,
+	// structure-of-arrays by axis so box tests can run over several rays
+	// at once. Entries past count are zero
+	alignas(32) float origins[3][MAX_RAYS];
+	alignas(32) float inverseDirections[3][MAX_RAYS];
+	float originMin[3], originMax[3];
+	float inverseDirectionMin[3], inverseDirectionMax[3];
+	// Whether every ray heads the same way along every axis. If not, or if
+	// any ray is parallel to an axis, the packet can't be culled as a whole
+	bool hasCommonSigns;
+	bool isDirectionNegative[3];
+
+	// Computes the per-ray and whole-packet data from the rays
+	void Prepare();
+
+	// Whether any ray in the packet might hit the box between _tMin and _tMax,
+	// found with interval arithmetic over the packet's ranges. False means
+	// every ray misses; true only means some ray may hit
+	bool MayHitBox(const float _boundsMin[3], const float _boundsMax[3], float _tMin, float _tMax) const;
+};
+
@@ -0,0 +1,119 @@
+#pragma once
+#include "SimdLanes.h"
+#include "VectorHelpers.h"
+
+// The warps from VectorHelpers.h on WIDTH points at once, giving exactly the
+// same results as long as the compiler doesn't fuse the scalar versions'
+// multiplies and adds, which /fp:precise doesn't. Inputs are in [-1,1),
+// like the scalar versions take
+template<int WIDTH>
+struct SampleWarps
+{
+	using Lanes = SimdLanes<WIDTH>;
+	using Float = typename Lanes::Float;
+
+	static Float SinQuarterPi(Float _x)
+	{
+		Float x2 = Lanes::Mul(_x, _x);
+		Float p = Lanes::Add(Lanes::Set1(1.0f / 120.0f), Lanes::Mul(x2, Lanes::Set1(-1.0f / 5040.0f)));
+		p = Lanes::Add(Lanes::Set1(-1.0f / 6.0f), Lanes::Mul(x2, p));
+		p = Lanes::Add(Lanes::Set1(1.0f), Lanes::Mul(x2, p));
+		return Lanes::Mul(_x, p);
+	}
+
+	static Float CosQuarterPi(Float _x)
+	{
+		Float x2 = Lanes::Mul(_x, _x);
+		Float p = Lanes::Add(Lanes::Set1(-1.0f / 720.0f), Lanes::Mul(x2, Lanes::Set1(1.0f / 40320.0f)));
+		p = Lanes::Add(Lanes::Set1(1.0f / 24.0f), Lanes::Mul(x2, p));
+		p = Lanes::Add(Lanes::Set1(-0.5f), Lanes::Mul(x2, p));
+		return Lanes::Add(Lanes::Set1(1.0f), Lanes::Mul(x2, p));
+	}
+
+	static void ConcentricDisk(Float _u, Float _v, Float& _x, Float& _y)
+	{
+		Float isUMajor = Lanes::Greater(Lanes::Abs(_u), Lanes::Abs(_v));
+		Float radius = Lanes::Select(isUMajor, _u, _v);
+		Float minor = Lanes::Select(isUMajor, _v, _u);
+		Float ratio = Lanes::Select(Lanes::NotEqual(radius, Lanes::Set1(0.0f)), Lanes::Div(minor, radius), Lanes::Set1(0.0f));
+		Float angle = Lanes::Mul(Lanes::Set1(pi / 4.0f), ratio);
+
+		Float cosine = CosQuarterPi(angle);
+		Float sine = SinQuarterPi(angle);
+		_x = Lanes::Mul(radius, Lanes::Select(isUMajor, cosine, sine));
+		_y = Lanes::Mul(radius, Lanes::Select(isUMajor, sine, cosine));
+	}
+
+	static void UniformSphere(Float _u, Float _v, Float& _x, Float& _y, Float& _z)
+	{
+		Float diskX, diskY;
+		ConcentricDisk(_u, _v, diskX, diskY);
+		Float radiusSquared = Lanes::Add(Lanes::Mul(diskX, diskX), Lanes::Mul(diskY, diskY));
+		Float scale = Lanes::Mul(Lanes::Set1(2.0f), Lanes::Sqrt(Lanes::Max(Lanes::Sub(Lanes::Set1(1.0f), radiusSquared), Lanes::Set1(0.0f))));
+		_x = Lanes::Mul(diskX, scale);
+		_y = Lanes::Mul(diskY, scale);
+		_z = Lanes::Sub(Lanes::Set1(1.0f), Lanes::Mul(Lanes::Set1(2.0f), radiusSquared));
+	}
+
+	static void CosineHemisphere(Float _u, Float _v, Float& _x, Float& _y, Float& _z)
+	{
+		ConcentricDisk(_u, _v, _x, _y);
+		Float radiusSquared = Lanes::Add(Lanes::Mul(_x, _x), Lanes::Mul(_y, _y));
+		_z = Lanes::Sqrt(Lanes::Max(Lanes::Sub(Lanes::Set1(1.0f), radiusSquared), Lanes::Set1(0.0f)));
+	}
+
+	// Batches over structure-of-arrays buffers of _count points; any left
+	// over past the last whole group of WIDTH go through the scalar warp
+
+	static void ConcentricDisk(const float* _u, const float* _v, float* _x, float* _y, size_t _count)
+	{
+		size_t i = 0;
+		for (; i + WIDTH <= _count; i += WIDTH) {
+			Float x, y;
+			ConcentricDisk(Lanes::LoadUnaligned(_u + i), Lanes::LoadUnaligned(_v + i), x, y);
+			Lanes::Store(_x + i, x);
+			Lanes::Store(_y + i, y);
+		}
+		for (; i < _count; i++) {
+			DirectX::XMFLOAT2 point = ConcentricSampleDisk(_u[i], _v[i]);
+			_x[i] = point.x;
+			_y[i] = point.y;
+		}
+	}
+
+	static void UniformSphere(const float* _u, const float* _v, float* _x, float* _y, float* _z, size_t _count)
+	{
+		size_t i = 0;
+		for (; i + WIDTH <= _count; i += WIDTH) {
+			Float x, y, z;
+			UniformSphere(Lanes::LoadUnaligned(_u + i), Lanes::LoadUnaligned(_v + i), x, y, z);
+			Lanes::Store(_x + i, x);
+			Lanes::Store(_y + i, y);
+			Lanes::Store(_z + i, z);
+		}
+		for (; i < _count; i++) {
+			DirectX::XMFLOAT3 point = UniformSampleSphere(_u[i], _v[i]);
+			_x[i] = point.x;
+			_y[i] = point.y;
+			_z[i] = point.z;
+		}
+	}
+
+	static void CosineHemisphere(const float* _u, const float* _v, float* _x, float* _y, float* _z, size_t _count)
+	{
+		size_t i = 0;
+		for (; i + WIDTH <= _count; i += WIDTH) {
+			Float x, y, z;
+			CosineHemisphere(Lanes::LoadUnaligned(_u + i), Lanes::LoadUnaligned(_v + i), x, y, z);
+			Lanes::Store(_x + i, x);
+			Lanes::Store(_y + i, y);
+			Lanes::Store(_z + i, z);
+		}
+		for (; i < _count; i++) {
+			DirectX::XMFLOAT3 point = CosineSampleHemisphere(_u[i], _v[i]);
+			_x[i] = point.x;
+			_y[i] = point.y;
+			_z[i] = point.z;
+		}
+	}
+};
@@ -0,0 +1,253 @@
+#include "Sampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include "Helpers.h"
+
+namespace
+{
+	// Largest float below 1
+	const float ONE_MINUS_EPSILON = 0x1.fffffep-1f;
+
+	// Bases for Halton dimensions, and the steps of the blue-noise
+	// sampler's sequences. Dimensions past the end wrap around
+	const uint32_t PRIMES[] = {
+		2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+		59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131,
+		137, 139, 149, 151, 157, 163, 167, 173, 179, 181, 191, 193, 197, 199, 211, 223,
+		227, 229, 233, 239, 241, 251, 257, 263, 269, 271, 277, 281, 283, 293, 307, 311
+	};
+	const uint32_t PRIME_COUNT = sizeof(PRIMES) / sizeof(PRIMES[0]);
+
+	// Maps 32 random bits to [0,1)
+	float BitsToFloat(uint32_t _bits)
+	{
+		return (_bits >> 8) * (1.0f / 16777216.0f);
+	}
+
+	uint32_t ReverseBits(uint32_t _x)
+	{
+		_x = ((_x >> 1) & 0x55555555u) | ((_x & 0x55555555u) << 1);
+		_x = ((_x >> 2) & 0x33333333u) | ((_x & 0x33333333u) << 2);
+		_x = ((_x >> 4) & 0x0f0f0f0fu) | ((_x & 0x0f0f0f0fu) << 4);
+		_x = ((_x >> 8) & 0x00ff00ffu) | ((_x & 0x00ff00ffu) << 8);
+		return (_x >> 16) | (_x << 16);
+	}
+
+	// Hash that only lets each bit depend on the bits below it, which
+	// makes it an Owen scramble when run on reversed bits
+	// (Laine and Karras, as improved by Burley)
+	uint32_t LaineKarrasPermutation(uint32_t _x, uint32_t _seed)
+	{
+		_x ^= _x * 0x3d20adeau;
+		_x += _seed;
+		_x *= (_seed >> 16) | 1u;
+		_x ^= _x * 0x05526c56u;
+		_x ^= _x * 0x53a22864u;
+		return _x;
+	}
+
+	// Owen scrambles the bits of a fixed-point number in [0,1)
+	uint32_t NestedUniformScramble(uint32_t _x, uint32_t _seed)
+	{
+		return ReverseBits(LaineKarrasPermutation(ReverseBits(_x), _seed));
+	}
+
+	// Second dimension of the Sobol sequence; the first is just the
+	// index's bits reversed
+	uint32_t SobolSecondDimension(uint32_t _index)
+	{
+		uint32_t result = 0;
+		for (uint32_t direction = 1u << 31; _index != 0; _index >>= 1, direction ^= direction >> 1) {
+			if (_index & 1u)
+				result ^= direction;
+		}
+		return result;
+	}
+
+	// Mirrors _index's base-_base digits about the radix point, passing each
+	// digit through a random affine permutation (d * a + c) mod _base of its
+	// own. Unscrambled, high bases' first few points all sit close to 0, and
+	// dimensions that share a pixel's samples end up correlated
+	float ScrambledRadicalInverse(uint32_t _base, uint32_t _index, uint32_t _seed)
+	{
+		// Zeros past the index's last digit are scrambled too, down to a float's precision
+		double result = 0.0;
+		double inverseBasePower = 1.0;
+		for (uint32_t digitIndex = 0; inverseBasePower > 1e-7; digitIndex++) {
+			uint32_t next = _index / _base;
+			uint32_t digit = _index - next * _base;
+			_index = next;
+
+			uint32_t hash = Random::Hash(_seed + digitIndex);
+			uint32_t scale = 1 + hash % (_base - 1);
+			uint32_t offset = (hash >> 16) % _base;
+			inverseBasePower /= _base;
+			result += ((uint64_t)digit * scale + offset) % _base * inverseBasePower;
+		}
+		return std::min((float)result, ONE_MINUS_EPSILON);
+	}
+
+	// Builds a _size x _size tiling blue-noise mask by void-and-cluster
+	// (Ulichney): each pixel's rank is the order it was switched on in, always
+	// picking the spot furthest from every pixel on so far
+	std::vector<float> BuildBlueNoiseMask(unsigned int _size)
+	{
+		const unsigned int pixelCount = _size * _size;
+		const float sigma = 1.5f;
+
+		// How much a pixel on at (0, 0) crowds each other pixel, wrapping around
+		std::vector<float> falloff(pixelCount);
+		for (unsigned int y = 0; y < _size; y++) {
+			for (unsigned int x = 0; x < _size; x++) {
+				float dx = (float)std::min(x, _size - x);
+				float dy = (float)std::min(y, _size - y);
+				falloff[y * _size + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+			}
+		}
+
+		std::vector<float> energy(pixelCount, 0.0f);
+		std::vector<bool> isOn(pixelCount, false);
+		auto toggle = [&](unsigned int _pixel, bool _isOn) {
+			isOn[_pixel] = _isOn;
+			float sign = _isOn ? 1.0f : -1.0f;
+			unsigned int px = _pixel % _size;
+			unsigned int py = _pixel / _size;
+			for (unsigned int y = 0; y < _size; y++) {
+				unsigned int dy = (y + _size - py) % _size;
+				for (unsigned int x = 0; x < _size; x++) {
+					energy[y * _size + x] += sign * falloff[dy * _size + (x + _size - px) % _size];
+				}
+			}
+		};
+		// Most crowded pixel that's on, or least crowded pixel that's off
+		auto tightestCluster = [&]() {
+			unsigned int best = 0;
+			float bestEnergy = -infinity;
+			for (unsigned int i = 0; i < pixelCount; i++) {
+				if (isOn[i] && energy[i] > bestEnergy) { best = i; bestEnergy = energy[i]; }
+			}
+			return best;
+		};
+		auto largestVoid = [&]() {
+			unsigned int best = 0;
+			float bestEnergy = infinity;
+			for (unsigned int i = 0; i < pixelCount; i++) {
+				if (!isOn[i] && energy[i] < bestEnergy) { best = i; bestEnergy = energy[i]; }
+			}
+			return best;
+		};
+
+		// Start from a tenth of the pixels, scattered at random, then move the
+		// most crowded into the emptiest spots until that stops changing anything
+		unsigned int initialCount = pixelCount / 10;
+		for (uint32_t placed = 0, attempt = 0; placed < initialCount; attempt++) {
+			unsigned int pixel = Random::Hash(attempt) % pixelCount;
+			if (!isOn[pixel]) {
+				toggle(pixel, true);
+				placed++;
+			}
+		}
+		for (unsigned int i = 0; i < pixelCount; i++) {
+			unsigned int cluster = tightestCluster();
+			toggle(cluster, false);
+			unsigned int emptiest = largestVoid();
+			toggle(emptiest, true);
+			if (emptiest == cluster)
+				break;
+		}
+		std::vector<bool> initialPattern = isOn;
+		std::vector<float> initialEnergy = energy;
+
+		// Rank the initial pixels by taking the most crowded away first...
+		std::vector<unsigned int> ranks(pixelCount);
+		for (unsigned int rank = initialCount; rank > 0; rank--) {
+			unsigned int cluster = tightestCluster();
+			toggle(cluster, false);
+			ranks[cluster] = rank - 1;
+		}
+
+		// ...then the rest by filling the emptiest spots first
+		isOn = initialPattern;
+		energy = initialEnergy;
+		for (unsigned int rank = initialCount; rank < pixelCount; rank++) {
+			unsigned int emptiest = largestVoid();
+			toggle(emptiest, true);
+			ranks[emptiest] = rank;
+		}
+
+		std::vector<float> mask(pixelCount);
+		for (unsigned int i = 0; i < pixelCount; i++) {
+			mask[i] = (ranks[i] + 0.5f) / pixelCount;
+		}
+		return mask;
+	}
+}
+
+std::shared_ptr<Sampler> Sampler::Create(SamplerType _type)
+{
+	switch (_type) {
+	case SamplerType::Sobol:
+		return std::make_shared<SobolSampler>();
+	case SamplerType::Halton:
+		return std::make_shared<HaltonSampler>();
+	case SamplerType::BlueNoise:
+		return std::make_shared<BlueNoiseSampler>();
+	case SamplerType::Independent:
+	default:
+		return nullptr;
+	}
+}
+
+float SobolSampler::Get1D(uint32_t _pixelIndex, uint32_t _sampleIndex, uint32_t _dimension) const
+{
+	// Dimensions are paired off into 2D Sobol points. Each pixel and pair
+	// gets its own shuffle of the sample order and its own scramble, so
+	// pairs aren't correlated with each other but every power-of-two
+	// prefix of a pixel's samples stays stratified
+	uint32_t pair = _dimension >> 1;
+	uint32_t seed = Random::Hash(Random::Hash(Random::Seed + _pixelIndex) + pair * 0x9e3779b9u);
+	uint32_t index = NestedUniformScramble(_sampleIndex, seed);
+
+	uint32_t bits = (_dimension & 1u) ? SobolSecondDimension(index) : ReverseBits(index);
+	return BitsToFloat(NestedUniformScramble(bits, Random::Hash(seed + 1 + (_dimension & 1u))));
+}
+
+float HaltonSampler::Get1D(uint32_t _pixelIndex, uint32_t _sampleIndex, uint32_t _dimension) const
+{
+	// Each pixel scrambles each dimension's digits its own way, so
+	// neighbours don't repeat the same pattern
+	uint32_t seed = Random::Hash(Random::Hash(Random::Seed + _pixelIndex) + _dimension * 0x9e3779b9u);
+	return ScrambledRadicalInverse(PRIMES[_dimension % PRIME_COUNT], _sampleIndex, seed);
+}
+
+BlueNoiseSampler::BlueNoiseSampler() :
+	mask(BuildBlueNoiseMask(MASK_SIZE)),
+	imageWidth(MASK_SIZE)
+{
+}
+
+float BlueNoiseSampler::Get1D(uint32_t _pixelIndex, uint32_t _sampleIndex, uint32_t _dimension) const
+{
+	// Each dimension reads the tiled mask shifted by its own offset
+	uint32_t shift = Random::Hash(Random::Seed + _dimension * 0x9e3779b9u);
+	uint32_t x = (_pixelIndex % imageWidth + shift) % MASK_SIZE;
+	uint32_t y = (_pixelIndex / imageWidth + (shift >> 16)) % MASK_SIZE;
+
+	// Steps through the samples by the fractional part of the dimension's
+	// prime's square root, starting from the pixel's mask value
+	double root = std::sqrt((double)PRIMES[_dimension % PRIME_COUNT]);
+	double value = mask[y * MASK_SIZE + x] + _sampleIndex * (root - std::floor(root));
+	return std::min((float)(value - std::floor(value)), ONE_MINUS_EPSILON);
+}
+
+void BlueNoiseSampler::SetImageWidth(unsigned int _width)
+{
+	imageWidth = _width > 0 ? _width : 1;
+}
+
+float Random::NextSampledFloat()
+{
+	RandomThreadState& state = ThreadState;
+	return ActiveSampler->Get1D(state.pixelIndex, state.sampleIndex, state.dimension++);
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Random.h"
+
+// Where each sample's numbers come from
+enum class SamplerType
+{
+	// Independent numbers from Random::Mode's generator
+	Independent,
+	// 2D Sobol points, Owen scrambled and shuffled per pixel and dimension pair
+	Sobol,
+	// Halton points, rotated per pixel and dimension
+	Halton,
+	// A Kronecker sequence per dimension, offset by a blue-noise mask
+	// so neighbouring pixels' errors are spread apart
+	BlueNoise
+};
+
+// Hands out the numbers for each dimension of each pixel sample, so a
+// pixel's samples can cover their domain more evenly than independent
+// numbers do. Dimensions are laid out by Random::BeginSample() and
+// Random::BeginBounce(): the pixel offset, then the lens, then a fixed
+// number per bounce
+class Sampler
+{
+public:
+	virtual ~Sampler() = default;
+
+	// Returns a number in [0,1) for one dimension of one pixel sample
+	virtual float Get1D(uint32_t _pixelIndex, uint32_t _sampleIndex, uint32_t _dimension) const = 0;
+
+	// Lets samplers that care where pixels are in the image find them
+	virtual void SetImageWidth(unsigned int _width) {}
+
+	// Makes a sampler of the given type, or null for independent numbers
+	static std::shared_ptr<Sampler> Create(SamplerType _type);
+};
+
+class SobolSampler : public Sampler
+{
+public:
+	float Get1D(uint32_t _pixelIndex, uint32_t _sampleIndex, uint32_t _dimension) const override;
+};
+
+class HaltonSampler : public Sampler
+{
+public:
+	float Get1D(uint32_t _pixelIndex, uint32_t _sampleIndex, uint32_t _dimension) const override;
+};
+
+class BlueNoiseSampler : public Sampler
+{
+public:
+	// Builds the blue-noise mask, which takes a moment
+	BlueNoiseSampler();
+
+	float Get1D(uint32_t _pixelIndex, uint32_t _sampleIndex, uint32_t _dimension) const override;
+	void SetImageWidth(unsigned int _width) override;
+
+	// Width and height of the tiled mask
+	static const unsigned int MASK_SIZE = 64;
+
+private:
+	// Each pixel's rank in the mask, scaled to [0,1)
+	std::vector<float> mask;
+	unsigned int imageWidth;
+};
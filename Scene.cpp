@@ -0,0 +1,168 @@
+#include "Scene.h"
+
+#include <chrono>
+#include <cstdio>
+#include "BVH.h"
+#include "LBVHBuilder.h"
+#include "WideBVH.h"
+
+Scene::Scene(std::shared_ptr<ThreadPool> _threadPool) :
+	threadPool(_threadPool),
+	lights(make_shared<LightList>()),
+	acceleratorType(SceneAccelerator::BVH),
+	batchSpheres(false),
+	rebuildThreshold(1.5f),
+	haveObjectsMoved(false),
+	needsRebuild(true)
+{
+}
+
+void Scene::Add(shared_ptr<Hittable> _object)
+{
+	objects.Add(_object);
+	needsRebuild = true;
+}
+
+const HittableList& Scene::GetObjects() const { return objects; }
+
+MaterialIndex Scene::AddMaterial(shared_ptr<Material> _material)
+{
+	return materials.Add(_material);
+}
+
+const MaterialTable& Scene::GetMaterials() const { return materials; }
+
+SceneAccelerator Scene::GetAccelerator() const { return acceleratorType; }
+
+void Scene::SetAccelerator(SceneAccelerator _accelerator)
+{
+	acceleratorType = _accelerator;
+	Rebuild();
+}
+
+float Scene::GetRebuildThreshold() const { return rebuildThreshold; }
+void Scene::SetRebuildThreshold(float _threshold) { rebuildThreshold = _threshold > 1.0f ? _threshold : 1.0f; }
+
+bool Scene::GetSphereBatching() const { return batchSpheres; }
+
+void Scene::SetSphereBatching(bool _batchSpheres)
+{
+	batchSpheres = _batchSpheres;
+	Rebuild();
+}
+
+void Scene::MarkObjectsMoved()
+{
+	haveObjectsMoved = true;
+}
+
+void Scene::Update()
+{
+	if (needsRebuild) {
+		Rebuild();
+		return;
+	}
+
+	if (!haveObjectsMoved)
+		return;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	haveObjectsMoved = false;
+	lastUpdateStats.wasRefit = false;
+	lastUpdateStats.wasRebuilt = false;
+
+	// Lights read their spheres live, but the light BVH keeps its own bounds
+	if (lights->GetCount() > 0)
+		lights->Refit();
+
+	// A plain list has nothing to update, but a batch holds copies of its spheres
+	if (!refittableAccelerator) {
+		if (sphereBatch)
+			sphereBatch->Sync();
+		lastUpdateStats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		return;
+	}
+
+	refittableAccelerator->Refit();
+	lastUpdateStats.wasRefit = true;
+	lastUpdateStats.sahCost = refittableAccelerator->ComputeSAHCost();
+
+	// Refitting keeps the tree's shape, so boxes stretch as objects drift
+	// apart. Once that's made tracing too much more expensive, start over
+	if (lastUpdateStats.sahCost > lastUpdateStats.builtSAHCost * rebuildThreshold) {
+		Rebuild();
+		return;
+	}
+
+	lastUpdateStats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+const Hittable& Scene::GetHittable() const
+{
+	return *accelerator;
+}
+
+std::shared_ptr<const LightList> Scene::GetLights() const { return lights; }
+
+const SceneUpdateStats& Scene::GetLastUpdateStats() const { return lastUpdateStats; }
+
+void Scene::Rebuild()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	refittableAccelerator = nullptr;
+	sphereBatch = nullptr;
+
+	// Trees are built over batches of spheres rather than single ones
+	HittableList clusters;
+	if (batchSpheres && acceleratorType != SceneAccelerator::List)
+		clusters = SphereBatch::Cluster(objects);
+	const HittableList& primitives = clusters.objects.empty() ? objects : clusters;
+
+	switch (acceleratorType) {
+	case SceneAccelerator::List:
+		if (batchSpheres) {
+			sphereBatch = make_shared<SphereBatch>(objects);
+			accelerator = sphereBatch;
+		}
+		else {
+			accelerator = make_shared<HittableList>(objects);
+		}
+		break;
+	case SceneAccelerator::BVH4:
+		refittableAccelerator = make_shared<BVH4>(primitives);
+		break;
+	case SceneAccelerator::LBVH:
+	{
+		LBVHBuilder builder(threadPool);
+		refittableAccelerator = builder.Build(primitives);
+		break;
+	}
+	case SceneAccelerator::BVH8:
+#if defined(__AVX2__)
+		refittableAccelerator = make_shared<BVH8>(primitives);
+		break;
+#else
+		// 8-wide nodes need AVX2; fall back to the binary tree
+		printf("BVH8 needs an AVX2 build, using BVH\n");
+		acceleratorType = SceneAccelerator::BVH;
+		[[fallthrough]];
+#endif
+	case SceneAccelerator::BVH:
+	default:
+		refittableAccelerator = make_shared<BVH>(primitives);
+		break;
+	}
+
+	if (refittableAccelerator)
+		accelerator = refittableAccelerator;
+
+	lights->Build(objects, materials);
+
+	haveObjectsMoved = false;
+	needsRebuild = false;
+	lastUpdateStats.wasRefit = false;
+	lastUpdateStats.wasRebuilt = true;
+	lastUpdateStats.sahCost = refittableAccelerator ? refittableAccelerator->ComputeSAHCost() : 0.0f;
+	lastUpdateStats.builtSAHCost = lastUpdateStats.sahCost;
+	lastUpdateStats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <memory>
+#include "AccelerationStructure.h"
+#include "HittableList.h"
+#include "LightList.h"
+#include "MaterialTable.h"
+#include "SphereBatch.h"
+#include "ThreadPool.h"
+
+// Structures that can accelerate ray queries against a scene
+enum class SceneAccelerator {
+	List,
+	BVH,
+	BVH4,
+	BVH8,
+	LBVH
+};
+
+// What the last Scene::Update() did to keep the accelerator current
+struct SceneUpdateStats {
+	bool wasRefit = false;
+	bool wasRebuilt = false;
+	double seconds = 0.0;
+	// SAH cost after the update, and when the accelerator was last built
+	float sahCost = 0.0f;
+	float builtSAHCost = 0.0f;
+};
+
+// The objects in the world and the structure rays are traced against.
+// Objects can move between frames: mark them as moved, then call Update()
+// once per frame before rendering. Update() refits the accelerator in place,
+// and rebuilds it from scratch once refitting has let its SAH cost grow past
+// the rebuild threshold
+class Scene
+{
+public:
+	// LBVH builds run on _threadPool
+	Scene(std::shared_ptr<ThreadPool> _threadPool);
+
+	void Add(shared_ptr<Hittable> _object);
+	const HittableList& GetObjects() const;
+
+	// Adds a material to the scene's table and returns its index
+	MaterialIndex AddMaterial(shared_ptr<Material> _material);
+	const MaterialTable& GetMaterials() const;
+
+	SceneAccelerator GetAccelerator() const;
+	// Switches accelerator, building the new one right away
+	void SetAccelerator(SceneAccelerator _accelerator);
+
+	float GetRebuildThreshold() const;
+	// Rebuild once SAH cost reaches this multiple of its cost when built
+	void SetRebuildThreshold(float _threshold);
+
+	bool GetSphereBatching() const;
+	// Packs spheres into SphereBatches, rebuilding right away. A plain list
+	// becomes one batch; trees get batches of nearby spheres as leaves
+	void SetSphereBatching(bool _batchSpheres);
+
+	// Tells the scene objects moved since the last update
+	void MarkObjectsMoved();
+	// Brings the accelerator up to date with the objects. Call after any
+	// objects move and before Camera::Render
+	void Update();
+
+	// What rays should be traced against
+	const Hittable& GetHittable() const;
+	// The emissive spheres among the objects, found again whenever the
+	// accelerator is rebuilt. The list stays the same object throughout
+	std::shared_ptr<const LightList> GetLights() const;
+	const SceneUpdateStats& GetLastUpdateStats() const;
+
+private:
+	std::shared_ptr<ThreadPool> threadPool;
+
+	HittableList objects;
+	MaterialTable materials;
+	shared_ptr<LightList> lights;
+	SceneAccelerator acceleratorType;
+	// Whatever rays are traced against; a copy of the list in List mode
+	shared_ptr<Hittable> accelerator;
+	// The same structure, when it can be refit; null in List mode
+	shared_ptr<AccelerationStructure> refittableAccelerator;
+	// The same batch, in List mode with sphere batching on
+	shared_ptr<SphereBatch> sphereBatch;
+	bool batchSpheres;
+
+	float rebuildThreshold;
+	bool haveObjectsMoved;
+	bool needsRebuild;
+	SceneUpdateStats lastUpdateStats;
+
+	// Builds the selected accelerator over the objects
+	void Rebuild();
+};
+
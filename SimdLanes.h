@@ -0,0 +1,56 @@
+#pragma once
+#include <immintrin.h>
+
+// Thin wrappers over the SIMD instructions shared by 4- and 8-wide code.
+// Max and Min return their second argument when the first is NaN,
+// so passing the running interval second keeps NaNs out of it
+template<int WIDTH> struct SimdLanes;
+
+template<> struct SimdLanes<4>
+{
+	using Float = __m128;
+	static Float Load(const float* _p) { return _mm_load_ps(_p); }
+	static void Store(float* _p, Float _v) { _mm_storeu_ps(_p, _v); }
+	static Float Set1(float _v) { return _mm_set1_ps(_v); }
+	static Float Sub(Float _a, Float _b) { return _mm_sub_ps(_a, _b); }
+	static Float Mul(Float _a, Float _b) { return _mm_mul_ps(_a, _b); }
+	static Float Min(Float _a, Float _b) { return _mm_min_ps(_a, _b); }
+	static Float Max(Float _a, Float _b) { return _mm_max_ps(_a, _b); }
+	static int LessEqualMask(Float _a, Float _b) { return _mm_movemask_ps(_mm_cmple_ps(_a, _b)); }
+
+	static Float LoadUnaligned(const float* _p) { return _mm_loadu_ps(_p); }
+	static Float Add(Float _a, Float _b) { return _mm_add_ps(_a, _b); }
+	static Float Div(Float _a, Float _b) { return _mm_div_ps(_a, _b); }
+	static Float Sqrt(Float _v) { return _mm_sqrt_ps(_v); }
+	static Float Abs(Float _v) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), _v); }
+	// All bits set in lanes where the comparison holds
+	static Float Greater(Float _a, Float _b) { return _mm_cmpgt_ps(_a, _b); }
+	static Float NotEqual(Float _a, Float _b) { return _mm_cmpneq_ps(_a, _b); }
+	// _a in lanes where _mask is set, otherwise _b; SSE2 has no blend
+	static Float Select(Float _mask, Float _a, Float _b) { return _mm_or_ps(_mm_and_ps(_mask, _a), _mm_andnot_ps(_mask, _b)); }
+};
+
+#if defined(__AVX2__)
+template<> struct SimdLanes<8>
+{
+	using Float = __m256;
+	static Float Load(const float* _p) { return _mm256_load_ps(_p); }
+	static void Store(float* _p, Float _v) { _mm256_storeu_ps(_p, _v); }
+	static Float Set1(float _v) { return _mm256_set1_ps(_v); }
+	static Float Sub(Float _a, Float _b) { return _mm256_sub_ps(_a, _b); }
+	static Float Mul(Float _a, Float _b) { return _mm256_mul_ps(_a, _b); }
+	static Float Min(Float _a, Float _b) { return _mm256_min_ps(_a, _b); }
+	static Float Max(Float _a, Float _b) { return _mm256_max_ps(_a, _b); }
+	static int LessEqualMask(Float _a, Float _b) { return _mm256_movemask_ps(_mm256_cmp_ps(_a, _b, _CMP_LE_OQ)); }
+
+	static Float LoadUnaligned(const float* _p) { return _mm256_loadu_ps(_p); }
+	static Float Add(Float _a, Float _b) { return _mm256_add_ps(_a, _b); }
+	static Float Div(Float _a, Float _b) { return _mm256_div_ps(_a, _b); }
+	static Float Sqrt(Float _v) { return _mm256_sqrt_ps(_v); }
+	static Float Abs(Float _v) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), _v); }
+	static Float Greater(Float _a, Float _b) { return _mm256_cmp_ps(_a, _b, _CMP_GT_OQ); }
+	static Float NotEqual(Float _a, Float _b) { return _mm256_cmp_ps(_a, _b, _CMP_NEQ_UQ); }
+	static Float Select(Float _mask, Float _a, Float _b) { return _mm256_blendv_ps(_b, _a, _mask); }
+};
+#endif
+
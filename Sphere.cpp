@@ -2,45 +2,27 @@
 
 using namespace DirectX;
 
-bool Sphere::Hit(const Ray& _ray, Interval _rayT, HitRecord& _record) const
+bool Sphere::Intersect(const Ray& _ray, Interval _rayT, RayHit& _hit) const
 {
-	// Load relevant data
-	XMVECTOR vecSphereOri = XMLoadFloat3(&origin);
-	XMVECTOR vecRayOri = XMLoadFloat3(&_ray.Origin);
-	XMVECTOR vecRayDir = XMLoadFloat3(&_ray.Direction);
+	if (!IntersectGeometry(origin, radius, _ray, _rayT, _hit.t))
+		return false;
 
-	// Find vector from ray's origin to sphere's center
-	XMVECTOR rayToSphere = vecSphereOri - vecRayOri;
-
-	// Calculate ray-sphere intersection
-	float a, h, c;
-
-	XMStoreFloat(&a, XMVector3LengthSq(vecRayDir));
-	XMStoreFloat(&h, XMVector3Dot(vecRayDir, rayToSphere));
-	XMStoreFloat(&c, XMVector3LengthSq(rayToSphere));
-	c -= radius * radius;
-
-	float discriminant = (h * h) - (a * c);
-
-	if (discriminant < 0) return false;
-
-	float sqrtd = sqrt(discriminant);
+	_hit.primitive = this;
+	return true;
+}
 
-	// Find nearest root of the equation in an acceptable range
-	float root = (h - sqrtd) / a;
-	if (!_rayT.Surrounds(root)) {
-		root = (h + sqrtd) / a;
-		if (!_rayT.Surrounds(root)) {
-			return false;
-		}
-	}
+bool Sphere::Occluded(const Ray& _ray, Interval _rayT) const
+{
+	float t;
+	return IntersectGeometry(origin, radius, _ray, _rayT, t);
+}
 
+void Sphere::GetSurfaceInteraction(const Ray& _ray, const RayHit& _hit, HitRecord& _record) const
+{
 	// Build hit record
-	_record.t = root;
-	XMVECTOR hitPoint = _ray.At(root);
+	_record.t = _hit.t;
+	XMVECTOR hitPoint = _ray.At(_hit.t);
 	XMStoreFloat3(&_record.point, hitPoint);
-	_record.SetFaceNormal(vecRayDir, XMVectorScale(hitPoint - vecSphereOri, 1.0f / radius));
+	_record.SetFaceNormal(XMLoadFloat3(&_ray.Direction), XMVectorScale(hitPoint - XMLoadFloat3(&origin), 1.0f / radius));
 	_record.material = material;
-
-	return true;
 }
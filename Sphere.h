@@ -1,20 +1,78 @@
 #pragma once
 #include "Hittable.h"
-#include "Material.h"
 
 class Sphere :
 	public Hittable
 {
 public:
-	Sphere(DirectX::XMFLOAT3 _origin, float _radius, std::shared_ptr<Material> _material) :
-		origin(_origin),
+	Sphere(DirectX::XMFLOAT3 _origin, float _radius, MaterialIndex _material) :
 		radius(fmax(0.0f, _radius)),
 		material(_material)
-	{}
-	bool Hit(const Ray& _ray, Interval _rayT, HitRecord& _record) const override;
+	{
+		SetOrigin(_origin);
+	}
+	bool Intersect(const Ray& _ray, Interval _rayT, RayHit& _hit) const override;
+	bool Occluded(const Ray& _ray, Interval _rayT) const override;
+	void GetSurfaceInteraction(const Ray& _ray, const RayHit& _hit, HitRecord& _record) const override;
+	AABB BoundingBox() const override { return boundingBox; }
+
+	DirectX::XMFLOAT3 GetOrigin() const { return origin; }
+	// Moves the sphere. Anything built over it needs refitting afterwards
+	void SetOrigin(DirectX::XMFLOAT3 _origin)
+	{
+		origin = _origin;
+
+		DirectX::XMFLOAT3 extent(radius, radius, radius);
+		DirectX::XMFLOAT3 corner1, corner2;
+		DirectX::XMStoreFloat3(&corner1, DirectX::XMLoadFloat3(&origin) - DirectX::XMLoadFloat3(&extent));
+		DirectX::XMStoreFloat3(&corner2, DirectX::XMLoadFloat3(&origin) + DirectX::XMLoadFloat3(&extent));
+		boundingBox = AABB(corner1, corner2);
+	}
+	float GetRadius() const { return radius; }
+	MaterialIndex GetMaterial() const { return material; }
+
+	// Finds the nearest distance in _rayT at which a ray meets a sphere.
+	// Defined here so closed-set dispatch can inline it into traversal loops
+	static bool IntersectGeometry(const DirectX::XMFLOAT3& _origin, float _radius, const Ray& _ray, Interval _rayT, float& _t)
+	{
+		// Load relevant data
+		DirectX::XMVECTOR vecSphereOri = DirectX::XMLoadFloat3(&_origin);
+		DirectX::XMVECTOR vecRayOri = DirectX::XMLoadFloat3(&_ray.Origin);
+		DirectX::XMVECTOR vecRayDir = DirectX::XMLoadFloat3(&_ray.Direction);
+
+		// Find vector from ray's origin to sphere's center
+		DirectX::XMVECTOR rayToSphere = DirectX::XMVectorSubtract(vecSphereOri, vecRayOri);
+
+		// Calculate ray-sphere intersection
+		float a, h, c;
+
+		DirectX::XMStoreFloat(&a, DirectX::XMVector3LengthSq(vecRayDir));
+		DirectX::XMStoreFloat(&h, DirectX::XMVector3Dot(vecRayDir, rayToSphere));
+		DirectX::XMStoreFloat(&c, DirectX::XMVector3LengthSq(rayToSphere));
+		c -= _radius * _radius;
+
+		float discriminant = (h * h) - (a * c);
+
+		if (discriminant < 0) return false;
+
+		float sqrtd = sqrt(discriminant);
+
+		// Find nearest root of the equation in an acceptable range
+		float root = (h - sqrtd) / a;
+		if (!_rayT.Surrounds(root)) {
+			root = (h + sqrtd) / a;
+			if (!_rayT.Surrounds(root)) {
+				return false;
+			}
+		}
+
+		_t = root;
+		return true;
+	}
 private:
 	DirectX::XMFLOAT3 origin;
 	float radius;
-	shared_ptr<Material> material;
+	MaterialIndex material;
+	AABB boundingBox;
 };
 
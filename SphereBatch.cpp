@@ -0,0 +1,248 @@
+#include "SphereBatch.h"
+
+#include <bit>
+#include <cmath>
+#include <immintrin.h>
+#include <limits>
+#include "BVH.h"
+
+SphereBatch::SphereBatch(const HittableList& _list)
+{
+	for (const shared_ptr<Hittable>& object : _list.objects) {
+		shared_ptr<Sphere> sphere = std::dynamic_pointer_cast<Sphere>(object);
+		if (sphere)
+			spheres.push_back(sphere);
+		else
+			others.Add(object);
+	}
+
+	Sync();
+}
+
+SphereBatch::SphereBatch(std::vector<shared_ptr<Sphere>>&& _spheres) :
+	spheres(std::move(_spheres))
+{
+	Sync();
+}
+
+HittableList SphereBatch::Cluster(const HittableList& _list, size_t _batchSize)
+{
+	HittableList clustered;
+
+	// A BVH's primitive order keeps neighbors together, so consecutive
+	// runs of it make compact batches
+	BVH order(_list);
+	std::vector<shared_ptr<Sphere>> batch;
+	for (const shared_ptr<Hittable>& object : order.GetPrimitives()) {
+		shared_ptr<Sphere> sphere = std::dynamic_pointer_cast<Sphere>(object);
+		if (!sphere) {
+			clustered.Add(object);
+			continue;
+		}
+
+		batch.push_back(sphere);
+		if (batch.size() == _batchSize) {
+			clustered.Add(make_shared<SphereBatch>(std::move(batch)));
+			batch.clear();
+		}
+	}
+	if (!batch.empty())
+		clustered.Add(make_shared<SphereBatch>(std::move(batch)));
+
+	return clustered;
+}
+
+void SphereBatch::Sync()
+{
+	size_t paddedCount = (spheres.size() + LANE_COUNT - 1) / LANE_COUNT * LANE_COUNT;
+	centerX.assign(paddedCount, 0.0f);
+	centerY.assign(paddedCount, 0.0f);
+	centerZ.assign(paddedCount, 0.0f);
+	radius.assign(paddedCount, std::numeric_limits<float>::quiet_NaN());
+
+	boundingBox = others.BoundingBox();
+	for (size_t i = 0; i < spheres.size(); i++) {
+		DirectX::XMFLOAT3 origin = spheres[i]->GetOrigin();
+		centerX[i] = origin.x;
+		centerY[i] = origin.y;
+		centerZ[i] = origin.z;
+		radius[i] = spheres[i]->GetRadius();
+		boundingBox = AABB(boundingBox, spheres[i]->BoundingBox());
+	}
+}
+
+size_t SphereBatch::GetSphereCount() const
+{
+	return spheres.size();
+}
+
+bool SphereBatch::Intersect(const Ray& _ray, Interval _rayT, RayHit& _hit) const
+{
+	bool hasHitAnything = IntersectSpheres(_ray, _rayT, _hit);
+
+	if (!others.objects.empty()
+		&& others.Intersect(_ray, Interval(_rayT.minimum, hasHitAnything ? _hit.t : _rayT.maximum), _hit))
+		hasHitAnything = true;
+
+	return hasHitAnything;
+}
+
+bool SphereBatch::Occluded(const Ray& _ray, Interval _rayT) const
+{
+	return OccludedSpheres(_ray, _rayT) || (!others.objects.empty() && others.Occluded(_ray, _rayT));
+}
+
+#if defined(__AVX2__)
+bool SphereBatch::IntersectSpheres(const Ray& _ray, Interval _rayT, RayHit& _hit) const
+{
+	if (spheres.empty())
+		return false;
+
+	__m256 originX = _mm256_set1_ps(_ray.Origin.x);
+	__m256 originY = _mm256_set1_ps(_ray.Origin.y);
+	__m256 originZ = _mm256_set1_ps(_ray.Origin.z);
+	__m256 directionX = _mm256_set1_ps(_ray.Direction.x);
+	__m256 directionY = _mm256_set1_ps(_ray.Direction.y);
+	__m256 directionZ = _mm256_set1_ps(_ray.Direction.z);
+	float lengthSq = _ray.Direction.x * _ray.Direction.x + _ray.Direction.y * _ray.Direction.y + _ray.Direction.z * _ray.Direction.z;
+	__m256 a = _mm256_set1_ps(lengthSq);
+	__m256 tMin = _mm256_set1_ps(_rayT.minimum);
+
+	// Each lane keeps the closest root it has seen and which sphere it
+	// came from. Lanes only need reducing once every sphere is tested
+	__m256 closest = _mm256_set1_ps(_rayT.maximum);
+	__m256i closestIndex = _mm256_set1_epi32(-1);
+	__m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i indexStep = _mm256_set1_epi32((int)LANE_COUNT);
+
+	for (size_t i = 0; i < centerX.size(); i += LANE_COUNT) {
+		// Same quadratic as Sphere::IntersectGeometry, 8 spheres at a time
+		__m256 toCenterX = _mm256_sub_ps(_mm256_loadu_ps(&centerX[i]), originX);
+		__m256 toCenterY = _mm256_sub_ps(_mm256_loadu_ps(&centerY[i]), originY);
+		__m256 toCenterZ = _mm256_sub_ps(_mm256_loadu_ps(&centerZ[i]), originZ);
+		__m256 r = _mm256_loadu_ps(&radius[i]);
+
+		__m256 h = _mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(directionX, toCenterX), _mm256_mul_ps(directionY, toCenterY)), _mm256_mul_ps(directionZ, toCenterZ));
+		__m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(toCenterX, toCenterX), _mm256_mul_ps(toCenterY, toCenterY)), _mm256_mul_ps(toCenterZ, toCenterZ)),
+			_mm256_mul_ps(r, r));
+		__m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(h, h), _mm256_mul_ps(a, c));
+
+		// Misses, and padding's NaNs, fail this compare
+		__m256 hasRoots = _mm256_cmp_ps(discriminant, _mm256_setzero_ps(), _CMP_GE_OQ);
+		if (_mm256_movemask_ps(hasRoots) != 0) {
+			__m256 sqrtd = _mm256_sqrt_ps(_mm256_max_ps(discriminant, _mm256_setzero_ps()));
+			__m256 nearRoot = _mm256_div_ps(_mm256_sub_ps(h, sqrtd), a);
+			__m256 farRoot = _mm256_div_ps(_mm256_add_ps(h, sqrtd), a);
+
+			// Take the near root when it's in range, otherwise the far one
+			__m256 nearValid = _mm256_and_ps(_mm256_cmp_ps(nearRoot, tMin, _CMP_GT_OQ), _mm256_cmp_ps(nearRoot, closest, _CMP_LT_OQ));
+			__m256 farValid = _mm256_and_ps(_mm256_cmp_ps(farRoot, tMin, _CMP_GT_OQ), _mm256_cmp_ps(farRoot, closest, _CMP_LT_OQ));
+			__m256 root = _mm256_blendv_ps(farRoot, nearRoot, nearValid);
+			__m256 isCloser = _mm256_and_ps(hasRoots, _mm256_or_ps(nearValid, farValid));
+
+			closest = _mm256_blendv_ps(closest, root, isCloser);
+			closestIndex = _mm256_castps_si256(_mm256_blendv_ps(
+				_mm256_castsi256_ps(closestIndex), _mm256_castsi256_ps(index), isCloser));
+		}
+
+		index = _mm256_add_epi32(index, indexStep);
+	}
+
+	// Horizontal min: fold the halves, then pairs, then neighbors together
+	__m256 minimum = _mm256_min_ps(closest, _mm256_permute2f128_ps(closest, closest, 1));
+	minimum = _mm256_min_ps(minimum, _mm256_shuffle_ps(minimum, minimum, _MM_SHUFFLE(1, 0, 3, 2)));
+	minimum = _mm256_min_ps(minimum, _mm256_shuffle_ps(minimum, minimum, _MM_SHUFFLE(2, 3, 0, 1)));
+
+	// Any lane holding the minimum that found a hit names the closest sphere
+	int hitLanes = _mm256_movemask_ps(_mm256_and_ps(
+		_mm256_cmp_ps(closest, minimum, _CMP_EQ_OQ),
+		_mm256_castsi256_ps(_mm256_cmpgt_epi32(closestIndex, _mm256_set1_epi32(-1)))));
+	if (hitLanes == 0)
+		return false;
+
+	alignas(32) int indices[LANE_COUNT];
+	_mm256_store_si256((__m256i*)indices, closestIndex);
+	_hit.t = _mm256_cvtss_f32(minimum);
+	_hit.primitive = spheres[indices[std::countr_zero((unsigned int)hitLanes)]].get();
+	return true;
+}
+
+bool SphereBatch::OccludedSpheres(const Ray& _ray, Interval _rayT) const
+{
+	if (spheres.empty())
+		return false;
+
+	__m256 originX = _mm256_set1_ps(_ray.Origin.x);
+	__m256 originY = _mm256_set1_ps(_ray.Origin.y);
+	__m256 originZ = _mm256_set1_ps(_ray.Origin.z);
+	__m256 directionX = _mm256_set1_ps(_ray.Direction.x);
+	__m256 directionY = _mm256_set1_ps(_ray.Direction.y);
+	__m256 directionZ = _mm256_set1_ps(_ray.Direction.z);
+	float lengthSq = _ray.Direction.x * _ray.Direction.x + _ray.Direction.y * _ray.Direction.y + _ray.Direction.z * _ray.Direction.z;
+	__m256 a = _mm256_set1_ps(lengthSq);
+	__m256 tMin = _mm256_set1_ps(_rayT.minimum);
+	__m256 tMax = _mm256_set1_ps(_rayT.maximum);
+
+	for (size_t i = 0; i < centerX.size(); i += LANE_COUNT) {
+		// Same quadratic as IntersectSpheres, but any root in range ends the search
+		__m256 toCenterX = _mm256_sub_ps(_mm256_loadu_ps(&centerX[i]), originX);
+		__m256 toCenterY = _mm256_sub_ps(_mm256_loadu_ps(&centerY[i]), originY);
+		__m256 toCenterZ = _mm256_sub_ps(_mm256_loadu_ps(&centerZ[i]), originZ);
+		__m256 r = _mm256_loadu_ps(&radius[i]);
+
+		__m256 h = _mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(directionX, toCenterX), _mm256_mul_ps(directionY, toCenterY)), _mm256_mul_ps(directionZ, toCenterZ));
+		__m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(toCenterX, toCenterX), _mm256_mul_ps(toCenterY, toCenterY)), _mm256_mul_ps(toCenterZ, toCenterZ)),
+			_mm256_mul_ps(r, r));
+		__m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(h, h), _mm256_mul_ps(a, c));
+
+		__m256 hasRoots = _mm256_cmp_ps(discriminant, _mm256_setzero_ps(), _CMP_GE_OQ);
+		if (_mm256_movemask_ps(hasRoots) == 0)
+			continue;
+
+		__m256 sqrtd = _mm256_sqrt_ps(_mm256_max_ps(discriminant, _mm256_setzero_ps()));
+		__m256 nearRoot = _mm256_div_ps(_mm256_sub_ps(h, sqrtd), a);
+		__m256 farRoot = _mm256_div_ps(_mm256_add_ps(h, sqrtd), a);
+		__m256 nearValid = _mm256_and_ps(_mm256_cmp_ps(nearRoot, tMin, _CMP_GT_OQ), _mm256_cmp_ps(nearRoot, tMax, _CMP_LT_OQ));
+		__m256 farValid = _mm256_and_ps(_mm256_cmp_ps(farRoot, tMin, _CMP_GT_OQ), _mm256_cmp_ps(farRoot, tMax, _CMP_LT_OQ));
+		if (_mm256_movemask_ps(_mm256_and_ps(hasRoots, _mm256_or_ps(nearValid, farValid))) != 0)
+			return true;
+	}
+
+	return false;
+}
+#else
+bool SphereBatch::IntersectSpheres(const Ray& _ray, Interval _rayT, RayHit& _hit) const
+{
+	// Without AVX2, test the copied spheres one at a time
+	bool hasHitAnything = false;
+	float closestSoFar = _rayT.maximum;
+
+	for (size_t i = 0; i < spheres.size(); i++) {
+		float t;
+		if (Sphere::IntersectGeometry(DirectX::XMFLOAT3(centerX[i], centerY[i], centerZ[i]), radius[i],
+			_ray, Interval(_rayT.minimum, closestSoFar), t)) {
+			hasHitAnything = true;
+			closestSoFar = t;
+			_hit.t = t;
+			_hit.primitive = spheres[i].get();
+		}
+	}
+
+	return hasHitAnything;
+}
+
+bool SphereBatch::OccludedSpheres(const Ray& _ray, Interval _rayT) const
+{
+	float t;
+	for (size_t i = 0; i < spheres.size(); i++) {
+		if (Sphere::IntersectGeometry(DirectX::XMFLOAT3(centerX[i], centerY[i], centerZ[i]), radius[i], _ray, _rayT, t))
+			return true;
+	}
+
+	return false;
+}
+#endif
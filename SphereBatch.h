@@ -0,0 +1,55 @@
+#pragma once
+#include "Hittable.h"
+
+#include <vector>
+#include "Helpers.h"
+#include "HittableList.h"
+#include "Sphere.h"
+
+// Many spheres tested together. Centers and radii are copied out of the
+// Spheres into structure-of-arrays form, so with AVX2 one ray is tested
+// against 8 spheres per step, and the closest root is found with a
+// horizontal min once all of them have been tested. Hits still report the
+// original Sphere, so its surface is evaluated as usual.
+// Works as a faster stand-in for a large HittableList, and, through
+// Cluster(), as the leaves of a BVH
+class SphereBatch final :
+	public Hittable
+{
+public:
+	// Spheres tested per SIMD step
+	static const size_t LANE_COUNT = 8;
+
+	// Batches every Sphere in the list. Anything that isn't a Sphere is kept
+	// and tested one at a time, so the batch can replace the list outright
+	SphereBatch(const HittableList& _list);
+	SphereBatch(std::vector<shared_ptr<Sphere>>&& _spheres);
+
+	// Groups a list's Spheres into batches of nearby spheres, each batch up
+	// to _batchSize, for a BVH to be built over. Anything else is copied as is
+	static HittableList Cluster(const HittableList& _list, size_t _batchSize = LANE_COUNT);
+
+	bool Intersect(const Ray& _ray, Interval _rayT, RayHit& _hit) const override;
+	bool Occluded(const Ray& _ray, Interval _rayT) const override;
+	AABB BoundingBox() const override { return boundingBox; }
+
+	// Copies the spheres' current centers and radii again, after they move
+	void Sync();
+
+	size_t GetSphereCount() const;
+
+private:
+	std::vector<shared_ptr<Sphere>> spheres;
+	// One entry per sphere, padded to a whole number of SIMD steps. Padding
+	// has a NaN radius, which no ray can hit
+	std::vector<float> centerX, centerY, centerZ, radius;
+	// Whatever in the list wasn't a Sphere
+	HittableList others;
+	AABB boundingBox;
+
+	// Closest hit among the batched spheres
+	bool IntersectSpheres(const Ray& _ray, Interval _rayT, RayHit& _hit) const;
+	// Whether any batched sphere is hit, stopping at the first SIMD step that finds one
+	bool OccludedSpheres(const Ray& _ray, Interval _rayT) const;
+};
+
@@ -0,0 +1,180 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int _threadCount) :
+	nextQueue(0),
+	queuedTasks(0),
+	pendingTasks(0),
+	isStopping(false)
+{
+	// Always keep at least one worker so submitted tasks can run
+	if (_threadCount == 0) _threadCount = 1;
+
+	// Create every deque before any worker can try to steal from it
+	queues.reserve(_threadCount);
+	for (unsigned int i = 0; i < _threadCount; i++) {
+		queues.push_back(std::make_unique<WorkerQueue>());
+	}
+
+	workers.reserve(_threadCount);
+	for (unsigned int i = 0; i < _threadCount; i++) {
+		workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	// Let workers finish what they have, then wake them to exit
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		isStopping = true;
+	}
+	taskAvailable.notify_all();
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+unsigned int ThreadPool::GetThreadCount() const
+{
+	return (unsigned int)workers.size();
+}
+
+void ThreadPool::Submit(std::function<void()> _task)
+{
+	// Only the submitting thread touches nextQueue
+	WorkerQueue& queue = *queues[nextQueue];
+	nextQueue = (nextQueue + 1) % (unsigned int)queues.size();
+
+	// Count the task before it's visible, so a worker can never finish it
+	// and decrement the counts first. Counting under the sleep lock means
+	// a worker deciding whether to sleep can't miss it either; at worst, one
+	// wakes a moment early and checks the deques again
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		pendingTasks++;
+		queuedTasks++;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(_task));
+	}
+	taskAvailable.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(sleepMutex);
+	tasksFinished.wait(lock, [this] { return pendingTasks == 0; });
+}
+
+void ThreadPool::ParallelFor(size_t _count, const std::function<void(size_t, size_t)>& _body)
+{
+	if (_count == 0) return;
+
+	// A few chunks per worker leaves room for stealing to even out uneven chunks
+	size_t chunkCount = std::min(_count, (size_t)GetThreadCount() * 4);
+	size_t chunkSize = (_count + chunkCount - 1) / chunkCount;
+
+	for (size_t begin = 0; begin < _count; begin += chunkSize) {
+		size_t end = std::min(_count, begin + chunkSize);
+		Submit([&_body, begin, end] { _body(begin, end); });
+	}
+	Wait();
+}
+
+ThreadPoolStats ThreadPool::GetWorkerStats(unsigned int _worker) const
+{
+	ThreadPoolStats stats;
+	const WorkerQueue& queue = *queues[_worker];
+	stats.tasksRun = queue.tasksRun;
+	stats.steals = queue.steals;
+	stats.idleWaits = queue.idleWaits;
+	return stats;
+}
+
+ThreadPoolStats ThreadPool::GetStats() const
+{
+	ThreadPoolStats total;
+	for (unsigned int i = 0; i < (unsigned int)queues.size(); i++) {
+		ThreadPoolStats stats = GetWorkerStats(i);
+		total.tasksRun += stats.tasksRun;
+		total.steals += stats.steals;
+		total.idleWaits += stats.idleWaits;
+	}
+	return total;
+}
+
+void ThreadPool::ResetStats()
+{
+	for (auto& queue : queues) {
+		queue->tasksRun = 0;
+		queue->steals = 0;
+		queue->idleWaits = 0;
+	}
+}
+
+void ThreadPool::WorkerLoop(unsigned int _index)
+{
+	WorkerQueue& ownQueue = *queues[_index];
+
+	while (true) {
+		std::function<void()> task;
+
+		if (PopLocal(_index, task) || Steal(_index, task)) {
+			queuedTasks--;
+			task();
+			ownQueue.tasksRun++;
+
+			// Wake anyone waiting once the last task is done
+			if (--pendingTasks == 0) {
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				tasksFinished.notify_all();
+			}
+			continue;
+		}
+
+		// Every deque was empty, so sleep until there's a task to
+		// run or the pool is shut down
+		ownQueue.idleWaits++;
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		taskAvailable.wait(lock, [this] { return isStopping || queuedTasks > 0; });
+
+		if (isStopping && queuedTasks == 0) return;
+	}
+}
+
+bool ThreadPool::PopLocal(unsigned int _index, std::function<void()>& _task)
+{
+	WorkerQueue& queue = *queues[_index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+
+	if (queue.tasks.empty()) return false;
+
+	_task = std::move(queue.tasks.front());
+	queue.tasks.pop_front();
+	return true;
+}
+
+bool ThreadPool::Steal(unsigned int _index, std::function<void()>& _task)
+{
+	unsigned int queueCount = (unsigned int)queues.size();
+
+	// Start with the next worker along so thieves spread out
+	for (unsigned int offset = 1; offset < queueCount; offset++) {
+		WorkerQueue& victim = *queues[(_index + offset) % queueCount];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+
+		if (victim.tasks.empty()) continue;
+
+		_task = std::move(victim.tasks.back());
+		victim.tasks.pop_back();
+		queues[_index]->steals++;
+		return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counters describing how work was spread across the pool's workers
+struct ThreadPoolStats {
+	// Tasks run to completion
+	unsigned long long tasksRun = 0;
+	// Tasks taken from the back of another worker's queue
+	unsigned long long steals = 0;
+	// Times a worker found every queue empty and went to sleep
+	unsigned long long idleWaits = 0;
+};
+
+// A fixed set of worker threads that run submitted tasks,
+// used by the camera to render image tiles in parallel.
+// Each worker owns a deque it takes tasks from the front of; once
+// that runs dry, it steals from the back of the other workers' deques
+// so expensive tiles don't leave the rest of the pool idle
+class ThreadPool
+{
+public:
+	ThreadPool(unsigned int _threadCount);
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete; // Remove copy constructor
+	ThreadPool& operator=(const ThreadPool&) = delete; // Remove copy-assignment operator
+
+	unsigned int GetThreadCount() const;
+
+	// Queues a task on the next worker's deque, round-robin
+	void Submit(std::function<void()> _task);
+	// Blocks the calling thread until every submitted task has finished
+	void Wait();
+	// Splits [0, _count) into a few chunks per worker, runs _body(begin, end)
+	// on each across the pool, and waits for them all to finish
+	void ParallelFor(size_t _count, const std::function<void(size_t, size_t)>& _body);
+
+	// Scheduling counters, for one worker or summed over the whole pool
+	ThreadPoolStats GetWorkerStats(unsigned int _worker) const;
+	ThreadPoolStats GetStats() const;
+	void ResetStats();
+
+private:
+	// Per-worker task deque and counters, padded onto
+	// separate cache lines so workers don't contend
+	struct alignas(64) WorkerQueue {
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+
+		std::atomic<unsigned long long> tasksRun{ 0 };
+		std::atomic<unsigned long long> steals{ 0 };
+		std::atomic<unsigned long long> idleWaits{ 0 };
+	};
+
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<WorkerQueue>> queues;
+	// Queue the next submitted task goes to
+	unsigned int nextQueue;
+
+	// Guards sleeping and waking; the deques have their own locks
+	std::mutex sleepMutex;
+	// Signalled when a task is queued or the pool is shutting down
+	std::condition_variable taskAvailable;
+	// Signalled when the last outstanding task finishes
+	std::condition_variable tasksFinished;
+
+	// Tasks sitting in a deque, waiting to be picked up
+	std::atomic<unsigned int> queuedTasks;
+	// Tasks that are queued or currently running
+	std::atomic<unsigned int> pendingTasks;
+	bool isStopping;
+
+	void WorkerLoop(unsigned int _index);
+	// Takes a task from the front of the worker's own deque
+	bool PopLocal(unsigned int _index, std::function<void()>& _task);
+	// Takes a task from the back of another worker's deque
+	bool Steal(unsigned int _index, std::function<void()>& _task);
+};
+
@@ -15,36 +15,96 @@ inline DirectX::XMVECTOR RandomVector(float _min, float _max) {
 	return DirectX::XMLoadFloat3(&result);
 }
 
+// --- WARPS ---
+// Closed-form maps from numbers in [-1,1) or [0,1) onto shapes, each taking
+// a fixed number of them so samplers' strata carry through. SampleWarps.h
+// has 4- and 8-wide versions that give exactly the same results
+
+// sin and cos for angles within [-pi/4, pi/4], as Taylor polynomials that
+// the SIMD versions can evaluate in the same order
+inline float SinQuarterPi(float _x) {
+	float x2 = _x * _x;
+	return _x * (1.0f + x2 * (-1.0f / 6.0f + x2 * (1.0f / 120.0f + x2 * (-1.0f / 5040.0f))));
+}
+
+inline float CosQuarterPi(float _x) {
+	float x2 = _x * _x;
+	return 1.0f + x2 * (-0.5f + x2 * (1.0f / 24.0f + x2 * (-1.0f / 720.0f + x2 * (1.0f / 40320.0f))));
+}
+
+// Maps a point in the square [-1,1)^2 onto the unit disk, keeping areas
+// equal and nearby points nearby (Shirley and Chiu's concentric map)
+inline DirectX::XMFLOAT2 ConcentricSampleDisk(float _u, float _v) {
+	// Each point lands on the ring set by whichever coordinate is larger,
+	// at an angle set by the other, within a quarter turn of that axis
+	bool isUMajor = std::abs(_u) > std::abs(_v);
+	float radius = isUMajor ? _u : _v;
+	float minor = isUMajor ? _v : _u;
+	float angle = (pi / 4.0f) * (radius != 0.0f ? minor / radius : 0.0f);
+
+	float cosine = CosQuarterPi(angle);
+	float sine = SinQuarterPi(angle);
+	return DirectX::XMFLOAT2(
+		radius * (isUMajor ? cosine : sine),
+		radius * (isUMajor ? sine : cosine));
+}
+
+// Maps a point in [-1,1)^2 onto the unit sphere, uniformly: the concentric
+// disk, lifted by the equal-area map Marsaglia's method uses
+inline DirectX::XMFLOAT3 UniformSampleSphere(float _u, float _v) {
+	DirectX::XMFLOAT2 disk = ConcentricSampleDisk(_u, _v);
+	float radiusSquared = disk.x * disk.x + disk.y * disk.y;
+	float scale = 2.0f * std::sqrt(std::max(0.0f, 1.0f - radiusSquared));
+	return DirectX::XMFLOAT3(disk.x * scale, disk.y * scale, 1.0f - 2.0f * radiusSquared);
+}
+
+// Maps a point in [-1,1)^2 onto the +Z hemisphere, with density
+// proportional to the cosine from +Z: the concentric disk, projected up
+// (Malley's method)
+inline DirectX::XMFLOAT3 CosineSampleHemisphere(float _u, float _v) {
+	DirectX::XMFLOAT2 disk = ConcentricSampleDisk(_u, _v);
+	float radiusSquared = disk.x * disk.x + disk.y * disk.y;
+	return DirectX::XMFLOAT3(disk.x, disk.y, std::sqrt(std::max(0.0f, 1.0f - radiusSquared)));
+}
+
+// Builds two unit tangents perpendicular to a unit _normal, without
+// branching on which way it points (Duff et al.)
+inline void OrthonormalBasis(const DirectX::XMFLOAT3& _normal, DirectX::XMFLOAT3& _tangent, DirectX::XMFLOAT3& _bitangent) {
+	float sign = std::copysign(1.0f, _normal.z);
+	float a = -1.0f / (sign + _normal.z);
+	float b = _normal.x * _normal.y * a;
+	_tangent = DirectX::XMFLOAT3(1.0f + sign * _normal.x * _normal.x * a, sign * b, -sign * _normal.x);
+	_bitangent = DirectX::XMFLOAT3(b, sign + _normal.y * _normal.y * a, -_normal.y);
+}
+
+// Returns a random unit vector. Draws X's number first, then Y's
 inline DirectX::XMVECTOR RandomUnitVector() {
-	while (true) {
-		// Generate random vector
-		DirectX::XMVECTOR p = RandomVector(-1.0f, 1.0f);
-
-		// Find its length
-		float lengthSquared;
-		DirectX::XMStoreFloat(&lengthSquared, DirectX::XMVector3LengthSq(p));
-
-		// If float length is smaller than minimum float value or larger than 1, reject
-		if (std::numeric_limits<float>::denorm_min() < lengthSquared && lengthSquared <= 1.0f) {
-			// If acceptable, normalize and return
-			return DirectX::XMVector3Normalize(p);
-		}
-	}
+	float u = RandomFloat(-1.0f, 1.0f);
+	float v = RandomFloat(-1.0f, 1.0f);
+	DirectX::XMFLOAT3 result = UniformSampleSphere(u, v);
+	return DirectX::XMLoadFloat3(&result);
 }
 
+// Returns a random point in the unit disk. Draws X's number first, so
+// batched camera rays can draw the same numbers in the same order
 inline DirectX::XMFLOAT2 RandomInUnitDisk() {
-	while (true) {
-		// Generate new vector on plane
-		DirectX::XMFLOAT2 p(RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f));
-		
-		// Check length
-		auto pCheck = DirectX::XMLoadFloat2(&p);
-		float length;
-		DirectX::XMStoreFloat(&length, DirectX::XMVector2LengthSq(pCheck));
-		if (length < 1.0f) {
-			return p;
-		}
-	}
+	float u = RandomFloat(-1.0f, 1.0f);
+	float v = RandomFloat(-1.0f, 1.0f);
+	return ConcentricSampleDisk(u, v);
+}
+
+// Returns a random unit vector on _normal's side, more likely the closer
+// it is to _normal, in proportion to the cosine between them
+inline DirectX::XMVECTOR RandomCosineDirection(const DirectX::XMFLOAT3& _normal) {
+	float u = RandomFloat(-1.0f, 1.0f);
+	float v = RandomFloat(-1.0f, 1.0f);
+	DirectX::XMFLOAT3 local = CosineSampleHemisphere(u, v);
+
+	DirectX::XMFLOAT3 tangent, bitangent;
+	OrthonormalBasis(_normal, tangent, bitangent);
+	DirectX::XMVECTOR direction = DirectX::XMVectorScale(DirectX::XMLoadFloat3(&tangent), local.x);
+	direction = DirectX::XMVectorMultiplyAdd(DirectX::XMLoadFloat3(&bitangent), DirectX::XMVectorReplicate(local.y), direction);
+	return DirectX::XMVectorMultiplyAdd(DirectX::XMLoadFloat3(&_normal), DirectX::XMVectorReplicate(local.z), direction);
 }
 
 inline DirectX::XMFLOAT3 RandomOnHemisphere(const DirectX::XMFLOAT3 _normal) {
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Hittable.h"
+
+// How the camera follows its paths through the scene
+enum class RenderMode
+{
+	// Each thread follows one path at a time through every bounce
+	Megakernel,
+	// Large batches of paths move through the scene one stage at a time:
+	// generate, intersect, sort by material, shade, then compact
+	Wavefront
+};
+
+// Time spent in each wavefront stage during the last render, summed
+// over every wave and bounce
+struct WavefrontStageTimes {
+	double generateSeconds = 0.0;	// Camera rays for every path in a wave
+	double intersectSeconds = 0.0;	// Closest hits for every active path
+	double sortSeconds = 0.0;		// Grouping active paths by material type
+	double shadeSeconds = 0.0;		// Light sampling and scattering, one material type at a time
+	double compactSeconds = 0.0;	// Dropping paths that ended
+	double accumulateSeconds = 0.0;	// Summing finished paths into pixels
+	double totalSeconds = 0.0;
+};
+
+// One camera path in flight in wavefront mode
+struct WavefrontPath {
+	Ray ray;
+	DirectX::XMFLOAT3 throughput;
+	// Light the path has gathered so far
+	DirectX::XMFLOAT3 radiance;
+	// The last bounce's scatter density and normal, and whether it sampled lights too
+	float scatterPdf;
+	DirectX::XMFLOAT3 scatterNormal;
+	bool wasLightSampled;
+	// Which shading queue the path's last hit goes in
+	uint32_t queue;
+	uint32_t segmentCount;
+	bool hasEnded;
+};
+
+// Buffers for the wave in flight, kept between renders so they're only
+// allocated once. Paths are numbered in pixel order, then sample order
+struct WavefrontQueues {
+	std::vector<WavefrontPath> paths;
+	std::vector<HitRecord> hits;
+	// Paths still bouncing, and the same paths grouped by shading queue
+	std::vector<uint32_t> active;
+	std::vector<uint32_t> sorted;
+};
+
@@ -0,0 +1,331 @@
+#include "WideBVH.h"
+
+#include <bit>
+#include "SimdLanes.h"
+
+namespace
+{
+	float NodeSurfaceArea(const LinearBVHNode& _node)
+	{
+		float dx = _node.boundsMax[0] - _node.boundsMin[0];
+		float dy = _node.boundsMax[1] - _node.boundsMin[1];
+		float dz = _node.boundsMax[2] - _node.boundsMin[2];
+		return 2.0f * (dx * dy + dy * dz + dz * dx);
+	}
+}
+
+template<int WIDTH>
+WideBVH<WIDTH>::WideBVH(const HittableList& _list)
+{
+	BVH binaryBVH(_list);
+	boundingBox = binaryBVH.BoundingBox();
+	primitives = binaryBVH.GetPrimitives();
+	primitiveStore = PrimitiveStore(primitives);
+
+	if (primitives.empty())
+		return;
+
+	// Every wide node absorbs at least one binary interior node
+	nodes.reserve(binaryBVH.GetNodeCount() / 2 + 1);
+	Collapse(binaryBVH.GetNodes(), 0);
+}
+
+template<int WIDTH>
+bool WideBVH<WIDTH>::Intersect(const Ray& _ray, Interval _rayT, RayHit& _hit) const
+{
+	return Traverse<false>(_ray, _rayT, _hit, nullptr);
+}
+
+template<int WIDTH>
+bool WideBVH<WIDTH>::IntersectWithStats(const Ray& _ray, Interval _rayT, RayHit& _hit, TraversalStats& _stats) const
+{
+	return Traverse<true>(_ray, _rayT, _hit, &_stats);
+}
+
+template<int WIDTH>
+bool WideBVH<WIDTH>::Occluded(const Ray& _ray, Interval _rayT) const
+{
+	RayHit unused;
+	return Traverse<false, true>(_ray, _rayT, unused, nullptr);
+}
+
+template<int WIDTH>
+bool WideBVH<WIDTH>::OccludedWithStats(const Ray& _ray, Interval _rayT, TraversalStats& _stats) const
+{
+	RayHit unused;
+	return Traverse<true, true>(_ray, _rayT, unused, &_stats);
+}
+
+template<int WIDTH>
+AABB WideBVH<WIDTH>::BoundingBox() const
+{
+	return boundingBox;
+}
+
+template<int WIDTH>
+void WideBVH<WIDTH>::Refit()
+{
+	if (primitives.empty())
+		return;
+
+	primitiveStore.Sync();
+	boundingBox = RefitNode(0);
+}
+
+template<int WIDTH>
+float WideBVH<WIDTH>::ComputeSAHCost() const
+{
+	float rootArea = boundingBox.SurfaceArea();
+	if (primitives.empty() || rootArea <= 0.0f)
+		return 0.0f;
+
+	// The root is always visited; every other child costs its chance of
+	// being hit, relative to the root, times the work done there
+	float cost = BVH::TRAVERSAL_COST;
+	for (const WideBVHNode<WIDTH>& node : nodes) {
+		for (int i = 0; i < WIDTH; i++) {
+			AABB bounds(
+				Interval(node.boundsMin[0][i], node.boundsMax[0][i]),
+				Interval(node.boundsMin[1][i], node.boundsMax[1][i]),
+				Interval(node.boundsMin[2][i], node.boundsMax[2][i]));
+			float area = bounds.SurfaceArea();
+			if (node.primitiveCount[i] > 0)
+				cost += area / rootArea * node.primitiveCount[i];
+			else if (area > 0.0f && node.childOffset[i] != 0)
+				cost += area / rootArea * BVH::TRAVERSAL_COST;
+		}
+	}
+	return cost;
+}
+
+template<int WIDTH>
+size_t WideBVH<WIDTH>::GetNodeCount() const
+{
+	return nodes.size();
+}
+
+template<int WIDTH>
+template<bool COUNT_STATS, bool ANY_HIT>
+bool WideBVH<WIDTH>::Traverse(const Ray& _ray, Interval _rayT, RayHit& _hit, TraversalStats* _stats) const
+{
+	using Lanes = SimdLanes<WIDTH>;
+	using LaneFloat = typename Lanes::Float;
+
+	if (primitives.empty())
+		return false;
+
+	const float rayOrigin[3] = { _ray.Origin.x, _ray.Origin.y, _ray.Origin.z };
+	const float inverseDirection[3] = { 1.0f / _ray.Direction.x, 1.0f / _ray.Direction.y, 1.0f / _ray.Direction.z };
+	const bool isDirectionNegative[3] = { inverseDirection[0] < 0.0f, inverseDirection[1] < 0.0f, inverseDirection[2] < 0.0f };
+
+	// Splat the ray across every lane once, up front
+	LaneFloat laneOrigin[3];
+	LaneFloat laneInverseDirection[3];
+	for (int axis = 0; axis < 3; axis++) {
+		laneOrigin[axis] = Lanes::Set1(rayOrigin[axis]);
+		laneInverseDirection[axis] = Lanes::Set1(inverseDirection[axis]);
+	}
+
+	// Nodes and leaves still to visit, with the distance the ray enters each
+	struct StackEntry {
+		uint32_t offset;
+		uint32_t primitiveCount;
+		float tNear;
+	};
+	StackEntry toVisit[STACK_SIZE];
+	int toVisitCount = 0;
+	toVisit[toVisitCount++] = { 0, 0, _rayT.minimum };
+
+	bool hasHitAnything = false;
+	float closestSoFar = _rayT.maximum;
+
+	while (toVisitCount > 0) {
+		StackEntry entry = toVisit[--toVisitCount];
+
+		// Something nearer was found since this entry was pushed
+		if (entry.tNear > closestSoFar)
+			continue;
+
+		if (entry.primitiveCount > 0) {
+			// Leaf: test each of its primitives
+			if constexpr (COUNT_STATS) _stats->primitivesTested += entry.primitiveCount;
+			for (uint32_t i = entry.offset; i < entry.offset + entry.primitiveCount; i++) {
+				if constexpr (ANY_HIT) {
+					if (primitiveStore.Occluded(i, _ray, _rayT))
+						return true;
+				}
+				else if (primitiveStore.Intersect(i, _ray, Interval(_rayT.minimum, closestSoFar), _hit)) {
+					hasHitAnything = true;
+					closestSoFar = _hit.t;
+				}
+			}
+			continue;
+		}
+
+		const WideBVHNode<WIDTH>& node = nodes[entry.offset];
+		if constexpr (COUNT_STATS) _stats->nodesVisited++;
+
+		// Slab test every child at once; the ray enters through each axis's
+		// near plane, which depends on which way it's heading
+		LaneFloat tNear = Lanes::Set1(_rayT.minimum);
+		LaneFloat tFar = Lanes::Set1(closestSoFar);
+		for (int axis = 0; axis < 3; axis++) {
+			const float* nearPlanes = isDirectionNegative[axis] ? node.boundsMax[axis] : node.boundsMin[axis];
+			const float* farPlanes = isDirectionNegative[axis] ? node.boundsMin[axis] : node.boundsMax[axis];
+
+			tNear = Lanes::Max(Lanes::Mul(Lanes::Sub(Lanes::Load(nearPlanes), laneOrigin[axis]), laneInverseDirection[axis]), tNear);
+			tFar = Lanes::Min(Lanes::Mul(Lanes::Sub(Lanes::Load(farPlanes), laneOrigin[axis]), laneInverseDirection[axis]), tFar);
+		}
+
+		unsigned int hitMask = (unsigned int)Lanes::LessEqualMask(tNear, tFar);
+		if (hitMask == 0)
+			continue;
+
+		alignas(32) float childTNear[WIDTH];
+		Lanes::Store(childTNear, tNear);
+
+		// Any hit will do, so order doesn't matter
+		if constexpr (ANY_HIT) {
+			while (hitMask != 0) {
+				int child = std::countr_zero(hitMask);
+				hitMask &= hitMask - 1;
+				toVisit[toVisitCount++] = { node.childOffset[child], node.primitiveCount[child], childTNear[child] };
+			}
+			continue;
+		}
+
+		// Order the children hit from farthest to nearest, so the
+		// nearest ends up on top of the stack and is visited first
+		StackEntry hitChildren[WIDTH];
+		int hitCount = 0;
+		while (hitMask != 0) {
+			int child = std::countr_zero(hitMask);
+			hitMask &= hitMask - 1;
+
+			StackEntry childEntry = { node.childOffset[child], node.primitiveCount[child], childTNear[child] };
+			int insertAt = hitCount++;
+			while (insertAt > 0 && hitChildren[insertAt - 1].tNear < childEntry.tNear) {
+				hitChildren[insertAt] = hitChildren[insertAt - 1];
+				insertAt--;
+			}
+			hitChildren[insertAt] = childEntry;
+		}
+
+		for (int i = 0; i < hitCount; i++) {
+			toVisit[toVisitCount++] = hitChildren[i];
+		}
+	}
+
+	return hasHitAnything;
+}
+
+template<int WIDTH>
+uint32_t WideBVH<WIDTH>::Collapse(const std::vector<LinearBVHNode>& _binaryNodes, uint32_t _binaryIndex)
+{
+	uint32_t nodeIndex = (uint32_t)nodes.size();
+	nodes.emplace_back();
+
+	// Start from the binary node's children (or the node itself, if it's a
+	// lone leaf at the root), then keep opening whichever interior child
+	// has the largest surface area until every slot is used
+	uint32_t children[WIDTH];
+	int childCount = 0;
+	if (_binaryNodes[_binaryIndex].primitiveCount > 0) {
+		children[childCount++] = _binaryIndex;
+	}
+	else {
+		children[childCount++] = _binaryIndex + 1;
+		children[childCount++] = _binaryNodes[_binaryIndex].secondChildOffset;
+	}
+
+	while (childCount < WIDTH) {
+		int largestChild = -1;
+		float largestArea = -1.0f;
+		for (int i = 0; i < childCount; i++) {
+			const LinearBVHNode& child = _binaryNodes[children[i]];
+			if (child.primitiveCount == 0 && NodeSurfaceArea(child) > largestArea) {
+				largestChild = i;
+				largestArea = NodeSurfaceArea(child);
+			}
+		}
+
+		// Only leaves left
+		if (largestChild < 0)
+			break;
+
+		uint32_t opened = children[largestChild];
+		children[largestChild] = opened + 1;
+		children[childCount++] = _binaryNodes[opened].secondChildOffset;
+	}
+
+	// Fill in each slot, collapsing interior children into nodes of their own
+	for (int i = 0; i < WIDTH; i++) {
+		uint32_t childOffset = 0;
+		uint16_t primitiveCount = 0;
+		float boundsMin[3] = { +infinity, +infinity, +infinity };
+		float boundsMax[3] = { -infinity, -infinity, -infinity };
+
+		if (i < childCount) {
+			const LinearBVHNode& child = _binaryNodes[children[i]];
+			for (int axis = 0; axis < 3; axis++) {
+				boundsMin[axis] = child.boundsMin[axis];
+				boundsMax[axis] = child.boundsMax[axis];
+			}
+
+			if (child.primitiveCount > 0) {
+				childOffset = child.primitiveOffset;
+				primitiveCount = child.primitiveCount;
+			}
+			else {
+				childOffset = Collapse(_binaryNodes, children[i]);
+			}
+		}
+
+		// Collapsing may have reallocated the array, so index it again
+		WideBVHNode<WIDTH>& node = nodes[nodeIndex];
+		for (int axis = 0; axis < 3; axis++) {
+			node.boundsMin[axis][i] = boundsMin[axis];
+			node.boundsMax[axis][i] = boundsMax[axis];
+		}
+		node.childOffset[i] = childOffset;
+		node.primitiveCount[i] = primitiveCount;
+	}
+
+	return nodeIndex;
+}
+
+template<int WIDTH>
+AABB WideBVH<WIDTH>::RefitNode(uint32_t _node)
+{
+	// Unused slots have no children and no primitives; they stay empty
+	WideBVHNode<WIDTH>& node = nodes[_node];
+	AABB nodeBounds;
+	for (int i = 0; i < WIDTH; i++) {
+		AABB bounds;
+		if (node.primitiveCount[i] > 0) {
+			for (uint32_t j = node.childOffset[i]; j < node.childOffset[i] + node.primitiveCount[i]; j++) {
+				bounds = AABB(bounds, primitives[j]->BoundingBox());
+			}
+		}
+		else if (node.childOffset[i] != 0) {
+			bounds = RefitNode(node.childOffset[i]);
+		}
+		else {
+			continue;
+		}
+
+		node.boundsMin[0][i] = bounds.x.minimum;
+		node.boundsMin[1][i] = bounds.y.minimum;
+		node.boundsMin[2][i] = bounds.z.minimum;
+		node.boundsMax[0][i] = bounds.x.maximum;
+		node.boundsMax[1][i] = bounds.y.maximum;
+		node.boundsMax[2][i] = bounds.z.maximum;
+		nodeBounds = AABB(nodeBounds, bounds);
+	}
+	return nodeBounds;
+}
+
+template class WideBVH<4>;
+#if defined(__AVX2__)
+template class WideBVH<8>;
+#endif
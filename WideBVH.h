@@ -0,0 +1,74 @@
+#pragma once
+#include "AccelerationStructure.h"
+
+#include <cstdint>
+#include <vector>
+#include "BVH.h"
+#include "HittableList.h"
+#include "PrimitiveStore.h"
+
+// One node of a WIDTH-ary BVH. Child bounds are stored structure-of-arrays
+// so one SIMD slab test covers every child at once. Unused child slots
+// have inverted (empty) bounds, so rays never enter them
+template<int WIDTH>
+struct alignas(32) WideBVHNode {
+	float boundsMin[3][WIDTH];
+	float boundsMax[3][WIDTH];
+	uint32_t childOffset[WIDTH];		// Interior child: node index. Leaf child: first primitive
+	uint16_t primitiveCount[WIDTH];		// 0 for interior children
+};
+
+// A BVH with 4 (SSE) or 8 (AVX2) children per node, made by collapsing
+// a binary SAH BVH. Each step tests all of a node's children with one
+// vectorized slab test and visits the ones hit from nearest to farthest
+template<int WIDTH>
+class WideBVH :
+	public AccelerationStructure
+{
+public:
+	// Builds a binary BVH over every object in the list, then collapses it
+	WideBVH(const HittableList& _list);
+
+	bool Intersect(const Ray& _ray, Interval _rayT, RayHit& _hit) const override;
+	// Stops at the first primitive hit, and skips sorting children by distance
+	bool Occluded(const Ray& _ray, Interval _rayT) const override;
+	AABB BoundingBox() const override;
+	void Refit() override;
+	float ComputeSAHCost() const override;
+
+	// Same as Intersect, but also adds the work done to _stats
+	bool IntersectWithStats(const Ray& _ray, Interval _rayT, RayHit& _hit, TraversalStats& _stats) const;
+	// Same as Occluded, but also adds the work done to _stats
+	bool OccludedWithStats(const Ray& _ray, Interval _rayT, TraversalStats& _stats) const;
+
+	size_t GetNodeCount() const;
+
+private:
+	// Entries on the traversal stack; each visited node pops one and
+	// pushes at most WIDTH, and the tree is no deeper than the binary one
+	static const int STACK_SIZE = BVH::MAX_DEPTH * (WIDTH - 1) + 1;
+
+	std::vector<WideBVHNode<WIDTH>> nodes;
+	// Primitives in the order leaves refer to them
+	std::vector<shared_ptr<Hittable>> primitives;
+	// The same primitives, in the same order, for leaves to test
+	PrimitiveStore primitiveStore;
+	AABB boundingBox;
+
+	// Finds the closest hit, or with ANY_HIT returns at the first hit without
+	// filling in _hit, optionally counting the work done into _stats
+	template<bool COUNT_STATS, bool ANY_HIT = false>
+	bool Traverse(const Ray& _ray, Interval _rayT, RayHit& _hit, TraversalStats* _stats) const;
+
+	// Appends a wide node covering the binary subtree at _binaryIndex,
+	// and those below it, and returns the wide node's index
+	uint32_t Collapse(const std::vector<LinearBVHNode>& _binaryNodes, uint32_t _binaryIndex);
+	// Refits a node's children from the bottom up and returns the node's new bounds
+	AABB RefitNode(uint32_t _node);
+};
+
+using BVH4 = WideBVH<4>;
+#if defined(__AVX2__)
+using BVH8 = WideBVH<8>;
+#endif
+